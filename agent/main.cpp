@@ -0,0 +1,176 @@
+#include "procfilecache.h"
+#include "samplestream.h"
+#include "systemsampler.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+#include <QHostAddress>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPointer>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <cstdio>
+
+// A consumer that lets this much output pile up is dropped instead of buffering without bound.
+static constexpr qint64 maxPendingBytes = 16 * 1024 * 1024;
+
+// Drops a client without flushing what is still queued for it.
+static void abortClient(QIODevice *client)
+{
+  if (QLocalSocket *localSocket = qobject_cast<QLocalSocket *>(client))
+    localSocket->abort();
+  else if (QTcpSocket *tcpSocket = qobject_cast<QTcpSocket *>(client))
+    tcpSocket->abort();
+}
+
+// Samples the procfs collectors on a timer and streams a baseline followed by per-tick deltas,
+// either to stdout or to every client of a Unix or TCP socket. Clients that connect mid-stream
+// get a baseline of the current state first.
+int main(int argc, char *argv[])
+{
+  // Before any thread starts, so that the /proc file cache can keep a descriptor per process.
+  raiseOpenFileLimit();
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName(QStringLiteral("wintaskman-agent"));
+  QCommandLineParser parser;
+  parser.setApplicationDescription(QStringLiteral("Streams system usage and process samples without a display."));
+  parser.addHelpOption();
+  const QCommandLineOption intervalOption(QStringLiteral("interval"), QStringLiteral("Time between samples."), QStringLiteral("ms"), QStringLiteral("1000"));
+  const QCommandLineOption formatOption(QStringLiteral("format"), QStringLiteral("Output format, json or binary; defaults to binary on a socket and json on stdout."), QStringLiteral("format"));
+  const QCommandLineOption socketOption(QStringLiteral("socket"), QStringLiteral("Serve the stream on a Unix socket instead of writing it to stdout."), QStringLiteral("path"));
+  const QCommandLineOption listenOption(QStringLiteral("listen"), QStringLiteral("Serve the stream over TCP on [host:]port; the host defaults to localhost."), QStringLiteral("address"));
+  const QCommandLineOption allUsersOption(QStringLiteral("all-users"), QStringLiteral("Include the processes of every user."));
+  const QCommandLineOption ticksOption(QStringLiteral("ticks"), QStringLiteral("Exit after this many samples; 0 runs until stopped."), QStringLiteral("count"), QStringLiteral("0"));
+  const QCommandLineOption procRootOption(QStringLiteral("proc-root"), QStringLiteral("Where to read procfs from."), QStringLiteral("path"), QStringLiteral("/proc"));
+  const QCommandLineOption threadsOption(QStringLiteral("scan-threads"), QStringLiteral("Threads used to scan procfs; 0 picks one per core."), QStringLiteral("count"), QStringLiteral("0"));
+  parser.addOptions({intervalOption, formatOption, socketOption, listenOption, allUsersOption, ticksOption, procRootOption, threadsOption});
+  parser.process(app);
+
+  // WinTaskMan only reads the binary format, so that is what a socket serves unless asked for.
+  QString formatName = parser.value(formatOption);
+  if (!parser.isSet(formatOption))
+    formatName = parser.isSet(socketOption) || parser.isSet(listenOption) ? QStringLiteral("binary") : QStringLiteral("json");
+  SampleFormat format;
+  if (formatName == QLatin1String("json"))
+    format = SampleFormat::JsonLines;
+  else if (formatName == QLatin1String("binary"))
+    format = SampleFormat::Binary;
+  else
+  {
+    std::fprintf(stderr, "unknown format %s\n", qPrintable(formatName));
+    return 1;
+  }
+
+  SystemSampler sampler(QFile::encodeName(parser.value(procRootOption)));
+  sampler.setScanThreadCount(parser.value(threadsOption).toInt());
+  SampleDiffer differ;
+  const bool includeAllUsers = parser.isSet(allUsersOption);
+  const quint64 maxTicks = parser.value(ticksOption).toULongLong();
+  quint64 tick = 0;
+
+  QFile standardOutput;
+  QLocalServer localServer;
+  QTcpServer tcpServer;
+  QList<QPointer<QIODevice>> clients;
+  const auto addClient = [&](QIODevice *client)
+  {
+    client->write(sampleStreamHeader(format));
+    // Before the first sample the client simply starts with the first baseline.
+    if (tick > 0)
+      client->write(encodeSampleFrame(differ.baseline(), format));
+    clients.append(client);
+  };
+
+  if (parser.isSet(socketOption))
+  {
+    const QString path = parser.value(socketOption);
+    QLocalServer::removeServer(path);
+    if (!localServer.listen(path))
+    {
+      std::fprintf(stderr, "cannot listen on %s: %s\n", qPrintable(path), qPrintable(localServer.errorString()));
+      return 1;
+    }
+    QObject::connect(&localServer, &QLocalServer::newConnection, [&]()
+                     {
+      while (QLocalSocket *client = localServer.nextPendingConnection())
+      {
+        QObject::connect(client, &QLocalSocket::disconnected, client, &QObject::deleteLater);
+        addClient(client);
+      } });
+  }
+
+  if (parser.isSet(listenOption))
+  {
+    const QString address = parser.value(listenOption);
+    const int colon = address.lastIndexOf(':');
+    const QString hostName = colon > 0 ? address.left(colon) : QString();
+    const QHostAddress host = hostName.isEmpty() || hostName == QLatin1String("localhost") ? QHostAddress(QHostAddress::LocalHost) : QHostAddress(hostName);
+    bool ok = false;
+    const quint16 port = address.mid(colon + 1).toUShort(&ok);
+    if (!ok || host.isNull() || !tcpServer.listen(host, port))
+    {
+      std::fprintf(stderr, "cannot listen on %s: %s\n", qPrintable(address), qPrintable(tcpServer.errorString()));
+      return 1;
+    }
+    QObject::connect(&tcpServer, &QTcpServer::newConnection, [&]()
+                     {
+      while (QTcpSocket *client = tcpServer.nextPendingConnection())
+      {
+        QObject::connect(client, &QTcpSocket::disconnected, client, &QObject::deleteLater);
+        addClient(client);
+      } });
+  }
+
+  if (!localServer.isListening() && !tcpServer.isListening())
+  {
+    if (!standardOutput.open(stdout, QIODevice::WriteOnly | QIODevice::Unbuffered))
+    {
+      std::fprintf(stderr, "cannot write to stdout\n");
+      return 1;
+    }
+    standardOutput.write(sampleStreamHeader(format));
+  }
+
+  const auto sample = [&]()
+  {
+    sampler.beginTick(SystemSampler::processListFields());
+    const SystemUsage usage = sampler.refreshSystemUsage();
+    const QList<ProcessInfo> rows = sampler.refreshProcessList(includeAllUsers);
+    const SampleFrame frame = differ.diff(++tick, QDateTime::currentMSecsSinceEpoch(), usage, rows);
+    const QByteArray encoded = encodeSampleFrame(frame, format);
+
+    if (standardOutput.isOpen())
+    {
+      if (standardOutput.write(encoded) != encoded.size())
+        app.exit(1);
+    }
+    else
+    {
+      clients.removeAll(nullptr);
+      for (QIODevice *client : std::as_const(clients))
+      {
+        if (client->bytesToWrite() > maxPendingBytes)
+          abortClient(client);
+        else
+          client->write(encoded);
+      }
+    }
+
+    if (maxTicks > 0 && tick >= maxTicks)
+      app.quit();
+  };
+
+  QTimer timer;
+  timer.setInterval(qMax(1, parser.value(intervalOption).toInt()));
+  QObject::connect(&timer, &QTimer::timeout, sample);
+  // Sample right away so that consumers do not wait an interval for the baseline.
+  QTimer::singleShot(0, &timer, [&]()
+                     {
+    sample();
+    timer.start(); });
+  return app.exec();
+}
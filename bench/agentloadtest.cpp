@@ -0,0 +1,327 @@
+#include "agentconnection.h"
+#include "instrumentation.h"
+#include "samplestream.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPointer>
+#include <QRandomGenerator>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+static const char *const processNames[] = {"bash", "systemd", "sshd", "python3", "kworker/0:1", "pipewire", "java", "cron", "dbus-daemon", "postgres", "nginx", "node"};
+static const char *const userNames[] = {"root", "www-data", "postgres", "alice", "bob"};
+
+namespace
+{
+struct LoadOptions
+{
+  int processes = 10000;
+  // Share of processes whose CPU or memory reading changes per tick, and share replaced by new ones.
+  double activeFraction = 0.1;
+  double churn = 0.002;
+};
+
+// Stands in for one wintaskman-agent: a synthetic process table that moves on every tick, run
+// through the same differ and encoder as the real agent and served on its own socket.
+class SimulatedAgent
+{
+public:
+  SimulatedAgent(int index, const LoadOptions &options)
+      : m_index(index), m_options(options), m_random(quint32(index + 1))
+  {
+    m_rows.reserve(options.processes);
+    for (int count = 0; count < options.processes; ++count)
+      m_rows.append(makeProcess());
+  }
+
+  bool listen(bool tcp, const QString &directory)
+  {
+    if (tcp)
+    {
+      if (!m_tcpServer.listen(QHostAddress::LocalHost, 0))
+        return false;
+      m_address = QStringLiteral("127.0.0.1:%1").arg(m_tcpServer.serverPort());
+      QObject::connect(&m_tcpServer, &QTcpServer::newConnection, [this]()
+                       {
+        while (QTcpSocket *client = m_tcpServer.nextPendingConnection())
+          addClient(client); });
+      return true;
+    }
+
+    m_address = directory + QStringLiteral("/agent-%1.sock").arg(m_index);
+    QLocalServer::removeServer(m_address);
+    if (!m_localServer.listen(m_address))
+      return false;
+    QObject::connect(&m_localServer, &QLocalServer::newConnection, [this]()
+                     {
+      while (QLocalSocket *client = m_localServer.nextPendingConnection())
+        addClient(client); });
+    return true;
+  }
+
+  QString address() const { return m_address; }
+  quint64 tick() const { return m_tick; }
+  quint64 baselineBytes() const { return m_baselineBytes; }
+  quint64 deltaBytes() const { return m_deltaBytes; }
+  qint64 encodeNs() const { return m_encodeNs; }
+
+  void advance()
+  {
+    for (ProcessInfo &row : m_rows)
+    {
+      if (m_random.generateDouble() < m_options.churn)
+      {
+        row = makeProcess();
+        continue;
+      }
+      if (m_random.generateDouble() < m_options.activeFraction)
+      {
+        row.cpuPercent = m_random.bounded(1000) / 10.0;
+        row.memoryKb = qMax(100.0, row.memoryKb + m_random.bounded(2001) - 1000);
+      }
+    }
+
+    SystemUsage usage;
+    usage.cpuUsage = m_random.bounded(101);
+    usage.totalRam = 32000000;
+    usage.ramUsage = 8000000 + m_random.bounded(16000000);
+    usage.coreCount = 8;
+    for (int core = 0; core < usage.coreCount; ++core)
+      usage.coreUsages.append(m_random.bounded(101));
+    usage.totalProcesses = m_rows.size();
+
+    QElapsedTimer timer;
+    timer.start();
+    const SampleFrame frame = m_differ.diff(++m_tick, QDateTime::currentMSecsSinceEpoch(), usage, m_rows);
+    const QByteArray encoded = encodeSampleFrame(frame, SampleFormat::Binary);
+    m_encodeNs += timer.nsecsElapsed();
+
+    m_clients.removeAll(nullptr);
+    for (QIODevice *client : std::as_const(m_clients))
+      client->write(encoded);
+    if (m_tick > 1)
+      m_deltaBytes += quint64(encoded.size());
+  }
+
+  // Number of decoded rows that differ from what this agent last sent, counting missing and
+  // extra rows.
+  int mismatches(const SampleStreamDecoder &stream) const
+  {
+    int count = 0;
+    for (const ProcessInfo &row : m_rows)
+    {
+      const ProcessInfo *decoded = stream.processes().find({row.pid, row.starttime});
+      if (!decoded || decoded->name != row.name || decoded->user != row.user ||
+          cpuPermille(decoded->cpuPercent) != cpuPermille(row.cpuPercent) || qint64(decoded->memoryKb) != qint64(row.memoryKb))
+        ++count;
+    }
+    return count + qAbs(stream.processes().size() - int(m_rows.size()));
+  }
+
+private:
+  ProcessInfo makeProcess()
+  {
+    ProcessInfo row;
+    row.pid = m_nextPid++;
+    row.starttime = qint64(m_tick) * 100 + m_random.bounded(100);
+    row.name = QString::fromLatin1(processNames[m_random.bounded(int(std::size(processNames)))]);
+    row.user = QString::fromLatin1(userNames[m_random.bounded(int(std::size(userNames)))]);
+    row.cpuPercent = m_random.bounded(1000) / 10.0;
+    row.memoryKb = 1000 + m_random.bounded(500000);
+    return row;
+  }
+
+  void addClient(QIODevice *client)
+  {
+    client->write(sampleStreamHeader(SampleFormat::Binary));
+    if (m_tick > 0)
+    {
+      const QByteArray baseline = encodeSampleFrame(m_differ.baseline(), SampleFormat::Binary);
+      client->write(baseline);
+      m_baselineBytes = quint64(baseline.size());
+    }
+    m_clients.append(client);
+  }
+
+  int m_index = 0;
+  LoadOptions m_options;
+  QRandomGenerator m_random;
+  QList<ProcessInfo> m_rows;
+  SampleDiffer m_differ;
+  QLocalServer m_localServer;
+  QTcpServer m_tcpServer;
+  QList<QPointer<QIODevice>> m_clients;
+  QString m_address;
+  int m_nextPid = 300;
+  quint64 m_tick = 0;
+  quint64 m_baselineBytes = 0;
+  quint64 m_deltaBytes = 0;
+  qint64 m_encodeNs = 0;
+};
+}
+
+// Runs many simulated agents in this process and follows each one with an AgentConnection, the
+// way the Hosts tab does, then reports the bandwidth of the stream, the cost of encoding and
+// decoding it, and whether every decoded table matches what its agent sent. With --serve the
+// agents keep running for a WinTaskMan started with their addresses instead.
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+  QCommandLineParser parser;
+  parser.setApplicationDescription(QStringLiteral("Load tests the agent stream with simulated hosts."));
+  parser.addHelpOption();
+  const QCommandLineOption hostsOption(QStringLiteral("hosts"), QStringLiteral("Number of simulated agents."), QStringLiteral("count"), QStringLiteral("50"));
+  const QCommandLineOption processesOption(QStringLiteral("processes"), QStringLiteral("Processes per host."), QStringLiteral("count"), QStringLiteral("10000"));
+  const QCommandLineOption ticksOption(QStringLiteral("ticks"), QStringLiteral("Measured ticks after the baseline."), QStringLiteral("count"), QStringLiteral("10"));
+  const QCommandLineOption intervalOption(QStringLiteral("interval"), QStringLiteral("Time between ticks."), QStringLiteral("ms"), QStringLiteral("1000"));
+  const QCommandLineOption activeOption(QStringLiteral("active"), QStringLiteral("Share of processes whose readings change per tick."), QStringLiteral("fraction"), QStringLiteral("0.1"));
+  const QCommandLineOption churnOption(QStringLiteral("churn"), QStringLiteral("Share of processes replaced per tick."), QStringLiteral("fraction"), QStringLiteral("0.002"));
+  const QCommandLineOption tcpOption(QStringLiteral("tcp"), QStringLiteral("Serve on TCP ports on localhost instead of Unix sockets."));
+  const QCommandLineOption serveOption(QStringLiteral("serve"), QStringLiteral("Only run the agents and print their addresses."));
+  parser.addOptions({hostsOption, processesOption, ticksOption, intervalOption, activeOption, churnOption, tcpOption, serveOption});
+  parser.process(app);
+
+  LoadOptions options;
+  options.processes = qMax(1, parser.value(processesOption).toInt());
+  options.activeFraction = parser.value(activeOption).toDouble();
+  options.churn = parser.value(churnOption).toDouble();
+  const int hostCount = qMax(1, parser.value(hostsOption).toInt());
+  const int ticks = qMax(1, parser.value(ticksOption).toInt());
+  const int interval = qMax(1, parser.value(intervalOption).toInt());
+  const bool serve = parser.isSet(serveOption);
+
+  QTemporaryDir socketDirectory;
+  if (!socketDirectory.isValid())
+  {
+    std::fprintf(stderr, "cannot create a socket directory\n");
+    return 1;
+  }
+
+  std::vector<std::unique_ptr<SimulatedAgent>> agents;
+  for (int index = 0; index < hostCount; ++index)
+  {
+    agents.push_back(std::make_unique<SimulatedAgent>(index, options));
+    if (!agents.back()->listen(parser.isSet(tcpOption), socketDirectory.path()))
+    {
+      std::fprintf(stderr, "cannot listen for agent %d\n", index);
+      return 1;
+    }
+    // The first tick makes the baseline that clients get on connect.
+    agents.back()->advance();
+    if (serve)
+      std::printf("%s\n", qPrintable(agents.back()->address()));
+  }
+  std::fflush(stdout);
+
+  QTimer tickTimer;
+  tickTimer.setInterval(interval);
+  if (serve)
+  {
+    QObject::connect(&tickTimer, &QTimer::timeout, [&agents]()
+                     {
+      for (const std::unique_ptr<SimulatedAgent> &agent : agents)
+        agent->advance(); });
+    tickTimer.start();
+    return app.exec();
+  }
+
+  QList<AgentConnection *> connections;
+  for (const std::unique_ptr<SimulatedAgent> &agent : agents)
+    connections.append(new AgentConnection(agent->address(), &app));
+
+  // Waits until every connection has decoded its agent's latest tick, or gives up.
+  const auto caughtUp = [&]()
+  {
+    for (int index = 0; index < hostCount; ++index)
+    {
+      const SampleStreamDecoder &stream = connections[index]->stream();
+      if (!stream.isSynchronized() || stream.tick() != agents[index]->tick())
+        return false;
+    }
+    return true;
+  };
+  const auto waitForConsumers = [&](int timeoutMs)
+  {
+    QElapsedTimer waited;
+    waited.start();
+    while (!caughtUp() && waited.elapsed() < timeoutMs)
+      QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+    return caughtUp();
+  };
+
+  if (!waitForConsumers(30000))
+  {
+    std::fprintf(stderr, "the connections did not receive their baselines\n");
+    return 1;
+  }
+
+  quint64 baselineBytes = 0;
+  quint64 bytesBefore = 0;
+  for (int index = 0; index < hostCount; ++index)
+  {
+    baselineBytes += agents[index]->baselineBytes();
+    bytesBefore += connections[index]->bytesReceived();
+  }
+
+  Instrumentation::histogram(Instrumentation::StreamDecode).reset();
+  Instrumentation::sampleSelfUsage();
+  QElapsedTimer elapsed;
+  elapsed.start();
+  int tick = 0;
+  bool lagging = false;
+  QObject::connect(&tickTimer, &QTimer::timeout, [&]()
+                   {
+    if (!caughtUp())
+      lagging = true;
+    for (const std::unique_ptr<SimulatedAgent> &agent : agents)
+      agent->advance();
+    if (++tick == ticks)
+    {
+      tickTimer.stop();
+      app.quit();
+    } });
+  tickTimer.start();
+  app.exec();
+  const bool delivered = waitForConsumers(30000);
+  const double seconds = elapsed.nsecsElapsed() / 1e9;
+  const Instrumentation::SelfUsage selfUsage = Instrumentation::sampleSelfUsage();
+
+  quint64 deltaBytes = 0;
+  quint64 bytesReceived = 0;
+  qint64 encodeNs = 0;
+  int mismatches = 0;
+  for (int index = 0; index < hostCount; ++index)
+  {
+    deltaBytes += agents[index]->deltaBytes();
+    encodeNs += agents[index]->encodeNs();
+    bytesReceived += connections[index]->bytesReceived();
+    mismatches += agents[index]->mismatches(connections[index]->stream());
+  }
+  bytesReceived -= bytesBefore;
+
+  const LatencyHistogram &decode = Instrumentation::histogram(Instrumentation::StreamDecode);
+  std::printf("hosts                  %d x %d processes, %d ticks every %d ms over %s\n", hostCount, options.processes, ticks, interval,
+              parser.isSet(tcpOption) ? "TCP" : "Unix sockets");
+  std::printf("baseline               %.1f KB per host\n", baselineBytes / 1024.0 / hostCount);
+  std::printf("delta                  %.1f KB per host and tick, %.2f bytes per process\n", deltaBytes / 1024.0 / hostCount / ticks,
+              double(deltaBytes) / (double(hostCount) * options.processes * ticks));
+  std::printf("stream                 %.1f KB/s received over all hosts\n", bytesReceived / 1024.0 / seconds);
+  std::printf("encode                 %.1f us per host and tick\n", encodeNs / 1e3 / (double(hostCount) * (ticks + 1)));
+  std::printf("decode                 p50 %.1f us, p99 %.1f us per read, %llu reads\n", decode.percentile(0.5) / 1e3,
+              decode.percentile(0.99) / 1e3, static_cast<unsigned long long>(decode.count()));
+  std::printf("harness                %.1f%% CPU, %.1f MB resident\n", selfUsage.cpuPercent, selfUsage.rssKb / 1024.0);
+  std::printf("consistency            %s, %d mismatched rows\n", delivered && !lagging ? "kept up" : "fell behind", mismatches);
+  return delivered && mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,402 @@
+#include "procfilecache.h"
+#include "procfixture.h"
+#include "procparser.h"
+#include "processtablemodel.h"
+#include "systemdataprovider.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QSortFilterProxyModel>
+#include <QTemporaryDir>
+#include <atomic>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+// Every heap allocation of the process goes through malloc, Qt's containers included, so the
+// glibc entry points are wrapped to count them.
+static std::atomic<quint64> allocationCount{0};
+
+extern "C"
+{
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void __libc_free(void *pointer);
+
+void *malloc(size_t size)
+{
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(pointer, size);
+}
+
+void free(void *pointer)
+{
+  __libc_free(pointer);
+}
+}
+
+namespace
+{
+struct Measurement
+{
+  qint64 elapsedNs = 0;
+  quint64 allocations = 0;
+};
+
+Measurement measure(const std::function<void()> &run)
+{
+  const quint64 allocationsBefore = allocationCount.load();
+  QElapsedTimer timer;
+  timer.start();
+  run();
+  Measurement measurement;
+  measurement.elapsedNs = timer.nsecsElapsed();
+  measurement.allocations = allocationCount.load() - allocationsBefore;
+  return measurement;
+}
+
+struct Collector
+{
+  const char *name;
+  bool includeProcesses;
+  bool includeApplications;
+  std::function<void(SystemDataProvider &)> run;
+};
+
+struct ParserInput
+{
+  QByteArray stat;
+  QByteArray cmdline;
+};
+
+// The stat and cmdline files of every process in the tree, read once so that the parsers are
+// timed without the file system.
+QVector<ParserInput> loadParserInputs(const QByteArray &procRoot)
+{
+  QVector<int> pids;
+  listProcessIds(procRoot, pids);
+
+  QVector<ParserInput> inputs;
+  inputs.reserve(pids.size());
+  char path[PATH_MAX];
+  for (const int pid : std::as_const(pids))
+  {
+    ParserInput input;
+    std::snprintf(path, sizeof(path), "%s/%d/stat", procRoot.constData(), pid);
+    if (readProcFile(path, input.stat) < 0)
+      continue;
+    std::snprintf(path, sizeof(path), "%s/%d/cmdline", procRoot.constData(), pid);
+    if (readProcFile(path, input.cmdline) < 0)
+      continue;
+    inputs.append(input);
+  }
+  return inputs;
+}
+
+// How the process list parsed these files before parseProcStat and joinCmdline: both are decoded
+// to QString and split into lists. Returns a checksum of the parsed fields.
+qint64 parseWithSplit(const ParserInput &input)
+{
+  const QString stat = QString::fromUtf8(input.stat);
+  const QString cmdline = QString::fromUtf8(input.cmdline);
+
+  const int begin = stat.indexOf('(');
+  const int end = stat.lastIndexOf(')');
+  if (begin < 0 || end < 0 || end <= begin)
+    return 0;
+
+  const QStringList statFields = stat.mid(end + 2).split(' ', Qt::SkipEmptyParts);
+  if (statFields.size() < 22)
+    return 0;
+
+  const QString commandLine = cmdline.split(QLatin1Char('\0'), Qt::SkipEmptyParts).join(' ').trimmed();
+  const QString statName = stat.mid(begin + 1, end - begin - 1);
+  const QString name = commandLine.isEmpty() ? statName : commandLine;
+  return statFields[11].toLong() + statFields[12].toLong() + statFields[19].toLong() + statFields[21].toLong() + name.size();
+}
+
+// The same fields through the byte level parser, the way the snapshot capture uses it.
+qint64 parseInPlace(const ParserInput &input, QByteArray &cmdlineBuffer)
+{
+  ProcStatFields stat;
+  if (!parseProcStat(input.stat.constData(), input.stat.size(), stat))
+    return 0;
+
+  // joinCmdline works in place, so it gets a copy in a reused buffer like the file buffer it
+  // normally runs on.
+  cmdlineBuffer.resize(input.cmdline.size());
+  std::memcpy(cmdlineBuffer.data(), input.cmdline.constData(), input.cmdline.size());
+  const qsizetype joinedLength = joinCmdline(cmdlineBuffer.data(), cmdlineBuffer.size());
+  const QString name = joinedLength > 0 ? QString::fromUtf8(cmdlineBuffer.constData(), joinedLength)
+                                        : QString::fromUtf8(stat.comm, stat.commLength);
+  return stat.utime + stat.stime + stat.starttime + stat.rssPages + name.size();
+}
+
+// Times what the Processes tab does per refresh: ProcessTableModel::setProcesses() followed by
+// the proxy's re-sort by CPU. Between ticks a tenth of the rows change their CPU and memory and
+// churn of them are replaced, half of those by a new process under the same PID.
+void benchmarkModel(int rows, int iterations, double churn)
+{
+  QRandomGenerator random(rows);
+  QList<ProcessInfo> processes;
+  processes.reserve(rows);
+  int nextPid = 1;
+  for (int row = 0; row < rows; ++row)
+  {
+    ProcessInfo process;
+    process.pid = nextPid++;
+    process.starttime = random.bounded(100000);
+    process.name = QStringLiteral("/usr/bin/process-%1 --option").arg(process.pid);
+    process.user = QStringLiteral("user%1").arg(random.bounded(4));
+    process.cpuPercent = random.bounded(1000) / 10.0;
+    process.memoryKb = random.bounded(1 << 20);
+    processes.append(process);
+  }
+
+  ProcessTableModel model;
+  QSortFilterProxyModel proxy;
+  proxy.setSourceModel(&model);
+  proxy.setSortRole(ProcessTableModel::SortRole);
+  proxy.setDynamicSortFilter(false);
+  const auto refresh = [&]()
+  {
+    model.setProcesses(processes);
+    proxy.sort(ProcessTableModel::CpuColumn, Qt::DescendingOrder);
+  };
+
+  const Measurement first = measure(refresh);
+  Measurement steady;
+  const int replaced = qMax(1, int(rows * churn));
+  for (int iteration = 0; iteration < iterations; ++iteration)
+  {
+    for (int change = 0; change < rows / 10; ++change)
+    {
+      ProcessInfo &process = processes[random.bounded(rows)];
+      process.cpuPercent = random.bounded(1000) / 10.0;
+      process.memoryKb += random.bounded(64);
+    }
+    for (int change = 0; change < replaced; ++change)
+    {
+      ProcessInfo &process = processes[random.bounded(rows)];
+      if (change % 2)
+        process.pid = nextPid++;
+      process.starttime += 100;
+      process.cpuPercent = 0.0;
+    }
+
+    const Measurement measurement = measure(refresh);
+    steady.elapsedNs += measurement.elapsedNs;
+    steady.allocations += measurement.allocations;
+  }
+
+  std::printf("%-22s %10d %14.1f %14.1f %16.2f\n", "setProcesses + sort", rows, first.elapsedNs / double(rows),
+              steady.elapsedNs / (double(rows) * iterations), steady.allocations / (double(rows) * iterations));
+}
+}
+
+// Runs refreshSystemUsage, refreshProcessList and the generic Wayland detector against fixture
+// trees of the given sizes. Every collector runs on its own tick, so each one pays for its own
+// /proc capture, and the tree is advanced between iterations so that the steady state includes
+// churn. The process table model is timed on synthetic lists of --model-rows rows, and the stat
+// and cmdline parsers are compared on the final tree's files, read into
+// memory beforehand. With --threads, whole process list ticks on a 50k process tree are timed
+// for every scan thread count up to the given one.
+int main(int argc, char *argv[])
+{
+  // Measure the cache with the descriptor limit the application runs with.
+  raiseOpenFileLimit();
+  // Point the application collector at the generic Wayland detector before the provider reads
+  // the session type.
+  qputenv("XDG_SESSION_TYPE", "wayland");
+  qputenv("WAYLAND_DISPLAY", "wayland-0");
+  qunsetenv("SWAYSOCK");
+
+  QCoreApplication app(argc, argv);
+  QCommandLineParser parser;
+  parser.setApplicationDescription(QStringLiteral("Benchmarks the collectors against synthetic /proc trees."));
+  parser.addHelpOption();
+  const QCommandLineOption sizesOption(QStringLiteral("sizes"), QStringLiteral("Comma separated process counts."), QStringLiteral("counts"), QStringLiteral("1000,10000,100000"));
+  const QCommandLineOption iterationsOption(QStringLiteral("iterations"), QStringLiteral("Measured ticks per size."), QStringLiteral("count"), QStringLiteral("10"));
+  const QCommandLineOption churnOption(QStringLiteral("churn"), QStringLiteral("Share of processes replaced per tick."), QStringLiteral("fraction"), QStringLiteral("0.01"));
+  const QCommandLineOption environOption(QStringLiteral("environ-bytes"), QStringLiteral("Size of each environ."), QStringLiteral("bytes"), QStringLiteral("2048"));
+  const QCommandLineOption directoryOption(QStringLiteral("directory"), QStringLiteral("Where to write the fixtures instead of a temporary directory."), QStringLiteral("path"));
+  const QCommandLineOption modelRowsOption(QStringLiteral("model-rows"), QStringLiteral("Comma separated row counts for the process table model."), QStringLiteral("counts"), QStringLiteral("1000,10000,50000"));
+  const QCommandLineOption threadsOption(QStringLiteral("threads"), QStringLiteral("Time ticks on a 50k process tree with 1 to this many scan threads."), QStringLiteral("count"));
+  parser.addOptions({sizesOption, iterationsOption, churnOption, environOption, directoryOption, modelRowsOption, threadsOption});
+  parser.process(app);
+
+  const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+  const double churn = parser.value(churnOption).toDouble();
+  const QString parentDirectory = parser.isSet(directoryOption) ? parser.value(directoryOption) : QDir::tempPath();
+
+  const QList<Collector> collectors = {
+      {"refreshSystemUsage", false, false, [](SystemDataProvider &provider)
+       { provider.refreshSystemUsage(); }},
+      {"refreshProcessList", true, false, [](SystemDataProvider &provider)
+       { provider.refreshProcessList(true); }},
+      {"waylandApplications", false, true, [](SystemDataProvider &provider)
+       { provider.refreshApplications(); }}};
+
+  std::printf("%-22s %10s %14s %14s %16s\n", "collector", "processes", "first ns/proc", "ns/process", "allocs/process");
+  for (const QString &sizeText : parser.value(sizesOption).split(','))
+  {
+    QTemporaryDir temporaryDirectory(parentDirectory + QStringLiteral("/wintaskman-procXXXXXX"));
+    if (!temporaryDirectory.isValid())
+    {
+      std::fprintf(stderr, "cannot create a fixture directory\n");
+      return 1;
+    }
+
+    ProcFixtureOptions options;
+    options.processes = sizeText.toInt();
+    options.environBytes = parser.value(environOption).toInt();
+    ProcFixture fixture(temporaryDirectory.path(), options);
+    if (!fixture.write())
+    {
+      std::fprintf(stderr, "cannot write %s\n", qPrintable(fixture.root()));
+      return 1;
+    }
+
+    SystemDataProvider provider(QFile::encodeName(fixture.root()));
+    // The kernel knows nothing of the fixture's sockets, so their peers come from the fixture.
+    provider.setUnixSocketPeerLookup([&fixture](QSet<quint64> &inodes)
+                                     { fixture.addSocketPeers(inodes); });
+    QVector<Measurement> first(collectors.size());
+    QVector<Measurement> steady(collectors.size());
+    for (int iteration = 0; iteration <= iterations; ++iteration)
+    {
+      if (iteration > 0 && !fixture.advance(churn))
+      {
+        std::fprintf(stderr, "cannot update %s\n", qPrintable(fixture.root()));
+        return 1;
+      }
+
+      for (int index = 0; index < collectors.size(); ++index)
+      {
+        const Collector &collector = collectors[index];
+        provider.beginTick(collector.includeProcesses, collector.includeApplications);
+        const Measurement measurement = measure([&]()
+                                                { collector.run(provider); });
+        Measurement &total = iteration == 0 ? first[index] : steady[index];
+        total.elapsedNs += measurement.elapsedNs;
+        total.allocations += measurement.allocations;
+      }
+    }
+
+    const double processes = fixture.processCount();
+    for (int index = 0; index < collectors.size(); ++index)
+    {
+      std::printf("%-22s %10d %14.1f %14.1f %16.2f\n", collectors[index].name, fixture.processCount(),
+                  first[index].elapsedNs / processes, steady[index].elapsedNs / (processes * iterations),
+                  steady[index].allocations / (processes * iterations));
+    }
+
+    const QVector<ParserInput> inputs = loadParserInputs(QFile::encodeName(fixture.root()));
+    QByteArray cmdlineBuffer;
+    qint64 splitChecksum = 0;
+    qint64 inPlaceChecksum = 0;
+    const QList<std::pair<const char *, std::function<void()>>> parsers = {
+        {"parseWithSplit", [&]()
+         {
+           for (const ParserInput &input : inputs)
+             splitChecksum += parseWithSplit(input);
+         }},
+        {"parseProcStat", [&]()
+         {
+           for (const ParserInput &input : inputs)
+             inPlaceChecksum += parseInPlace(input, cmdlineBuffer);
+         }}};
+    for (const auto &[name, run] : parsers)
+    {
+      Measurement parserFirst;
+      Measurement parserSteady;
+      for (int iteration = 0; iteration <= iterations; ++iteration)
+      {
+        const Measurement measurement = measure(run);
+        Measurement &total = iteration == 0 ? parserFirst : parserSteady;
+        total.elapsedNs += measurement.elapsedNs;
+        total.allocations += measurement.allocations;
+      }
+
+      const double parsed = qMax<qsizetype>(1, inputs.size());
+      std::printf("%-22s %10d %14.1f %14.1f %16.2f\n", name, int(inputs.size()), parserFirst.elapsedNs / parsed,
+                  parserSteady.elapsedNs / (parsed * iterations), parserSteady.allocations / (parsed * iterations));
+    }
+    if (splitChecksum != inPlaceChecksum)
+    {
+      std::fprintf(stderr, "the parsers disagree on %s\n", qPrintable(fixture.root()));
+      return 1;
+    }
+  }
+
+  for (const QString &rowsText : parser.value(modelRowsOption).split(','))
+    benchmarkModel(qMax(1, rowsText.toInt()), iterations, churn);
+
+  if (!parser.isSet(threadsOption))
+    return 0;
+
+  constexpr int threadSweepProcesses = 50000;
+  QTemporaryDir temporaryDirectory(parentDirectory + QStringLiteral("/wintaskman-procXXXXXX"));
+  ProcFixtureOptions options;
+  options.processes = threadSweepProcesses;
+  options.environBytes = parser.value(environOption).toInt();
+  ProcFixture fixture(temporaryDirectory.path(), options);
+  if (!temporaryDirectory.isValid() || !fixture.write())
+  {
+    std::fprintf(stderr, "cannot write a %d process fixture\n", threadSweepProcesses);
+    return 1;
+  }
+
+  // The first tick loads every identity, so it is left out of the timings.
+  SystemDataProvider provider(QFile::encodeName(fixture.root()));
+  provider.beginTick(true, false);
+  provider.refreshProcessList(true);
+
+  std::printf("\n%-12s %10s %14s %10s\n", "scan threads", "processes", "ms/tick", "speedup");
+  double singleThreadNs = 0.0;
+  const int maxThreads = qMax(1, parser.value(threadsOption).toInt());
+  for (int threads = 1; threads <= maxThreads; ++threads)
+  {
+    provider.setScanThreadCount(threads);
+    qint64 elapsedNs = 0;
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+      if (!fixture.advance(churn))
+      {
+        std::fprintf(stderr, "cannot update %s\n", qPrintable(fixture.root()));
+        return 1;
+      }
+      provider.beginTick(true, false);
+      const Measurement measurement = measure([&]()
+                                              {
+        provider.refreshSystemUsage();
+        provider.refreshProcessList(true); });
+      elapsedNs += measurement.elapsedNs;
+    }
+
+    const double tickNs = double(elapsedNs) / iterations;
+    if (threads == 1)
+      singleThreadNs = tickNs;
+    std::printf("%-12d %10d %14.2f %9.2fx\n", threads, fixture.processCount(), tickNs / 1e6, singleThreadNs / tickNs);
+  }
+  return 0;
+}
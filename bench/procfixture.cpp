@@ -0,0 +1,225 @@
+#include "procfixture.h"
+
+#include <QDir>
+#include <QFile>
+#include <cmath>
+#include <iterator>
+#include <unistd.h>
+
+static const char *const commonNames[] = {"bash", "systemd", "sshd", "python3", "kworker/0:1", "pipewire", "java", "cron", "dbus-daemon", "postgres"};
+static const char *const waylandNames[] = {"firefox", "foot", "code", "nautilus", "gimp", "thunderbird"};
+
+static bool writeFile(const QString &path, const QByteArray &data)
+{
+  QFile file(path);
+  return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(data) == data.size();
+}
+
+// Pads data with NUL separated filler entries up to size bytes.
+static void padEntries(QByteArray &data, int size, const char *fillerFormat)
+{
+  for (int index = 0; data.size() < size; ++index)
+  {
+    data += QByteArray(fillerFormat).replace("%d", QByteArray::number(index));
+    data += '\0';
+  }
+  data.truncate(qMax(size, 1) - 1);
+  data += '\0';
+}
+
+ProcFixture::ProcFixture(const QString &root, const ProcFixtureOptions &options)
+    : m_root(root), m_options(options), m_random(options.seed), m_coreBusy(options.cores, 0)
+{
+}
+
+bool ProcFixture::write()
+{
+  if (!QDir().mkpath(m_root + QStringLiteral("/net")))
+    return false;
+
+  m_processes.clear();
+  m_socketPeers.clear();
+  m_processes.reserve(m_options.processes);
+  for (int index = 0; index < m_options.processes; ++index)
+  {
+    m_processes.append(makeProcess(true));
+    if (!writeProcess(m_processes.constLast()))
+      return false;
+  }
+  return writeGlobalFiles();
+}
+
+bool ProcFixture::advance(double churn)
+{
+  m_ticks += 100;
+  for (qint64 &busy : m_coreBusy)
+    busy += m_random.bounded(101);
+
+  QVector<bool> replaced(m_processes.size(), false);
+  const int replacements = qBound(0, static_cast<int>(std::lround(churn * m_processes.size())), int(m_processes.size()));
+  for (int count = 0; count < replacements; ++count)
+  {
+    const int index = m_random.bounded(int(m_processes.size()));
+    if (replaced[index])
+      continue;
+    replaced[index] = true;
+
+    QDir(processPath(m_processes[index].pid)).removeRecursively();
+    m_socketPeers.remove(m_processes[index].socketInode);
+    m_socketPeers.remove(m_processes[index].serverSocketInode);
+    m_processes[index] = makeProcess(false);
+    if (!writeProcess(m_processes[index]))
+      return false;
+  }
+
+  for (int index = 0; index < m_processes.size(); ++index)
+  {
+    if (replaced[index])
+      continue;
+    Process &process = m_processes[index];
+    process.utime += m_random.bounded(10);
+    process.stime += m_random.bounded(3);
+    if (!writeStat(process))
+      return false;
+  }
+  return writeGlobalFiles();
+}
+
+void ProcFixture::addSocketPeers(QSet<quint64> &inodes) const
+{
+  QSet<quint64> peers;
+  for (const quint64 inode : std::as_const(inodes))
+  {
+    const auto peer = m_socketPeers.constFind(inode);
+    if (peer != m_socketPeers.cend())
+      peers.insert(*peer);
+  }
+  inodes.unite(peers);
+}
+
+ProcFixture::Process ProcFixture::makeProcess(bool initial)
+{
+  Process process;
+  process.pid = m_nextPid++;
+  process.ppid = process.pid > 1 ? 1 : 0;
+  // Processes of the initial tree started at some point before it was written.
+  process.starttime = initial ? m_random.bounded(int(m_ticks)) : m_ticks;
+  process.utime = m_random.bounded(1000);
+  process.stime = m_random.bounded(300);
+  process.rssPages = 100 + m_random.bounded(50000);
+  process.owned = m_random.generateDouble() < m_options.ownedFraction;
+  process.wayland = process.owned && m_random.generateDouble() < m_options.waylandFraction;
+  if (process.wayland)
+  {
+    process.comm = waylandNames[m_random.bounded(int(std::size(waylandNames)))];
+    process.socketInode = m_nextInode++;
+    process.serverSocketInode = m_nextInode++;
+    m_socketPeers.insert(process.socketInode, process.serverSocketInode);
+    m_socketPeers.insert(process.serverSocketInode, process.socketInode);
+  }
+  else
+  {
+    process.comm = commonNames[m_random.bounded(int(std::size(commonNames)))];
+  }
+  return process;
+}
+
+bool ProcFixture::writeProcess(const Process &process)
+{
+  const QString path = processPath(process.pid);
+  if (!QDir().mkpath(path))
+    return false;
+
+  const uid_t ownUid = geteuid();
+  const uid_t uid = process.owned ? ownUid : (ownUid == 0 ? 65534 : 0);
+  QByteArray status;
+  status += "Name:\t" + process.comm + "\nUmask:\t0022\nState:\tS (sleeping)\n";
+  status += "Tgid:\t" + QByteArray::number(process.pid) + "\nNgid:\t0\nPid:\t" + QByteArray::number(process.pid) + "\n";
+  status += "PPid:\t" + QByteArray::number(process.ppid) + "\nTracerPid:\t0\n";
+  const QByteArray uidText = QByteArray::number(uid);
+  status += "Uid:\t" + uidText + '\t' + uidText + '\t' + uidText + '\t' + uidText + "\n";
+  status += "Gid:\t" + uidText + '\t' + uidText + '\t' + uidText + '\t' + uidText + "\n";
+  status += "FDSize:\t64\nVmPeak:\t  200000 kB\nVmSize:\t  180000 kB\nVmRSS:\t" + QByteArray::number(process.rssPages * 4) + " kB\nThreads:\t4\n";
+
+  QByteArray cmdline = "/usr/bin/" + process.comm;
+  cmdline += '\0';
+  padEntries(cmdline, m_options.cmdlineBytes, "--option-%d");
+
+  // WAYLAND_DISPLAY sits in the middle, as it would after the session's own variables.
+  QByteArray environment;
+  padEntries(environment, m_options.environBytes / 2, "FIXTURE_VARIABLE_%d=some value");
+  if (process.wayland)
+    environment += QByteArrayLiteral("WAYLAND_DISPLAY=wayland-0") + '\0';
+  padEntries(environment, m_options.environBytes, "FIXTURE_SESSION_%d=another value");
+
+  if (!writeStat(process) || !writeFile(path + QStringLiteral("/status"), status) ||
+      !writeFile(path + QStringLiteral("/cmdline"), cmdline) || !writeFile(path + QStringLiteral("/environ"), environment))
+    return false;
+
+  // Only the fds of the current user's processes can be read on a live system.
+  if (!process.owned)
+    return true;
+  const QString fdPath = path + QStringLiteral("/fd");
+  if (!QDir().mkpath(fdPath))
+    return false;
+  for (const char *name : {"0", "1", "2"})
+    QFile::link(QStringLiteral("/dev/null"), fdPath + '/' + QLatin1String(name));
+  if (process.wayland)
+    QFile::link(QStringLiteral("socket:[%1]").arg(process.socketInode), fdPath + QStringLiteral("/3"));
+  return true;
+}
+
+bool ProcFixture::writeStat(const Process &process)
+{
+  const QByteArray stat = QByteArray::number(process.pid) + " (" + process.comm + ") S " + QByteArray::number(process.ppid) +
+                          " " + QByteArray::number(process.pid) + " " + QByteArray::number(process.pid) +
+                          " 0 -1 4194560 1000 0 0 0 " + QByteArray::number(process.utime) + " " + QByteArray::number(process.stime) +
+                          " 0 0 20 0 4 0 " + QByteArray::number(process.starttime) + " 184320000 " +
+                          QByteArray::number(process.rssPages) +
+                          " 18446744073709551615 1 1 0 0 0 0 0 4096 0 0 0 0 17 0 0 0 0 0 0 0 0 0 0 0 0 0 0\n";
+  return writeFile(processPath(process.pid) + QStringLiteral("/stat"), stat);
+}
+
+bool ProcFixture::writeGlobalFiles()
+{
+  // Each core is 100 ticks further on per advance(), split between user and idle time.
+  const qint64 elapsed = m_ticks;
+  QByteArray cores;
+  qint64 busyTotal = 0;
+  for (int core = 0; core < m_coreBusy.size(); ++core)
+  {
+    const qint64 busy = qMin(m_coreBusy[core], elapsed);
+    busyTotal += busy;
+    cores += "cpu" + QByteArray::number(core) + " " + QByteArray::number(busy) + " 0 0 " + QByteArray::number(elapsed - busy) + " 0 0 0 0 0 0\n";
+  }
+  const QByteArray stat = "cpu  " + QByteArray::number(busyTotal) + " 0 0 " + QByteArray::number(elapsed * m_coreBusy.size() - busyTotal) +
+                          " 0 0 0 0 0 0\n" + cores + "intr 0\nctxt 0\nbtime 0\nprocesses " + QByteArray::number(m_nextPid) +
+                          "\nprocs_running 1\nprocs_blocked 0\n";
+
+  const QByteArray meminfo = "MemTotal:       32000000 kB\nMemFree:         8000000 kB\nMemAvailable:   20000000 kB\n"
+                             "Buffers:          500000 kB\nCached:          9000000 kB\nSwapCached:            0 kB\n"
+                             "Shmem:            400000 kB\nSReclaimable:     600000 kB\n";
+
+  const QByteArray uptime = QByteArray::number(m_ticks / 100.0, 'f', 2) + " " + QByteArray::number(m_ticks / 100.0 * m_coreBusy.size(), 'f', 2) + "\n";
+
+  // The compositor's listening socket, and for every client the accepted end, bound to the
+  // compositor's path, and the client's own unnamed end, which its fd points at.
+  QByteArray unixSockets = "Num       RefCount Protocol Flags    Type St Inode Path\n"
+                           "0000000000000000: 00000002 00000000 00010000 0001 01 99999 /run/user/1000/wayland-0\n";
+  for (const Process &process : std::as_const(m_processes))
+  {
+    if (process.wayland)
+    {
+      unixSockets += "0000000000000000: 00000003 00000000 00000000 0001 03 " + QByteArray::number(process.serverSocketInode) + " /run/user/1000/wayland-0\n";
+      unixSockets += "0000000000000000: 00000003 00000000 00000000 0001 03 " + QByteArray::number(process.socketInode) + "\n";
+    }
+  }
+
+  return writeFile(m_root + QStringLiteral("/stat"), stat) && writeFile(m_root + QStringLiteral("/meminfo"), meminfo) &&
+         writeFile(m_root + QStringLiteral("/uptime"), uptime) && writeFile(m_root + QStringLiteral("/net/unix"), unixSockets);
+}
+
+QString ProcFixture::processPath(int pid) const
+{
+  return m_root + '/' + QString::number(pid);
+}
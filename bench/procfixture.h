@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QRandomGenerator>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+struct ProcFixtureOptions
+{
+  int processes = 1000;
+  int cores = 8;
+  // Sizes of each process's cmdline and environ files.
+  int cmdlineBytes = 96;
+  int environBytes = 2048;
+  // Share of processes owned by the current user, and of those, the share that are Wayland
+  // clients with WAYLAND_DISPLAY in their environment and a socket to the compositor.
+  double ownedFraction = 0.5;
+  double waylandFraction = 0.05;
+  quint32 seed = 1;
+};
+
+// Writes a synthetic procfs tree that the collectors can read instead of /proc: per process stat,
+// status, cmdline, environ and, for processes of the current user, an fd directory of socket
+// links, plus the global stat, meminfo, uptime and net/unix files. advance() then moves the tree
+// on by one tick the way a live system would, so the steady state of the collectors can be
+// measured as well as their first scan.
+class ProcFixture
+{
+public:
+  ProcFixture(const QString &root, const ProcFixtureOptions &options);
+
+  QString root() const { return m_root; }
+  int processCount() const { return m_processes.size(); }
+
+  // Writes the whole tree; returns false if a file could not be written.
+  bool write();
+  // Advances every CPU counter by one tick and replaces churn (0 to 1) of the processes with new
+  // ones under fresh PIDs.
+  bool advance(double churn);
+  // Stands in for sock_diag: adds the peers of the given sockets, that is the client end of
+  // every accepted compositor socket in the set and the other way round.
+  void addSocketPeers(QSet<quint64> &inodes) const;
+
+private:
+  struct Process
+  {
+    int pid = 0;
+    int ppid = 1;
+    qint64 starttime = 0;
+    qint64 utime = 0;
+    qint64 stime = 0;
+    qint64 rssPages = 0;
+    QByteArray comm;
+    bool owned = false;
+    bool wayland = false;
+    // The client's unnamed end, which its fd points at, and the compositor's accepted end,
+    // which is bound to the wayland-0 path.
+    quint64 socketInode = 0;
+    quint64 serverSocketInode = 0;
+  };
+
+  Process makeProcess(bool initial);
+  bool writeProcess(const Process &process);
+  bool writeStat(const Process &process);
+  bool writeGlobalFiles();
+  QString processPath(int pid) const;
+
+  QString m_root;
+  ProcFixtureOptions m_options;
+  QRandomGenerator m_random;
+  QVector<Process> m_processes;
+  QHash<quint64, quint64> m_socketPeers;
+  int m_nextPid = 1;
+  quint64 m_nextInode = 100000;
+  qint64 m_ticks = 100000;
+  QVector<qint64> m_coreBusy;
+};
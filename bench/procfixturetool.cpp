@@ -0,0 +1,57 @@
+#include "procfixture.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QThread>
+#include <cstdio>
+
+// Writes a synthetic procfs tree. With --ticks it keeps advancing the tree afterwards, so that a
+// collector pointed at it sees processes come and go.
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+  QCommandLineParser parser;
+  parser.setApplicationDescription(QStringLiteral("Writes a synthetic /proc tree for the collector benchmarks."));
+  parser.addHelpOption();
+  parser.addPositionalArgument(QStringLiteral("directory"), QStringLiteral("Where to write the tree."));
+  const QCommandLineOption processesOption(QStringLiteral("processes"), QStringLiteral("Number of processes."), QStringLiteral("count"), QStringLiteral("1000"));
+  const QCommandLineOption coresOption(QStringLiteral("cores"), QStringLiteral("Number of CPU cores."), QStringLiteral("count"), QStringLiteral("8"));
+  const QCommandLineOption cmdlineOption(QStringLiteral("cmdline-bytes"), QStringLiteral("Size of each cmdline."), QStringLiteral("bytes"), QStringLiteral("96"));
+  const QCommandLineOption environOption(QStringLiteral("environ-bytes"), QStringLiteral("Size of each environ."), QStringLiteral("bytes"), QStringLiteral("2048"));
+  const QCommandLineOption waylandOption(QStringLiteral("wayland-fraction"), QStringLiteral("Share of the user's processes that are Wayland clients."), QStringLiteral("fraction"), QStringLiteral("0.05"));
+  const QCommandLineOption churnOption(QStringLiteral("churn"), QStringLiteral("Share of processes replaced per tick."), QStringLiteral("fraction"), QStringLiteral("0.01"));
+  const QCommandLineOption ticksOption(QStringLiteral("ticks"), QStringLiteral("Number of ticks to advance the tree after writing it."), QStringLiteral("count"), QStringLiteral("0"));
+  const QCommandLineOption intervalOption(QStringLiteral("interval"), QStringLiteral("Time between ticks."), QStringLiteral("ms"), QStringLiteral("1000"));
+  parser.addOptions({processesOption, coresOption, cmdlineOption, environOption, waylandOption, churnOption, ticksOption, intervalOption});
+  parser.process(app);
+
+  if (parser.positionalArguments().size() != 1)
+    parser.showHelp(1);
+
+  ProcFixtureOptions options;
+  options.processes = parser.value(processesOption).toInt();
+  options.cores = qMax(1, parser.value(coresOption).toInt());
+  options.cmdlineBytes = parser.value(cmdlineOption).toInt();
+  options.environBytes = parser.value(environOption).toInt();
+  options.waylandFraction = parser.value(waylandOption).toDouble();
+
+  ProcFixture fixture(parser.positionalArguments().constFirst(), options);
+  if (!fixture.write())
+  {
+    std::fprintf(stderr, "cannot write %s\n", qPrintable(fixture.root()));
+    return 1;
+  }
+
+  const int ticks = parser.value(ticksOption).toInt();
+  const double churn = parser.value(churnOption).toDouble();
+  for (int tick = 0; tick < ticks; ++tick)
+  {
+    QThread::msleep(parser.value(intervalOption).toULong());
+    if (!fixture.advance(churn))
+    {
+      std::fprintf(stderr, "cannot update %s\n", qPrintable(fixture.root()));
+      return 1;
+    }
+  }
+  return 0;
+}
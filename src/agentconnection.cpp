@@ -0,0 +1,123 @@
+#include "agentconnection.h"
+#include "trace.h"
+
+static constexpr int retryIntervalMs = 3000;
+static constexpr qint64 readChunkSize = 64 * 1024;
+
+AgentConnection::AgentConnection(const QString &address, QObject *parent)
+    : QObject(parent), m_address(address.trimmed())
+{
+  m_retryTimer.setSingleShot(true);
+  m_retryTimer.setInterval(retryIntervalMs);
+  connect(&m_retryTimer, &QTimer::timeout, this, &AgentConnection::connectToAgent);
+
+  const int colon = m_address.lastIndexOf(':');
+  if (m_address.startsWith(QLatin1String("unix:")))
+    m_localPath = m_address.mid(5);
+  else if (m_address.startsWith('/'))
+    m_localPath = m_address;
+  else if (colon > 0)
+  {
+    bool ok = false;
+    m_host = m_address.left(colon);
+    m_port = m_address.mid(colon + 1).toUShort(&ok);
+    if (!ok)
+      m_port = 0;
+  }
+
+  if (!m_localPath.isEmpty())
+  {
+    m_device = &m_localSocket;
+    connect(&m_localSocket, &QLocalSocket::connected, this, &AgentConnection::onConnected);
+    connect(&m_localSocket, &QLocalSocket::readyRead, this, &AgentConnection::onReadyRead);
+    connect(&m_localSocket, &QLocalSocket::disconnected, this, &AgentConnection::onDisconnected);
+    connect(&m_localSocket, &QLocalSocket::errorOccurred, this, [this]()
+            { fail(m_localSocket.errorString()); });
+  }
+  else if (m_port != 0)
+  {
+    m_device = &m_tcpSocket;
+    connect(&m_tcpSocket, &QTcpSocket::connected, this, &AgentConnection::onConnected);
+    connect(&m_tcpSocket, &QTcpSocket::readyRead, this, &AgentConnection::onReadyRead);
+    connect(&m_tcpSocket, &QTcpSocket::disconnected, this, &AgentConnection::onDisconnected);
+    connect(&m_tcpSocket, &QTcpSocket::errorOccurred, this, [this]()
+            { fail(m_tcpSocket.errorString()); });
+  }
+  else
+  {
+    m_state = Disconnected;
+    m_errorString = QStringLiteral("Not a socket path or host:port");
+    return;
+  }
+
+  connectToAgent();
+}
+
+void AgentConnection::connectToAgent()
+{
+  m_decoder.reset();
+  setState(Connecting);
+  if (m_device == &m_localSocket)
+    m_localSocket.connectToServer(m_localPath);
+  else
+    m_tcpSocket.connectToHost(m_host, m_port);
+}
+
+void AgentConnection::onConnected()
+{
+  WTM_TRACE("agent", "connected to %s", qPrintable(m_address));
+  m_errorString.clear();
+  setState(Connected);
+}
+
+void AgentConnection::onReadyRead()
+{
+  const quint64 framesBefore = m_decoder.frameCount();
+  char buffer[readChunkSize];
+  for (;;)
+  {
+    const qint64 count = m_device->read(buffer, sizeof(buffer));
+    if (count <= 0)
+      break;
+    m_bytesReceived += quint64(count);
+    if (!m_decoder.feed(QByteArrayView(buffer, count)))
+    {
+      // A JSON Lines stream starts with its first frame where the binary header should be.
+      fail(!m_decoder.isSynchronized() && buffer[0] == '{' ? QStringLiteral("The agent sends JSON; start it with --format binary")
+                                                           : QStringLiteral("Malformed sample stream"));
+      return;
+    }
+  }
+
+  if (m_decoder.frameCount() != framesBefore)
+    emit updated();
+}
+
+void AgentConnection::onDisconnected()
+{
+  if (m_state != Disconnected)
+    fail(QStringLiteral("Connection closed"));
+}
+
+void AgentConnection::fail(const QString &errorString)
+{
+  if (m_state == Disconnected)
+    return;
+
+  WTM_TRACE("agent", "%s: %s", qPrintable(m_address), qPrintable(errorString));
+  m_errorString = errorString;
+  setState(Disconnected);
+  if (m_device == &m_localSocket)
+    m_localSocket.abort();
+  else
+    m_tcpSocket.abort();
+  m_retryTimer.start();
+}
+
+void AgentConnection::setState(State state)
+{
+  if (m_state == state)
+    return;
+  m_state = state;
+  emit stateChanged();
+}
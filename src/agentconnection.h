@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QLocalSocket>
+#include <QObject>
+#include <QString>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include "samplestream.h"
+
+// Follows the binary stream of one wintaskman-agent and keeps the state it describes. The
+// address is either a Unix socket path ("unix:<path>" or an absolute path) or "<host>:<port>".
+// Lost connections are retried every few seconds and start over from the baseline the agent
+// sends on connect.
+class AgentConnection : public QObject
+{
+  Q_OBJECT
+
+public:
+  enum State
+  {
+    Connecting,
+    Connected,
+    Disconnected
+  };
+
+  // Has to be created on a thread that runs an event loop; the socket reports there.
+  explicit AgentConnection(const QString &address, QObject *parent = nullptr);
+
+  QString address() const { return m_address; }
+  State state() const { return m_state; }
+  // Why the last connection attempt failed or was dropped; empty while connected.
+  QString errorString() const { return m_errorString; }
+  quint64 bytesReceived() const { return m_bytesReceived; }
+  const SampleStreamDecoder &stream() const { return m_decoder; }
+
+signals:
+  // Emitted once per read that applied at least one frame.
+  void updated();
+  void stateChanged();
+
+private slots:
+  void connectToAgent();
+  void onConnected();
+  void onReadyRead();
+  void onDisconnected();
+
+private:
+  void fail(const QString &errorString);
+  void setState(State state);
+
+  QString m_address;
+  QString m_localPath;
+  QString m_host;
+  quint16 m_port = 0;
+  QLocalSocket m_localSocket;
+  QTcpSocket m_tcpSocket;
+  // Whichever of the two sockets the address selects.
+  QIODevice *m_device = nullptr;
+  QTimer m_retryTimer;
+  SampleStreamDecoder m_decoder;
+  State m_state = Connecting;
+  QString m_errorString;
+  quint64 m_bytesReceived = 0;
+};
@@ -0,0 +1,207 @@
+#include "collectorscheduler.h"
+#include "trace.h"
+
+#include <QEvent>
+#include <QStringList>
+#include <QTimer>
+#include <QWidget>
+#include <QWindow>
+
+static QString formatMs(qint64 nanoseconds)
+{
+  return QString::number(nanoseconds / 1e6, 'f', 1);
+}
+
+CollectorScheduler::CollectorScheduler(QWidget *window, QObject *parent)
+    : QObject(parent), m_window(window)
+{
+  // Coarse timers may be aligned with other wakeups in the process, which is fine at this cadence.
+  m_timer = new QTimer(this);
+  m_timer->setTimerType(Qt::CoarseTimer);
+  connect(m_timer, &QTimer::timeout, this, &CollectorScheduler::onTick);
+
+  m_window->installEventFilter(this);
+}
+
+int CollectorScheduler::addCollector(const QString &name, int cadence, double budget, bool suspendWhenHidden, std::function<bool()> start)
+{
+  Collector collector;
+  collector.name = name;
+  collector.cadence = qMax(1, cadence);
+  collector.budget = budget;
+  collector.suspendWhenHidden = suspendWhenHidden;
+  collector.start = std::move(start);
+  m_collectors.append(std::move(collector));
+  return m_collectors.size() - 1;
+}
+
+void CollectorScheduler::setBaseInterval(int milliseconds)
+{
+  m_baseInterval = qMax(0, milliseconds);
+  if (m_baseInterval > 0)
+    m_timer->start(m_baseInterval);
+  else
+    m_timer->stop();
+}
+
+int CollectorScheduler::baseInterval() const
+{
+  return m_baseInterval;
+}
+
+void CollectorScheduler::run(int id)
+{
+  if (id >= 0 && id < m_collectors.size())
+    start(m_collectors[id]);
+}
+
+void CollectorScheduler::runAll()
+{
+  updateExposure();
+
+  QVector<int> due;
+  for (int id = 0; id < m_collectors.size(); ++id)
+  {
+    if (m_exposed || !m_collectors[id].suspendWhenHidden)
+      due.append(id);
+  }
+
+  emit aboutToStart(due);
+  for (int id : std::as_const(due))
+    start(m_collectors[id]);
+}
+
+void CollectorScheduler::onTick()
+{
+  ++m_tick;
+  updateExposure();
+
+  QVector<int> due;
+  for (int id = 0; id < m_collectors.size(); ++id)
+  {
+    Collector &collector = m_collectors[id];
+    if (collector.suspendWhenHidden && !m_exposed)
+      continue;
+    if (m_tick % effectiveCadence(collector) != 0)
+      continue;
+
+    // Still busy with the previous run when the next one is due.
+    if (collector.running)
+    {
+      ++collector.overruns;
+      collector.backoff = qMin(maxBackoff, collector.backoff * 2);
+      WTM_TRACE("scheduler", "%s still running at tick %llu, cadence now %d", qPrintable(collector.name),
+                static_cast<unsigned long long>(m_tick), effectiveCadence(collector));
+      continue;
+    }
+
+    due.append(id);
+  }
+
+  if (due.isEmpty())
+    return;
+
+  emit aboutToStart(due);
+  for (int id : std::as_const(due))
+    start(m_collectors[id]);
+}
+
+void CollectorScheduler::start(Collector &collector)
+{
+  if (collector.running || !collector.start())
+    return;
+
+  collector.running = true;
+  collector.runTimer.start();
+}
+
+void CollectorScheduler::collectorFinished(int id)
+{
+  if (id < 0 || id >= m_collectors.size() || !m_collectors[id].running)
+    return;
+
+  Collector &collector = m_collectors[id];
+  const qint64 elapsed = collector.runTimer.nsecsElapsed();
+  collector.running = false;
+  collector.lastNs = elapsed;
+  collector.averageNs = collector.averageNs > 0 ? (collector.averageNs * 7 + elapsed) / 8 : elapsed;
+  collector.maxNs = qMax(collector.maxNs, elapsed);
+
+  if (m_baseInterval > 0)
+  {
+    const double budgetNs = collector.budget * effectiveCadence(collector) * m_baseInterval * 1e6;
+    if (elapsed > budgetNs)
+    {
+      ++collector.overruns;
+      collector.backoff = qMin(maxBackoff, collector.backoff * 2);
+    }
+    else if (collector.backoff > 1 && elapsed < budgetNs / 4)
+    {
+      collector.backoff /= 2;
+    }
+  }
+
+  WTM_TRACE("scheduler", "%s took %lld us, cadence %d", qPrintable(collector.name),
+            static_cast<long long>(elapsed / 1000), effectiveCadence(collector));
+}
+
+bool CollectorScheduler::isExposed() const
+{
+  return m_exposed;
+}
+
+QString CollectorScheduler::timingSummary() const
+{
+  QStringList lines;
+  for (const Collector &collector : m_collectors)
+  {
+    QString line = QString("%1: every %2 ms, last %3 ms, avg %4 ms, max %5 ms")
+                       .arg(collector.name)
+                       .arg(effectiveCadence(collector) * m_baseInterval)
+                       .arg(formatMs(collector.lastNs))
+                       .arg(formatMs(collector.averageNs))
+                       .arg(formatMs(collector.maxNs));
+    if (collector.overruns > 0)
+      line += QString(", %1 overruns").arg(collector.overruns);
+    if (collector.suspendWhenHidden && !m_exposed)
+      line += ", suspended";
+    lines.append(line);
+  }
+  return lines.join('\n');
+}
+
+bool CollectorScheduler::eventFilter(QObject *watched, QEvent *event)
+{
+  switch (event->type())
+  {
+  case QEvent::Show:
+  case QEvent::Hide:
+  case QEvent::WindowStateChange:
+  case QEvent::Expose:
+    if (watched == m_window || watched == m_watchedWindow)
+      updateExposure();
+    break;
+  default:
+    break;
+  }
+  return QObject::eventFilter(watched, event);
+}
+
+void CollectorScheduler::updateExposure()
+{
+  // Expose events are delivered to the native window, which only exists once the widget is shown.
+  QWindow *window = m_window->windowHandle();
+  if (window && window != m_watchedWindow)
+  {
+    window->installEventFilter(this);
+    m_watchedWindow = window;
+  }
+
+  const bool exposed = m_window->isVisible() && !m_window->isMinimized() && (!window || window->isExposed());
+  if (exposed == m_exposed)
+    return;
+
+  m_exposed = exposed;
+  WTM_TRACE("scheduler", "window %s", exposed ? "exposed" : "hidden");
+  emit exposedChanged(exposed);
+}
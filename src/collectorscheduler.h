@@ -0,0 +1,82 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <functional>
+
+class QTimer;
+class QWidget;
+class QWindow;
+
+// Runs the data collectors off one base timer. Every collector fires on the base ticks that are
+// a multiple of its cadence, so collectors due at the same time share a single wakeup. A run that
+// takes longer than its share (budget) of the collector's interval doubles the cadence, and the
+// cadence recovers once runs are comfortably inside the budget again. Collectors marked as
+// suspendWhenHidden do not run while the window is minimized or otherwise not exposed.
+class CollectorScheduler : public QObject
+{
+  Q_OBJECT
+
+public:
+  explicit CollectorScheduler(QWidget *window, QObject *parent = nullptr);
+
+  // start() launches the collector and returns false if it did not start; the owner reports
+  // completion through collectorFinished(). Returns the collector's id.
+  int addCollector(const QString &name, int cadence, double budget, bool suspendWhenHidden, std::function<bool()> start);
+
+  // 0 pauses the timer; run() and runAll() keep working.
+  void setBaseInterval(int milliseconds);
+  int baseInterval() const;
+
+  // Start one collector, or every collector that is not suspended, regardless of cadence.
+  void run(int id);
+  void runAll();
+  void collectorFinished(int id);
+
+  bool isExposed() const;
+  // One line per collector with its cadence and run times, for tooltips.
+  QString timingSummary() const;
+
+signals:
+  // Emitted before the collectors of a tick are started, with the ids of those that are due.
+  void aboutToStart(const QVector<int> &due);
+  void exposedChanged(bool exposed);
+
+protected:
+  bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+  struct Collector
+  {
+    QString name;
+    int cadence = 1;
+    double budget = 0.5;
+    bool suspendWhenHidden = false;
+    std::function<bool()> start;
+
+    int backoff = 1;
+    bool running = false;
+    QElapsedTimer runTimer;
+    qint64 lastNs = 0;
+    qint64 averageNs = 0;
+    qint64 maxNs = 0;
+    int overruns = 0;
+  };
+
+  static constexpr int maxBackoff = 16;
+
+  void onTick();
+  void start(Collector &collector);
+  void updateExposure();
+  int effectiveCadence(const Collector &collector) const { return collector.cadence * collector.backoff; }
+
+  QWidget *m_window = nullptr;
+  QWindow *m_watchedWindow = nullptr;
+  QTimer *m_timer = nullptr;
+  QVector<Collector> m_collectors;
+  quint64 m_tick = 0;
+  int m_baseInterval = 1000;
+  bool m_exposed = true;
+};
@@ -0,0 +1,98 @@
+#include "commandexecutor.h"
+#include "instrumentation.h"
+#include "procfilecache.h"
+#include "trace.h"
+
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QTimer>
+
+CommandExecutor::CommandExecutor()
+{
+  m_thread.setObjectName("CommandExecutor");
+  m_context = new QObject;
+  m_context->moveToThread(&m_thread);
+  m_thread.start();
+}
+
+CommandExecutor::~CommandExecutor()
+{
+  // Kill whatever is still running on the executor thread so every finished handler is called.
+  QMetaObject::invokeMethod(
+      m_context, [this]()
+      {
+        for (QProcess *process : m_context->findChildren<QProcess *>())
+        {
+          process->kill();
+          process->waitForFinished(1000);
+          delete process;
+        } },
+      Qt::BlockingQueuedConnection);
+
+  m_thread.quit();
+  m_thread.wait();
+  delete m_context;
+}
+
+void CommandExecutor::run(const Command &command, OutputHandler onOutput, FinishedHandler onFinished)
+{
+  QMetaObject::invokeMethod(m_context, [this, command, onOutput = std::move(onOutput), onFinished = std::move(onFinished)]()
+                            {
+    QProcess *process = new QProcess(m_context);
+    QTimer *deadline = new QTimer(process);
+    auto done = std::make_shared<bool>(false);
+
+    // Reports the result once. The process is only deleted once it has actually exited, which
+    // after a kill() at the deadline can be well after the result was reported.
+    auto finish = [onFinished, done, program = command.program](bool ok)
+    {
+      if (*done)
+        return;
+      *done = true;
+      WTM_TRACE("executor", "%s %s", qPrintable(program), ok ? "finished" : "failed");
+      onFinished(ok);
+    };
+
+    process->setProcessEnvironment(QProcessEnvironment::systemEnvironment());
+    process->setStandardErrorFile(QProcess::nullDevice());
+    process->setProgram(command.program);
+    process->setArguments(command.arguments);
+    process->setChildProcessModifier(restoreOpenFileLimit);
+
+    QObject::connect(process, &QProcess::readyReadStandardOutput, process, [process, onOutput, done]()
+                     {
+      const QByteArray data = process->readAllStandardOutput();
+      if (!*done)
+        onOutput(QByteArrayView(data)); });
+    QObject::connect(process, &QProcess::finished, process, [process, onOutput, finish, done](int exitCode, QProcess::ExitStatus exitStatus)
+                     {
+      const QByteArray rest = process->readAllStandardOutput();
+      if (!rest.isEmpty() && !*done)
+        onOutput(QByteArrayView(rest));
+      finish(exitStatus == QProcess::NormalExit && exitCode == 0);
+      process->deleteLater(); });
+    QObject::connect(process, &QProcess::errorOccurred, process, [process, finish](QProcess::ProcessError error)
+                     {
+      // A process that failed to start never emits finished.
+      if (error == QProcess::FailedToStart)
+      {
+        finish(false);
+        process->deleteLater();
+      }
+      else if (error == QProcess::Crashed)
+      {
+        process->deleteLater();
+      } });
+
+    deadline->setSingleShot(true);
+    QObject::connect(deadline, &QTimer::timeout, process, [process, finish, program = command.program]()
+                     {
+      WTM_TRACE("executor", "%s missed its deadline, killing it", qPrintable(program));
+      process->kill();
+      finish(false); });
+    deadline->start(command.timeoutMs);
+
+    process->start();
+    Instrumentation::countSyscall(Instrumentation::Spawn); },
+                            Qt::QueuedConnection);
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <functional>
+#include <memory>
+
+// Runs external commands on its own thread with non-blocking QProcess signals, so a hung
+// systemctl or rc-status never ties up a collector thread. Every command has a deadline after
+// which it is killed, and its output is handed over chunk by chunk as it arrives.
+class CommandExecutor
+{
+public:
+  struct Command
+  {
+    QString program;
+    QStringList arguments;
+    int timeoutMs = 5000;
+  };
+
+  // Both handlers run on the executor thread. finished is called exactly once per run; ok is false
+  // if the command could not be started, was killed at its deadline or did not exit with status 0.
+  using OutputHandler = std::function<void(QByteArrayView data)>;
+  using FinishedHandler = std::function<void(bool ok)>;
+
+  CommandExecutor();
+  ~CommandExecutor();
+
+  CommandExecutor(const CommandExecutor &) = delete;
+  CommandExecutor &operator=(const CommandExecutor &) = delete;
+
+  // Thread-safe; returns immediately.
+  void run(const Command &command, OutputHandler onOutput, FinishedHandler onFinished);
+
+private:
+  QThread m_thread;
+  QObject *m_context = nullptr;
+};
+
+// Incremental parser fed with the output of one command run.
+template <typename Result>
+class StreamParser
+{
+public:
+  virtual ~StreamParser() = default;
+  virtual void feed(QByteArrayView data) = 0;
+  // Completes the result; returns false if the output was not what the parser expected.
+  virtual bool finish(Result &result) = 0;
+};
+
+// Splits streamed output into lines, keeping an incomplete last line until more data arrives.
+class LineSplitter
+{
+public:
+  template <typename Handler>
+  void feed(QByteArrayView data, Handler handleLine)
+  {
+    qsizetype start = 0;
+    for (qsizetype newline = data.indexOf('\n'); newline >= 0; newline = data.indexOf('\n', start))
+    {
+      if (m_partial.isEmpty())
+      {
+        handleLine(data.sliced(start, newline - start));
+      }
+      else
+      {
+        m_partial.append(data.sliced(start, newline - start));
+        handleLine(QByteArrayView(m_partial));
+        m_partial.clear();
+      }
+      start = newline + 1;
+    }
+    m_partial.append(data.sliced(start));
+  }
+
+  template <typename Handler>
+  void flush(Handler handleLine)
+  {
+    if (!m_partial.isEmpty())
+      handleLine(QByteArrayView(m_partial));
+    m_partial.clear();
+  }
+
+private:
+  QByteArray m_partial;
+};
+
+// One command whose latest successful result is kept. latest() starts a new run unless one is
+// already pending and returns the last good result straight away, so it never blocks; until the
+// first run has completed there is no result, and a later call picks it up.
+template <typename Result>
+class CommandQuery
+{
+public:
+  using ParserFactory = std::function<std::unique_ptr<StreamParser<Result>>()>;
+
+  CommandQuery(CommandExecutor &executor, CommandExecutor::Command command, ParserFactory makeParser)
+      : m_executor(executor), m_command(std::move(command)), m_makeParser(std::move(makeParser)), m_state(new State)
+  {
+  }
+
+  Result latest(bool *hasResult = nullptr)
+  {
+    QMutexLocker locker(&m_state->mutex);
+    if (!m_state->pending)
+      start();
+
+    if (hasResult)
+      *hasResult = m_state->hasResult;
+    return m_state->result;
+  }
+
+  // Thread-safe; whether any run has finished, successfully or not.
+  bool hasCompleted() const
+  {
+    QMutexLocker locker(&m_state->mutex);
+    return m_state->completed;
+  }
+
+private:
+  struct State
+  {
+    QMutex mutex;
+    bool pending = false;
+    bool hasResult = false;
+    bool completed = false;
+    Result result;
+  };
+
+  // Called with the state locked.
+  void start()
+  {
+    m_state->pending = true;
+    std::shared_ptr<StreamParser<Result>> parser(m_makeParser());
+    const QSharedPointer<State> state = m_state;
+    m_executor.run(
+        m_command, [parser](QByteArrayView data)
+        { parser->feed(data); },
+        [parser, state](bool ok)
+        {
+          Result result;
+          ok = parser->finish(result) && ok;
+
+          QMutexLocker locker(&state->mutex);
+          if (ok)
+          {
+            state->result = std::move(result);
+            state->hasResult = true;
+          }
+          state->pending = false;
+          state->completed = true;
+        });
+  }
+
+  CommandExecutor &m_executor;
+  CommandExecutor::Command m_command;
+  ParserFactory m_makeParser;
+  QSharedPointer<State> m_state;
+};
@@ -0,0 +1,125 @@
+#include "diagnosticsdialog.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QIcon>
+#include <QLabel>
+#include <QPushButton>
+#include <QTimer>
+#include <QTreeWidget>
+
+static QString formatLatency(qint64 nanoseconds)
+{
+  if (nanoseconds >= 1000000)
+    return QString::number(nanoseconds / 1e6, 'f', 2) + " ms";
+  return QString::number(nanoseconds / 1e3, 'f', 1) + " us";
+}
+
+DiagnosticsDialog::DiagnosticsDialog(QWidget *parent)
+    : QDialog(parent)
+{
+  setWindowTitle("Diagnostics");
+  setWindowIcon(QIcon(":/src/assets/icons/taskmgr.ico"));
+  setMinimumSize(560, 420);
+  setWindowFlags(windowFlags() & ~Qt::WindowContextHelpButtonHint);
+  setupUI();
+
+  // Only polls the counters while the dialog is on screen.
+  m_refreshTimer = new QTimer(this);
+  m_refreshTimer->setInterval(1000);
+  connect(m_refreshTimer, &QTimer::timeout, this, &DiagnosticsDialog::refresh);
+  connect(m_resetButton, &QPushButton::clicked, this, &DiagnosticsDialog::onResetClicked);
+  connect(m_closeButton, &QPushButton::clicked, this, &QDialog::close);
+}
+
+void DiagnosticsDialog::setupUI()
+{
+  QVBoxLayout *mainLayout = new QVBoxLayout(this);
+  mainLayout->setContentsMargins(12, 12, 12, 12);
+  mainLayout->setSpacing(8);
+
+  m_selfUsageLabel = new QLabel(this);
+  mainLayout->addWidget(m_selfUsageLabel);
+
+  m_stageTable = new QTreeWidget(this);
+  m_stageTable->setColumnCount(7);
+  m_stageTable->setHeaderLabels({"Stage", "Runs", "p50", "p90", "p99", "Max", "Mean"});
+  m_stageTable->setRootIsDecorated(false);
+  m_stageTable->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+  for (int stage = 0; stage < Instrumentation::StageCount; ++stage)
+  {
+    QTreeWidgetItem *item = new QTreeWidgetItem(m_stageTable);
+    item->setText(0, Instrumentation::stageName(static_cast<Instrumentation::Stage>(stage)));
+    for (int column = 1; column < 7; ++column)
+      item->setTextAlignment(column, Qt::AlignRight);
+  }
+  mainLayout->addWidget(m_stageTable, 2);
+
+  m_syscallTable = new QTreeWidget(this);
+  m_syscallTable->setColumnCount(2);
+  m_syscallTable->setHeaderLabels({"Operation", "Count"});
+  m_syscallTable->setRootIsDecorated(false);
+  m_syscallTable->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+  for (int syscall = 0; syscall < Instrumentation::SyscallCount; ++syscall)
+  {
+    QTreeWidgetItem *item = new QTreeWidgetItem(m_syscallTable);
+    item->setText(0, Instrumentation::syscallName(static_cast<Instrumentation::Syscall>(syscall)));
+    item->setTextAlignment(1, Qt::AlignRight);
+  }
+  mainLayout->addWidget(m_syscallTable, 1);
+
+  QHBoxLayout *buttonLayout = new QHBoxLayout();
+  buttonLayout->addStretch();
+  m_resetButton = new QPushButton("Reset", this);
+  m_closeButton = new QPushButton("Close", this);
+  buttonLayout->addWidget(m_resetButton);
+  buttonLayout->addWidget(m_closeButton);
+  mainLayout->addLayout(buttonLayout);
+}
+
+void DiagnosticsDialog::setSelfUsage(const Instrumentation::SelfUsage &usage)
+{
+  m_selfUsageLabel->setText(QString("Task Manager itself: %1% CPU, %2 MB resident")
+                                .arg(QString::number(usage.cpuPercent, 'f', 1))
+                                .arg(QString::number(usage.rssKb / 1024.0, 'f', 1)));
+}
+
+void DiagnosticsDialog::showEvent(QShowEvent *event)
+{
+  QDialog::showEvent(event);
+  refresh();
+  m_refreshTimer->start();
+}
+
+void DiagnosticsDialog::hideEvent(QHideEvent *event)
+{
+  m_refreshTimer->stop();
+  QDialog::hideEvent(event);
+}
+
+void DiagnosticsDialog::refresh()
+{
+  for (int stage = 0; stage < Instrumentation::StageCount; ++stage)
+  {
+    const LatencyHistogram &histogram = Instrumentation::histogram(static_cast<Instrumentation::Stage>(stage));
+    QTreeWidgetItem *item = m_stageTable->topLevelItem(stage);
+    item->setText(1, QString::number(histogram.count()));
+    item->setText(2, formatLatency(histogram.percentile(0.5)));
+    item->setText(3, formatLatency(histogram.percentile(0.9)));
+    item->setText(4, formatLatency(histogram.percentile(0.99)));
+    item->setText(5, formatLatency(histogram.max()));
+    item->setText(6, formatLatency(histogram.mean()));
+  }
+
+  for (int syscall = 0; syscall < Instrumentation::SyscallCount; ++syscall)
+  {
+    const quint64 count = Instrumentation::syscallCount(static_cast<Instrumentation::Syscall>(syscall));
+    m_syscallTable->topLevelItem(syscall)->setText(1, QString::number(count));
+  }
+}
+
+void DiagnosticsDialog::onResetClicked()
+{
+  Instrumentation::reset();
+  refresh();
+}
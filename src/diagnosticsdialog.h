@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QDialog>
+
+#include "instrumentation.h"
+
+class QLabel;
+class QPushButton;
+class QTimer;
+class QTreeWidget;
+
+// Shows how much the task manager itself costs: latency percentiles of every collector and
+// GUI update stage, system call counts and the process's own CPU and memory use.
+class DiagnosticsDialog : public QDialog
+{
+  Q_OBJECT
+
+public:
+  explicit DiagnosticsDialog(QWidget *parent = nullptr);
+
+  void setSelfUsage(const Instrumentation::SelfUsage &usage);
+
+protected:
+  void showEvent(QShowEvent *event) override;
+  void hideEvent(QHideEvent *event) override;
+
+private slots:
+  void refresh();
+  void onResetClicked();
+
+private:
+  void setupUI();
+
+  QLabel *m_selfUsageLabel = nullptr;
+  QTreeWidget *m_stageTable = nullptr;
+  QTreeWidget *m_syscallTable = nullptr;
+  QPushButton *m_resetButton = nullptr;
+  QPushButton *m_closeButton = nullptr;
+  QTimer *m_refreshTimer = nullptr;
+};
@@ -1,9 +1,142 @@
 #include <QString>
+#include <QHash>
+#include <QReadWriteLock>
 #include <pwd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "helperutils.h"
 
+namespace
+{
+constexpr qint64 passwdCheckIntervalMs = 1000;
+constexpr qint64 negativeEntryTtlMs = 60 * 1000;
+
+struct UserNameEntry
+{
+  QString name;
+  bool found = false;
+  qint64 resolvedAtMs = 0;
+};
+
+// One resolution of one uid. Scan workers that ask for a uid while it is being resolved wait on
+// the once_flag instead of each sending the same query to NSS.
+struct UserNameLookup
+{
+  std::once_flag resolved;
+  UserNameEntry entry;
+};
+
+// Process wide uid -> name cache. Names are resolved once and handed out as shared QStrings;
+// the whole cache is dropped when /etc/passwd is replaced or modified.
+struct UserNameCache
+{
+  QReadWriteLock lock;
+  QHash<uid_t, std::shared_ptr<UserNameLookup>> entries;
+  std::atomic<qint64> nextPasswdCheckMs{0};
+  timespec passwdMtime{};
+  ino_t passwdInode = 0;
+};
+
+UserNameCache &userNameCache()
+{
+  static UserNameCache cache;
+  return cache;
+}
+
+qint64 monotonicMs()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void invalidateIfPasswdChanged(UserNameCache &cache, qint64 nowMs)
+{
+  qint64 nextCheckMs = cache.nextPasswdCheckMs.load(std::memory_order_relaxed);
+  if (nowMs < nextCheckMs || !cache.nextPasswdCheckMs.compare_exchange_strong(nextCheckMs, nowMs + passwdCheckIntervalMs))
+    return;
+
+  struct stat passwdStat;
+  if (stat("/etc/passwd", &passwdStat) != 0)
+    return;
+
+  QWriteLocker locker(&cache.lock);
+  if (passwdStat.st_ino != cache.passwdInode || passwdStat.st_mtim.tv_sec != cache.passwdMtime.tv_sec ||
+      passwdStat.st_mtim.tv_nsec != cache.passwdMtime.tv_nsec)
+  {
+    cache.entries.clear();
+    cache.passwdInode = passwdStat.st_ino;
+    cache.passwdMtime = passwdStat.st_mtim;
+  }
+}
+
+UserNameEntry resolveUserName(uid_t uid, qint64 nowMs)
+{
+  const long suggestedSize = sysconf(_SC_GETPW_R_SIZE_MAX);
+  std::vector<char> buffer(suggestedSize > 0 ? static_cast<size_t>(suggestedSize) : 1024);
+
+  UserNameEntry entry;
+  entry.resolvedAtMs = nowMs;
+
+  struct passwd pwd;
+  struct passwd *result = nullptr;
+  int error = 0;
+  while ((error = getpwuid_r(uid, &pwd, buffer.data(), buffer.size(), &result)) == ERANGE && buffer.size() < 1024 * 1024)
+    buffer.resize(buffer.size() * 2);
+
+  if (error == 0 && result)
+  {
+    entry.name = QString::fromLocal8Bit(result->pw_name);
+    entry.found = true;
+  }
+  else
+  {
+    entry.name = QStringLiteral("unknown");
+  }
+  return entry;
+}
+
+// Returns the lookup for uid, replacing it if it is the expired one.
+std::shared_ptr<UserNameLookup> findLookup(UserNameCache &cache, uid_t uid, const UserNameLookup *expired)
+{
+  {
+    QReadLocker locker(&cache.lock);
+    const auto it = cache.entries.constFind(uid);
+    if (it != cache.entries.constEnd() && it->get() != expired)
+      return *it;
+  }
+
+  QWriteLocker locker(&cache.lock);
+  std::shared_ptr<UserNameLookup> &lookup = cache.entries[uid];
+  if (!lookup || lookup.get() == expired)
+    lookup = std::make_shared<UserNameLookup>();
+  return lookup;
+}
+
+const UserNameEntry &resolvedEntry(UserNameLookup &lookup, uid_t uid, qint64 nowMs)
+{
+  // Resolved without holding the cache lock; NSS backends such as LDAP can take a network round trip.
+  std::call_once(lookup.resolved, [&lookup, uid, nowMs]()
+                 { lookup.entry = resolveUserName(uid, nowMs); });
+  return lookup.entry;
+}
+}
+
 QString getUserFromUid(uid_t uid)
 {
-  struct passwd *pw = getpwuid(uid);
-  return pw ? QString(pw->pw_name) : QString("unknown");
-}
\ No newline at end of file
+  UserNameCache &cache = userNameCache();
+  const qint64 nowMs = monotonicMs();
+  invalidateIfPasswdChanged(cache, nowMs);
+
+  std::shared_ptr<UserNameLookup> lookup = findLookup(cache, uid, nullptr);
+  const UserNameEntry &entry = resolvedEntry(*lookup, uid, nowMs);
+  if (entry.found || nowMs - entry.resolvedAtMs < negativeEntryTtlMs)
+    return entry.name;
+
+  lookup = findLookup(cache, uid, lookup.get());
+  return resolvedEntry(*lookup, uid, nowMs).name;
+}
@@ -0,0 +1,214 @@
+#include "hostprocessmodel.h"
+
+// Bit per column whose displayed value differs between the two versions of a process.
+static int changedColumns(const ProcessInfo &before, const ProcessInfo &after)
+{
+  int columns = 0;
+  if (before.name != after.name)
+    columns |= 1 << HostProcessModel::NameColumn;
+  if (before.user != after.user)
+    columns |= 1 << HostProcessModel::UserColumn;
+  if (qRound(before.cpuPercent * 10) != qRound(after.cpuPercent * 10))
+    columns |= 1 << HostProcessModel::CpuColumn;
+  if (qRound64(before.memoryKb) != qRound64(after.memoryKb))
+    columns |= 1 << HostProcessModel::MemoryColumn;
+  return columns;
+}
+
+static int lowestBit(int bits)
+{
+  int bit = 0;
+  while (!(bits & (1 << bit)))
+    ++bit;
+  return bit;
+}
+
+static int highestBit(int bits)
+{
+  int bit = HostProcessModel::ColumnCount - 1;
+  while (!(bits & (1 << bit)))
+    --bit;
+  return bit;
+}
+
+HostProcessModel::HostProcessModel(QObject *parent)
+    : QAbstractTableModel(parent), m_locale(QLocale::system())
+{
+}
+
+int HostProcessModel::rowCount(const QModelIndex &parent) const
+{
+  return parent.isValid() ? 0 : m_rows.size();
+}
+
+int HostProcessModel::columnCount(const QModelIndex &parent) const
+{
+  return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant HostProcessModel::data(const QModelIndex &index, int role) const
+{
+  if (!index.isValid() || index.row() >= m_rows.size())
+    return QVariant();
+
+  const HostProcess &row = m_rows[index.row()];
+  const ProcessInfo &process = row.process;
+  switch (role)
+  {
+  case Qt::DisplayRole:
+  case SortRole:
+    switch (index.column())
+    {
+    case HostColumn:
+      return m_hostNames.value(row.host);
+    case NameColumn:
+      return process.name;
+    case PidColumn:
+      return process.pid;
+    case UserColumn:
+      return process.user;
+    case CpuColumn:
+      if (role == SortRole)
+        return process.cpuPercent;
+      return QString::number(process.cpuPercent, 'f', 1);
+    case MemoryColumn:
+      if (role == SortRole)
+        return process.memoryKb;
+      return m_locale.toString(process.memoryKb, 'f', 0) + " K";
+    }
+    break;
+  case Qt::TextAlignmentRole:
+    if (index.column() == CpuColumn)
+      return int(Qt::AlignCenter);
+    if (index.column() == MemoryColumn)
+      return int(Qt::AlignRight | Qt::AlignVCenter);
+    break;
+  }
+
+  return QVariant();
+}
+
+QVariant HostProcessModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+  if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+    return QVariant();
+
+  switch (section)
+  {
+  case HostColumn:
+    return QStringLiteral("Host");
+  case NameColumn:
+    return QStringLiteral("Name");
+  case PidColumn:
+    return QStringLiteral("PID");
+  case UserColumn:
+    return QStringLiteral("User");
+  case CpuColumn:
+    return QStringLiteral("CPU");
+  case MemoryColumn:
+    return QStringLiteral("Working Set (Memory)");
+  }
+  return QVariant();
+}
+
+void HostProcessModel::setHostNames(const QStringList &hostNames)
+{
+  if (hostNames == m_hostNames)
+    return;
+  m_hostNames = hostNames;
+  if (!m_rows.isEmpty())
+    emit dataChanged(index(0, HostColumn), index(m_rows.size() - 1, HostColumn), {Qt::DisplayRole, SortRole});
+}
+
+void HostProcessModel::setProcesses(const QVector<HostProcess> &processes)
+{
+  // Where each current row is in the new list, or -1 if the process is gone.
+  m_sourceRowByRow.fill(-1, m_rows.size());
+  int matched = 0;
+  for (int source = 0; source < processes.size(); ++source)
+  {
+    const auto it = m_rowByKey.constFind(keyOf(processes[source]));
+    if (it != m_rowByKey.constEnd() && m_sourceRowByRow[it.value()] < 0)
+    {
+      m_sourceRowByRow[it.value()] = source;
+      ++matched;
+    }
+  }
+
+  // Remove runs of vanished rows from the bottom up so the row numbers above stay valid.
+  if (matched < m_rows.size())
+  {
+    int row = m_rows.size() - 1;
+    while (row >= 0)
+    {
+      if (m_sourceRowByRow[row] >= 0)
+      {
+        --row;
+        continue;
+      }
+
+      const int last = row;
+      while (row >= 0 && m_sourceRowByRow[row] < 0)
+        --row;
+      const int first = row + 1;
+
+      beginRemoveRows(QModelIndex(), first, last);
+      m_rows.remove(first, last - first + 1);
+      m_sourceRowByRow.remove(first, last - first + 1);
+      endRemoveRows();
+    }
+
+    m_rowByKey.clear();
+    for (int remaining = 0; remaining < m_rows.size(); ++remaining)
+      m_rowByKey.insert(keyOf(m_rows[remaining]), remaining);
+  }
+
+  // Update surviving rows and report each run of consecutive changed rows once.
+  int runFirst = -1;
+  int runColumns = 0;
+  for (int row = 0; row <= m_rows.size(); ++row)
+  {
+    int columns = 0;
+    if (row < m_rows.size())
+    {
+      const ProcessInfo &incoming = processes[m_sourceRowByRow[row]].process;
+      columns = changedColumns(m_rows[row].process, incoming);
+      if (columns)
+        m_rows[row].process = incoming;
+    }
+
+    if (columns)
+    {
+      if (runFirst < 0)
+        runFirst = row;
+      runColumns |= columns;
+    }
+    else if (runFirst >= 0)
+    {
+      emit dataChanged(index(runFirst, lowestBit(runColumns)), index(row - 1, highestBit(runColumns)),
+                       {Qt::DisplayRole, SortRole});
+      runFirst = -1;
+      runColumns = 0;
+    }
+  }
+
+  m_newSourceRows.clear();
+  for (int source = 0; source < processes.size(); ++source)
+  {
+    const Key key = keyOf(processes[source]);
+    if (!m_rowByKey.contains(key))
+    {
+      m_rowByKey.insert(key, m_rows.size() + m_newSourceRows.size());
+      m_newSourceRows.append(source);
+    }
+  }
+
+  if (!m_newSourceRows.isEmpty())
+  {
+    const int first = m_rows.size();
+    beginInsertRows(QModelIndex(), first, first + m_newSourceRows.size() - 1);
+    for (int source : std::as_const(m_newSourceRows))
+      m_rows.append(processes[source]);
+    endInsertRows();
+  }
+}
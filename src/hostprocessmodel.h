@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QLocale>
+#include <QStringList>
+#include <QVector>
+
+#include "systemsampler.h"
+
+struct HostProcess
+{
+  // Index into the model's host names.
+  int host = 0;
+  ProcessInfo process;
+};
+
+// Processes of several hosts in one table, keyed by (host, pid, starttime). setProcesses()
+// reports changes the way ProcessTableModel does: runs of removed rows, runs of changed rows and
+// one insertion for everything new, so selections and scroll positions survive an update.
+class HostProcessModel : public QAbstractTableModel
+{
+  Q_OBJECT
+
+public:
+  enum Column
+  {
+    HostColumn,
+    NameColumn,
+    PidColumn,
+    UserColumn,
+    CpuColumn,
+    MemoryColumn,
+    ColumnCount
+  };
+
+  static constexpr int SortRole = Qt::UserRole;
+
+  explicit HostProcessModel(QObject *parent = nullptr);
+
+  int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+  int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+  QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+  QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+  void setHostNames(const QStringList &hostNames);
+  void setProcesses(const QVector<HostProcess> &processes);
+
+private:
+  struct Key
+  {
+    int host = 0;
+    int pid = 0;
+    qint64 starttime = 0;
+
+    bool operator==(const Key &other) const { return host == other.host && pid == other.pid && starttime == other.starttime; }
+  };
+
+  friend size_t qHash(const Key &key, size_t seed)
+  {
+    return qHashMulti(seed, key.host, key.pid, key.starttime);
+  }
+
+  static Key keyOf(const HostProcess &row) { return {row.host, row.process.pid, row.process.starttime}; }
+
+  QStringList m_hostNames;
+  QVector<HostProcess> m_rows;
+  QHash<Key, int> m_rowByKey;
+  QVector<int> m_sourceRowByRow;
+  QVector<int> m_newSourceRows;
+  QLocale m_locale;
+};
@@ -0,0 +1,248 @@
+#include "hostsview.h"
+#include "agentconnection.h"
+#include "instrumentation.h"
+#include "trace.h"
+
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QLocale>
+#include <QPushButton>
+#include <QRegularExpression>
+#include <QSortFilterProxyModel>
+#include <QTreeView>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+static QString formatBytes(quint64 bytes)
+{
+  if (bytes >= 1024 * 1024)
+    return QString::number(bytes / (1024.0 * 1024.0), 'f', 1) + " MB";
+  return QString::number(bytes / 1024.0, 'f', 1) + " KB";
+}
+
+HostsView::HostsView(QWidget *parent)
+    : QWidget(parent)
+{
+  setupUI();
+
+  m_refreshTimer.setInterval(1000);
+  connect(&m_refreshTimer, &QTimer::timeout, this, &HostsView::refresh);
+  connect(m_connectButton, &QPushButton::clicked, this, &HostsView::onConnectClicked);
+  connect(m_addressEdit, &QLineEdit::returnPressed, this, &HostsView::onConnectClicked);
+  connect(m_removeButton, &QPushButton::clicked, this, &HostsView::onRemoveClicked);
+  connect(m_hostTable, &QTreeWidget::itemSelectionChanged, this, [this]()
+          { m_removeButton->setEnabled(!m_hostTable->selectedItems().isEmpty()); });
+}
+
+HostsView::~HostsView() = default;
+
+void HostsView::setupUI()
+{
+  QVBoxLayout *mainLayout = new QVBoxLayout(this);
+  mainLayout->setContentsMargins(12, 12, 10, 10);
+  mainLayout->setSpacing(5);
+
+  QHBoxLayout *addressLayout = new QHBoxLayout();
+  m_addressEdit = new QLineEdit(this);
+  m_addressEdit->setPlaceholderText("Agent socket path or host:port, several separated by spaces");
+  m_connectButton = new QPushButton("Connect", this);
+  addressLayout->addWidget(m_addressEdit);
+  addressLayout->addWidget(m_connectButton);
+  mainLayout->addLayout(addressLayout);
+
+  m_hostTable = new QTreeWidget(this);
+  m_hostTable->setColumnCount(6);
+  m_hostTable->setHeaderLabels({"Host", "Status", "CPU", "Memory", "Processes", "Received"});
+  m_hostTable->setRootIsDecorated(false);
+  m_hostTable->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+  m_hostTable->setStyleSheet("QTreeWidget { border: 1px solid gray; font-size: 11px; }");
+  mainLayout->addWidget(m_hostTable, 1);
+
+  m_summaryLabel = new QLabel(this);
+  mainLayout->addWidget(m_summaryLabel);
+
+  m_processModel = new HostProcessModel(this);
+  m_processProxyModel = new QSortFilterProxyModel(this);
+  m_processProxyModel->setSourceModel(m_processModel);
+  m_processProxyModel->setSortRole(HostProcessModel::SortRole);
+  m_processProxyModel->setDynamicSortFilter(false);
+
+  m_processView = new QTreeView(this);
+  m_processView->setModel(m_processProxyModel);
+  m_processView->setRootIsDecorated(false);
+  m_processView->setUniformRowHeights(true);
+  m_processView->setSortingEnabled(true);
+  m_processView->setStyleSheet("QTreeView { border: 1px solid gray; font-size: 11px; }");
+  mainLayout->addWidget(m_processView, 3);
+
+  QHBoxLayout *controlsLayout = new QHBoxLayout();
+  m_removeButton = new QPushButton("Remove Host", this);
+  m_removeButton->setEnabled(false);
+  controlsLayout->addStretch();
+  controlsLayout->addWidget(m_removeButton);
+  mainLayout->addLayout(controlsLayout);
+}
+
+void HostsView::addAgent(const QString &address)
+{
+  for (const AgentConnection *agent : std::as_const(m_agents))
+  {
+    if (agent->address() == address)
+      return;
+  }
+
+  AgentConnection *agent = new AgentConnection(address, this);
+  connect(agent, &AgentConnection::updated, this, [this]()
+          { m_dirty = true; });
+  connect(agent, &AgentConnection::stateChanged, this, [this]()
+          { m_dirty = true; });
+  m_agents.append(agent);
+
+  QTreeWidgetItem *item = new QTreeWidgetItem(m_hostTable);
+  item->setText(0, agent->address());
+  for (int column = 2; column < 6; ++column)
+    item->setTextAlignment(column, Qt::AlignRight);
+  m_dirty = true;
+  if (isVisible())
+    refresh();
+}
+
+void HostsView::setUpdateInterval(int milliseconds)
+{
+  // 0 pauses the view like the other tabs; the streams are still applied as they arrive.
+  m_paused = milliseconds <= 0;
+  if (m_paused)
+  {
+    m_refreshTimer.stop();
+    return;
+  }
+  m_refreshTimer.setInterval(milliseconds);
+  if (isVisible())
+    m_refreshTimer.start();
+}
+
+void HostsView::showEvent(QShowEvent *event)
+{
+  QWidget::showEvent(event);
+  refresh();
+  if (!m_paused)
+    m_refreshTimer.start();
+}
+
+void HostsView::hideEvent(QHideEvent *event)
+{
+  m_refreshTimer.stop();
+  QWidget::hideEvent(event);
+}
+
+void HostsView::onConnectClicked()
+{
+  static const QRegularExpression separators(QStringLiteral("[\\s,]+"));
+  for (const QString &address : m_addressEdit->text().split(separators, Qt::SkipEmptyParts))
+    addAgent(address);
+  m_addressEdit->clear();
+}
+
+void HostsView::onRemoveClicked()
+{
+  const int host = m_hostTable->indexOfTopLevelItem(m_hostTable->currentItem());
+  if (host < 0)
+    return;
+
+  delete m_hostTable->takeTopLevelItem(host);
+  delete m_agents.takeAt(host);
+  m_dirty = true;
+  refresh();
+}
+
+void HostsView::updateHostItem(int host)
+{
+  const AgentConnection *agent = m_agents[host];
+  QTreeWidgetItem *item = m_hostTable->topLevelItem(host);
+  const SampleStreamDecoder &stream = agent->stream();
+
+  switch (agent->state())
+  {
+  case AgentConnection::Connecting:
+    item->setText(1, "Connecting");
+    break;
+  case AgentConnection::Connected:
+    item->setText(1, stream.isSynchronized() ? "Connected" : "Waiting for baseline");
+    break;
+  case AgentConnection::Disconnected:
+    item->setText(1, agent->errorString());
+    break;
+  }
+
+  if (!stream.isSynchronized())
+  {
+    for (int column = 2; column < 5; ++column)
+      item->setText(column, QString());
+  }
+  else
+  {
+    const SystemUsage &usage = stream.usage();
+    const double memoryPercent = usage.totalRam > 0 ? (usage.ramUsage * 100.0) / usage.totalRam : 0.0;
+    item->setText(2, QString("%1%").arg(usage.cpuUsage));
+    item->setText(3, QString("%1%").arg(QString::number(memoryPercent, 'f', 1)));
+    item->setText(4, QString::number(usage.totalProcesses));
+  }
+  item->setText(5, formatBytes(agent->bytesReceived()));
+}
+
+void HostsView::refresh()
+{
+  if (!m_dirty)
+    return;
+  m_dirty = false;
+
+  Instrumentation::StageTimer stageTimer(Instrumentation::HostsViewUpdate);
+  QStringList hostNames;
+  int totalProcesses = 0;
+  for (const AgentConnection *agent : std::as_const(m_agents))
+  {
+    hostNames.append(agent->address());
+    totalProcesses += agent->stream().processes().size();
+  }
+
+  // Rebuilt from the streams' tables; the model only reports what changed since last time.
+  m_mergedProcesses.clear();
+  m_mergedProcesses.reserve(totalProcesses);
+  int cpuTotal = 0;
+  int synchronized = 0;
+  qint64 ramUsage = 0;
+  qint64 totalRam = 0;
+  for (int host = 0; host < m_agents.size(); ++host)
+  {
+    updateHostItem(host);
+    const SampleStreamDecoder &stream = m_agents[host]->stream();
+    if (!stream.isSynchronized())
+      continue;
+
+    ++synchronized;
+    cpuTotal += stream.usage().cpuUsage;
+    ramUsage += stream.usage().ramUsage;
+    totalRam += stream.usage().totalRam;
+    stream.processes().forEach([this, host](const ProcessKey &, const ProcessInfo &process)
+                               { m_mergedProcesses.append({host, process}); });
+  }
+
+  m_processModel->setHostNames(hostNames);
+  m_processModel->setProcesses(m_mergedProcesses);
+  if (m_processProxyModel->sortColumn() >= 0)
+    m_processProxyModel->sort(m_processProxyModel->sortColumn(), m_processProxyModel->sortOrder());
+
+  const QLocale locale;
+  m_summaryLabel->setText(QString("%1 of %2 hosts | Processes: %3 | Average CPU Usage: %4% | Memory: %5 of %6 MB")
+                              .arg(synchronized)
+                              .arg(m_agents.size())
+                              .arg(locale.toString(m_mergedProcesses.size()))
+                              .arg(synchronized > 0 ? cpuTotal / synchronized : 0)
+                              .arg(locale.toString(ramUsage / 1024))
+                              .arg(locale.toString(totalRam / 1024)));
+
+  WTM_TRACE("hosts", "view update: %d hosts, %lld rows in %lld us", int(m_agents.size()),
+            static_cast<long long>(m_mergedProcesses.size()), static_cast<long long>(stageTimer.elapsedNs() / 1000));
+}
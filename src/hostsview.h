@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QList>
+#include <QTimer>
+#include <QVector>
+#include <QWidget>
+
+#include "hostprocessmodel.h"
+
+class AgentConnection;
+class QLabel;
+class QLineEdit;
+class QPushButton;
+class QSortFilterProxyModel;
+class QTreeView;
+class QTreeWidget;
+
+// Usage of every connected wintaskman-agent, one row per host, above the processes of all of
+// them in one table. The agents' streams are applied as they arrive; the views are rebuilt from
+// them at most once per interval and only while the tab is visible.
+class HostsView : public QWidget
+{
+  Q_OBJECT
+
+public:
+  explicit HostsView(QWidget *parent = nullptr);
+  ~HostsView() override;
+
+  // Accepts the addresses AgentConnection does; does nothing for one that is already added.
+  void addAgent(const QString &address);
+  void setUpdateInterval(int milliseconds);
+
+protected:
+  void showEvent(QShowEvent *event) override;
+  void hideEvent(QHideEvent *event) override;
+
+private slots:
+  void onConnectClicked();
+  void onRemoveClicked();
+  void refresh();
+
+private:
+  void setupUI();
+  void updateHostItem(int host);
+
+  // Row i of the host table shows m_agents[i].
+  QList<AgentConnection *> m_agents;
+  QLineEdit *m_addressEdit = nullptr;
+  QPushButton *m_connectButton = nullptr;
+  QPushButton *m_removeButton = nullptr;
+  QTreeWidget *m_hostTable = nullptr;
+  QLabel *m_summaryLabel = nullptr;
+  QTreeView *m_processView = nullptr;
+  HostProcessModel *m_processModel = nullptr;
+  QSortFilterProxyModel *m_processProxyModel = nullptr;
+  QTimer m_refreshTimer;
+  QVector<HostProcess> m_mergedProcesses;
+  bool m_dirty = false;
+  bool m_paused = false;
+};
@@ -0,0 +1,253 @@
+#include "instrumentation.h"
+#include "procparser.h"
+
+#include <QList>
+#include <QMutex>
+#include <limits>
+#include <unistd.h>
+
+int LatencyHistogram::bucketIndex(quint64 value)
+{
+  if (value < subBucketCount)
+    return static_cast<int>(value);
+
+  // The highest set bit picks the group, the next subBucketBits bits the slot inside it.
+  const int highestBit = 63 - __builtin_clzll(value);
+  const int shift = highestBit - subBucketBits;
+  const int subBucket = static_cast<int>((value >> shift) & (subBucketCount - 1));
+  return (shift + 1) * subBucketCount + subBucket;
+}
+
+qint64 LatencyHistogram::bucketUpperBound(int index)
+{
+  const int group = index / subBucketCount;
+  const int subBucket = index % subBucketCount;
+  if (group == 0)
+    return subBucket;
+
+  const int shift = group - 1;
+  const quint64 upper = ((static_cast<quint64>(subBucketCount + subBucket) + 1) << shift) - 1;
+  return static_cast<qint64>(qMin<quint64>(upper, std::numeric_limits<qint64>::max()));
+}
+
+void LatencyHistogram::record(qint64 nanoseconds)
+{
+  const quint64 value = static_cast<quint64>(qMax<qint64>(0, nanoseconds));
+  m_buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  m_count.fetch_add(1, std::memory_order_relaxed);
+  m_totalNs.fetch_add(value, std::memory_order_relaxed);
+
+  qint64 currentMax = m_maxNs.load(std::memory_order_relaxed);
+  while (nanoseconds > currentMax && !m_maxNs.compare_exchange_weak(currentMax, nanoseconds, std::memory_order_relaxed))
+  {
+  }
+}
+
+void LatencyHistogram::reset()
+{
+  for (std::atomic<quint64> &bucket : m_buckets)
+    bucket.store(0, std::memory_order_relaxed);
+  m_count.store(0, std::memory_order_relaxed);
+  m_totalNs.store(0, std::memory_order_relaxed);
+  m_maxNs.store(0, std::memory_order_relaxed);
+}
+
+quint64 LatencyHistogram::count() const
+{
+  return m_count.load(std::memory_order_relaxed);
+}
+
+qint64 LatencyHistogram::max() const
+{
+  return m_maxNs.load(std::memory_order_relaxed);
+}
+
+qint64 LatencyHistogram::mean() const
+{
+  const quint64 recorded = count();
+  return recorded > 0 ? static_cast<qint64>(m_totalNs.load(std::memory_order_relaxed) / recorded) : 0;
+}
+
+qint64 LatencyHistogram::percentile(double fraction) const
+{
+  const quint64 recorded = count();
+  if (recorded == 0)
+    return 0;
+
+  const quint64 target = qMax<quint64>(1, static_cast<quint64>(qBound(0.0, fraction, 1.0) * recorded + 0.5));
+  quint64 seen = 0;
+  for (int index = 0; index < bucketCount; ++index)
+  {
+    seen += m_buckets[index].load(std::memory_order_relaxed);
+    if (seen >= target)
+      return qMin(bucketUpperBound(index), max());
+  }
+  return max();
+}
+
+namespace
+{
+using SyscallCounts = std::array<quint64, Instrumentation::SyscallCount>;
+
+struct ThreadCounters;
+
+struct CounterRegistry
+{
+  QMutex mutex;
+  QList<ThreadCounters *> threads;
+  // Counts of threads that have exited, and the totals at the last reset().
+  SyscallCounts retired{};
+  SyscallCounts baseline{};
+};
+
+CounterRegistry &counterRegistry()
+{
+  static CounterRegistry registry;
+  return registry;
+}
+
+// Only the owning thread writes its counters; readers sum them under the registry lock.
+struct ThreadCounters
+{
+  std::array<std::atomic<quint64>, Instrumentation::SyscallCount> counts{};
+
+  ThreadCounters()
+  {
+    CounterRegistry &registry = counterRegistry();
+    QMutexLocker locker(&registry.mutex);
+    registry.threads.append(this);
+  }
+
+  ~ThreadCounters()
+  {
+    CounterRegistry &registry = counterRegistry();
+    QMutexLocker locker(&registry.mutex);
+    for (int syscall = 0; syscall < Instrumentation::SyscallCount; ++syscall)
+      registry.retired[syscall] += counts[syscall].load(std::memory_order_relaxed);
+    registry.threads.removeOne(this);
+  }
+};
+
+thread_local ThreadCounters threadCounters;
+
+std::array<LatencyHistogram, Instrumentation::StageCount> stageHistograms;
+
+quint64 totalSyscalls(CounterRegistry &registry, int syscall)
+{
+  quint64 total = registry.retired[syscall];
+  for (const ThreadCounters *counters : std::as_const(registry.threads))
+    total += counters->counts[syscall].load(std::memory_order_relaxed);
+  return total;
+}
+}
+
+const char *Instrumentation::stageName(Stage stage)
+{
+  switch (stage)
+  {
+  case UsageCollector:
+    return "Usage collector";
+  case ProcessCollector:
+    return "Process collector";
+  case ServiceCollector:
+    return "Service collector";
+  case ApplicationCollector:
+    return "Application collector";
+  case StatusBarUpdate:
+    return "Status bar update";
+  case GraphUpdate:
+    return "Graph update";
+  case ApplicationsViewUpdate:
+    return "Applications view update";
+  case ProcessesViewUpdate:
+    return "Processes view update";
+  case ServicesViewUpdate:
+    return "Services view update";
+  case StreamDecode:
+    return "Agent stream decode";
+  case HostsViewUpdate:
+    return "Hosts view update";
+  case StageCount:
+    break;
+  }
+  return "";
+}
+
+const char *Instrumentation::syscallName(Syscall syscall)
+{
+  switch (syscall)
+  {
+  case Open:
+    return "open";
+  case Read:
+    return "read";
+  case Close:
+    return "close";
+  case DirectoryEntry:
+    return "directory entry";
+  case ReadLink:
+    return "readlink";
+  case Spawn:
+    return "process spawn";
+  case SyscallCount:
+    break;
+  }
+  return "";
+}
+
+LatencyHistogram &Instrumentation::histogram(Stage stage)
+{
+  return stageHistograms[stage];
+}
+
+void Instrumentation::countSyscall(Syscall syscall, int count)
+{
+  std::atomic<quint64> &counter = threadCounters.counts[syscall];
+  counter.store(counter.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+}
+
+quint64 Instrumentation::syscallCount(Syscall syscall)
+{
+  CounterRegistry &registry = counterRegistry();
+  QMutexLocker locker(&registry.mutex);
+  return totalSyscalls(registry, syscall) - registry.baseline[syscall];
+}
+
+void Instrumentation::reset()
+{
+  for (LatencyHistogram &histogram : stageHistograms)
+    histogram.reset();
+
+  CounterRegistry &registry = counterRegistry();
+  QMutexLocker locker(&registry.mutex);
+  for (int syscall = 0; syscall < SyscallCount; ++syscall)
+    registry.baseline[syscall] = totalSyscalls(registry, syscall);
+}
+
+Instrumentation::SelfUsage Instrumentation::sampleSelfUsage()
+{
+  static QMutex mutex;
+  static QByteArray buffer;
+  static QElapsedTimer wallClock;
+  static qint64 previousCpuTicks = -1;
+
+  QMutexLocker locker(&mutex);
+  SelfUsage usage;
+  ProcStatFields fields;
+  if (readProcFile("/proc/self/stat", buffer) < 0 || !parseProcStat(buffer.constData(), buffer.size(), fields))
+    return usage;
+
+  usage.rssKb = fields.rssPages * (sysconf(_SC_PAGESIZE) / 1024);
+
+  const qint64 cpuTicks = fields.utime + fields.stime;
+  const qint64 elapsedNs = wallClock.isValid() ? wallClock.nsecsElapsed() : 0;
+  if (previousCpuTicks >= 0 && elapsedNs > 0)
+  {
+    const double cpuSeconds = static_cast<double>(cpuTicks - previousCpuTicks) / sysconf(_SC_CLK_TCK);
+    usage.cpuPercent = cpuSeconds * 1e9 / elapsedNs * 100.0;
+  }
+
+  previousCpuTicks = cpuTicks;
+  wallClock.start();
+  return usage;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <array>
+#include <atomic>
+
+// Log-linear latency histogram in the style of HdrHistogram: values are grouped by their
+// power of two and each power of two is split into 16 linear sub-buckets, which bounds the
+// relative error of every reported percentile to about 6% over the whole nanosecond to
+// minutes range. Recording is a couple of relaxed atomic increments and safe from any thread.
+class LatencyHistogram
+{
+public:
+  void record(qint64 nanoseconds);
+  void reset();
+
+  quint64 count() const;
+  qint64 max() const;
+  qint64 mean() const;
+  // Upper bound of the bucket holding the given fraction (0..1) of the recorded values.
+  qint64 percentile(double fraction) const;
+
+private:
+  static constexpr int subBucketBits = 4;
+  static constexpr int subBucketCount = 1 << subBucketBits;
+  static constexpr int bucketCount = (64 - subBucketBits + 1) * subBucketCount;
+
+  static int bucketIndex(quint64 value);
+  static qint64 bucketUpperBound(int index);
+
+  std::array<std::atomic<quint64>, bucketCount> m_buckets{};
+  std::atomic<quint64> m_count{0};
+  std::atomic<quint64> m_totalNs{0};
+  std::atomic<qint64> m_maxNs{0};
+};
+
+// Self-overhead accounting: per-stage latency histograms and counters for the system calls the
+// collectors issue. Counters are kept per thread and summed when they are read, so the parallel
+// /proc scan workers do not contend on them.
+namespace Instrumentation
+{
+enum Stage
+{
+  UsageCollector,
+  ProcessCollector,
+  ServiceCollector,
+  ApplicationCollector,
+  StatusBarUpdate,
+  GraphUpdate,
+  ApplicationsViewUpdate,
+  ProcessesViewUpdate,
+  ServicesViewUpdate,
+  StreamDecode,
+  HostsViewUpdate,
+  StageCount
+};
+
+enum Syscall
+{
+  Open,
+  Read,
+  Close,
+  // Entries returned by readdir(), which libc fetches from the kernel in getdents64 batches.
+  DirectoryEntry,
+  ReadLink,
+  Spawn,
+  SyscallCount
+};
+
+const char *stageName(Stage stage);
+const char *syscallName(Syscall syscall);
+
+LatencyHistogram &histogram(Stage stage);
+void countSyscall(Syscall syscall, int count = 1);
+quint64 syscallCount(Syscall syscall);
+void reset();
+
+// CPU time and resident size of this process, read from /proc/self/stat.
+struct SelfUsage
+{
+  double cpuPercent = 0.0;
+  qint64 rssKb = 0;
+};
+
+// CPU% is measured over the time since the previous call.
+SelfUsage sampleSelfUsage();
+
+// Records the lifetime of the scope into the histogram of a stage.
+class StageTimer
+{
+public:
+  explicit StageTimer(Stage stage) : m_stage(stage) { m_timer.start(); }
+  ~StageTimer() { histogram(m_stage).record(m_timer.nsecsElapsed()); }
+
+  StageTimer(const StageTimer &) = delete;
+  StageTimer &operator=(const StageTimer &) = delete;
+
+  qint64 elapsedNs() const { return m_timer.nsecsElapsed(); }
+
+private:
+  Stage m_stage;
+  QElapsedTimer m_timer;
+};
+}
@@ -1,10 +1,25 @@
 #include <QApplication>
+#include <QCommandLineParser>
+#include "procfilecache.h"
 #include "taskmanager.h"
+#include "trace.h"
 
 int main(int argc, char *argv[])
 {
+    // Before any thread starts, so that the /proc file cache can keep a descriptor per process.
+    raiseOpenFileLimit();
     QApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption agentOption(QStringLiteral("agent"), QStringLiteral("Show a wintaskman-agent on the Hosts tab; can be repeated."), QStringLiteral("address"));
+    parser.addOption(agentOption);
+    parser.process(app);
+
     TaskManager taskManager;
+    for (const QString &address : parser.values(agentOption))
+        taskManager.connectToAgent(address);
     taskManager.show();
-    return app.exec();
+    const int exitCode = app.exec();
+    Trace::dumpToEnvironmentPath();
+    return exitCode;
 }
@@ -0,0 +1,319 @@
+#include "openrcclient.h"
+#include "trace.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+static const QString initDirectory = QStringLiteral("/etc/init.d");
+
+// State directories in the order rc-status reports them; a service in none of them is stopped.
+static const QStringList stateNames = {
+    QStringLiteral("started"),
+    QStringLiteral("starting"),
+    QStringLiteral("stopping"),
+    QStringLiteral("inactive"),
+    QStringLiteral("failed")};
+
+static QString findStateRoot()
+{
+  for (const QString &path : {QStringLiteral("/run/openrc"), QStringLiteral("/lib/rc/init.d")})
+  {
+    if (QFileInfo::exists(path + QStringLiteral("/started")))
+      return path;
+  }
+  return QString();
+}
+
+static QSet<QString> listDirectory(const QString &path)
+{
+  const QStringList names = QDir(path).entryList(QDir::NoDotAndDotDot | QDir::AllEntries | QDir::System);
+  return QSet<QString>(names.cbegin(), names.cend());
+}
+
+static QSet<QString> readDirectory(const QString &path)
+{
+  QSet<QString> entries = listDirectory(path);
+  // /etc/init.d also holds functions.sh and the like, which are not services.
+  entries.removeIf([](const QString &name)
+                   { return name.endsWith(QLatin1String(".sh")); });
+  return entries;
+}
+
+OpenRCClient::OpenRCClient(QObject *parent)
+    : QObject(parent), m_stateRoot(findStateRoot())
+{
+  if (m_stateRoot.isEmpty())
+    return;
+
+  connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &OpenRCClient::onDirectoryChanged);
+  connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &OpenRCClient::onFileChanged);
+
+  watchDirectory(initDirectory);
+  for (const QString &state : stateNames)
+    watchDirectory(m_stateRoot + '/' + state);
+
+  QSet<QString> names;
+  for (const QSet<QString> &entries : std::as_const(m_directoryEntries))
+    names.unite(entries);
+  for (const QString &name : std::as_const(names))
+    updateService(name);
+
+  QMutexLocker locker(&m_mutex);
+  markChanged();
+  WTM_TRACE("openrc", "%lld services from %s", static_cast<long long>(m_servicesByName.size()), qPrintable(m_stateRoot));
+}
+
+bool OpenRCClient::isAvailable() const
+{
+  return !m_stateRoot.isEmpty();
+}
+
+quint64 OpenRCClient::generation() const
+{
+  return m_generation.load();
+}
+
+QList<ServiceInfo> OpenRCClient::services() const
+{
+  QMutexLocker locker(&m_mutex);
+  if (m_servicesDirty)
+  {
+    m_services = m_servicesByName.values();
+    m_servicesDirty = false;
+  }
+  return m_services;
+}
+
+QString OpenRCClient::findPidFile(const QString &service)
+{
+  // start-stop-daemon leaves its arguments, including the pidfile, under daemons/<service>.
+  const QString stateRoot = findStateRoot();
+  if (!stateRoot.isEmpty())
+  {
+    const QDir daemonDirectory(stateRoot + QStringLiteral("/daemons/") + service);
+    for (const QString &entry : daemonDirectory.entryList(QDir::Files))
+    {
+      QFile file(daemonDirectory.filePath(entry));
+      if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        continue;
+      while (!file.atEnd())
+      {
+        const QByteArray line = file.readLine().trimmed();
+        if (line.startsWith("pidfile=") && line.size() > 8)
+          return QString::fromLocal8Bit(line.mid(8));
+      }
+    }
+  }
+
+  static const QStringList pidLocations = {
+      QStringLiteral("/run/%1.pid"),
+      QStringLiteral("/var/run/%1.pid"),
+      QStringLiteral("/run/%1/%1.pid"),
+      QStringLiteral("/var/run/%1/%1.pid")};
+
+  for (const QString &templatePath : pidLocations)
+  {
+    const QString path = templatePath.arg(service);
+    if (QFileInfo::exists(path))
+      return path;
+  }
+
+  return QString();
+}
+
+QString OpenRCClient::readPid(const QString &pidFile)
+{
+  QFile file(pidFile);
+  if (pidFile.isEmpty() || !file.open(QIODevice::ReadOnly | QIODevice::Text))
+    return QStringLiteral("-");
+
+  const int pid = QString::fromUtf8(file.readLine()).trimmed().toInt();
+  return pid > 0 ? QString::number(pid) : QStringLiteral("-");
+}
+
+void OpenRCClient::onDirectoryChanged(const QString &path)
+{
+  const auto pidFileDirectory = m_pidFileDirectories.find(path);
+  if (pidFileDirectory != m_pidFileDirectories.end())
+  {
+    const QSet<QString> entries = listDirectory(path);
+    QSet<QString> changed = entries - pidFileDirectory->entries;
+    changed.unite(pidFileDirectory->entries - entries);
+    pidFileDirectory->entries = entries;
+
+    QStringList pidFiles;
+    for (const QString &name : std::as_const(changed))
+    {
+      const QString pidFile = path + '/' + name;
+      if (m_serviceByPidFile.contains(pidFile))
+        pidFiles.append(pidFile);
+    }
+    // A pidfile removed and written again between two events leaves the entries as they were,
+    // but has lost its watch.
+    for (const QString &pidFile : std::as_const(m_unwatchedPidFiles))
+    {
+      const QFileInfo info(pidFile);
+      if (info.path() == path && entries.contains(info.fileName()) && !pidFiles.contains(pidFile))
+        pidFiles.append(pidFile);
+    }
+
+    WTM_TRACE("openrc", "%s changed, %lld pidfiles affected", qPrintable(path), static_cast<long long>(pidFiles.size()));
+    for (const QString &pidFile : std::as_const(pidFiles))
+    {
+      // The watcher drops the watch of a file that is removed.
+      if (entries.contains(QFileInfo(pidFile).fileName()))
+      {
+        if (m_unwatchedPidFiles.contains(pidFile))
+          addPidFileWatch(pidFile);
+      }
+      else
+      {
+        m_unwatchedPidFiles.insert(pidFile);
+      }
+      updateService(m_serviceByPidFile.value(pidFile));
+    }
+  }
+
+  if (!m_directoryEntries.contains(path))
+    return;
+
+  const QSet<QString> entries = readDirectory(path);
+  QSet<QString> &previous = m_directoryEntries[path];
+  QSet<QString> affected = entries - previous;
+  affected.unite(previous - entries);
+  previous = entries;
+
+  WTM_TRACE("openrc", "%s changed, %lld services affected", qPrintable(path), static_cast<long long>(affected.size()));
+  for (const QString &name : std::as_const(affected))
+    updateService(name);
+}
+
+void OpenRCClient::onFileChanged(const QString &path)
+{
+  const QString name = m_serviceByPidFile.value(path);
+  if (name.isEmpty())
+    return;
+
+  // Pidfiles are usually replaced rather than rewritten, which drops the watch on the old inode.
+  if (!m_watcher.files().contains(path))
+    addPidFileWatch(path);
+  updateService(name);
+}
+
+void OpenRCClient::watchDirectory(const QString &path)
+{
+  m_directoryEntries.insert(path, readDirectory(path));
+  if (QFileInfo(path).isDir())
+    m_watcher.addPath(path);
+}
+
+void OpenRCClient::watchPidFile(const QString &pidFile)
+{
+  addPidFileWatch(pidFile);
+
+  const QString directory = QFileInfo(pidFile).path();
+  PidFileDirectory &pidFileDirectory = m_pidFileDirectories[directory];
+  if (pidFileDirectory.pidFiles++ == 0)
+  {
+    pidFileDirectory.entries = listDirectory(directory);
+    if (!m_directoryEntries.contains(directory))
+      m_watcher.addPath(directory);
+  }
+}
+
+void OpenRCClient::addPidFileWatch(const QString &pidFile)
+{
+  // Adding a path that does not exist yet fails; the directory watch adds it once it appears.
+  if (QFileInfo::exists(pidFile) && m_watcher.addPath(pidFile))
+    m_unwatchedPidFiles.remove(pidFile);
+  else
+    m_unwatchedPidFiles.insert(pidFile);
+}
+
+void OpenRCClient::unwatchPidFile(const QString &pidFile)
+{
+  m_unwatchedPidFiles.remove(pidFile);
+  m_watcher.removePath(pidFile);
+
+  const QString directory = QFileInfo(pidFile).path();
+  const auto pidFileDirectory = m_pidFileDirectories.find(directory);
+  if (pidFileDirectory != m_pidFileDirectories.end() && --pidFileDirectory->pidFiles == 0)
+  {
+    m_pidFileDirectories.erase(pidFileDirectory);
+    if (!m_directoryEntries.contains(directory))
+      m_watcher.removePath(directory);
+  }
+}
+
+void OpenRCClient::updateService(const QString &name)
+{
+  const bool known = isKnown(name);
+  const QString state = known ? stateOf(name) : QString();
+  const QString pidFile = state == QLatin1String("started") ? findPidFile(name) : QString();
+
+  const QString previousPidFile = m_pidFileByService.value(name);
+  if (pidFile != previousPidFile)
+  {
+    if (!previousPidFile.isEmpty())
+    {
+      unwatchPidFile(previousPidFile);
+      m_serviceByPidFile.remove(previousPidFile);
+      m_pidFileByService.remove(name);
+    }
+    if (!pidFile.isEmpty())
+    {
+      watchPidFile(pidFile);
+      m_serviceByPidFile.insert(pidFile, name);
+      m_pidFileByService.insert(name, pidFile);
+    }
+  }
+
+  const QString pid = readPid(pidFile);
+  QMutexLocker locker(&m_mutex);
+  if (!known)
+  {
+    if (m_servicesByName.remove(name) > 0)
+      markChanged();
+    return;
+  }
+
+  const auto it = m_servicesByName.find(name);
+  if (it != m_servicesByName.end() && it->state == state && it->pid == pid)
+    return;
+
+  ServiceInfo service;
+  service.name = name;
+  service.pid = pid;
+  service.state = state;
+  service.scope = QStringLiteral("system");
+  m_servicesByName.insert(name, service);
+  markChanged();
+}
+
+QString OpenRCClient::stateOf(const QString &name) const
+{
+  for (const QString &state : stateNames)
+  {
+    if (m_directoryEntries.value(m_stateRoot + '/' + state).contains(name))
+      return state;
+  }
+  return QStringLiteral("stopped");
+}
+
+bool OpenRCClient::isKnown(const QString &name) const
+{
+  for (const QSet<QString> &entries : m_directoryEntries)
+  {
+    if (entries.contains(name))
+      return true;
+  }
+  return false;
+}
+
+void OpenRCClient::markChanged()
+{
+  m_servicesDirty = true;
+  ++m_generation;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <atomic>
+
+#include "systemdataprovider.h"
+
+// Keeps the OpenRC service list from the state directories under /run/openrc instead of running
+// rc-status. Those directories, /etc/init.d and the pidfiles of started services are watched, and
+// a change only re-reads the services it touches, so a refresh with no changes does no I/O. The
+// directories holding the pidfiles are watched as well, since a pidfile that is replaced or only
+// written after the service entered started cannot be watched until it exists.
+class OpenRCClient : public QObject
+{
+  Q_OBJECT
+
+public:
+  // Has to be created on a thread that runs an event loop; the watcher reports there.
+  explicit OpenRCClient(QObject *parent = nullptr);
+
+  bool isAvailable() const;
+  // Bumped on every change to the service list.
+  quint64 generation() const;
+  // Thread-safe; sorted by service name.
+  QList<ServiceInfo> services() const;
+
+  // Pidfile of a started service: the one start-stop-daemon recorded, or the first of the
+  // conventional locations that exists. Empty if there is none.
+  static QString findPidFile(const QString &service);
+  // Pid stored in a pidfile as shown in the services tab, "-" if there is none.
+  static QString readPid(const QString &pidFile);
+
+private slots:
+  void onDirectoryChanged(const QString &path);
+  void onFileChanged(const QString &path);
+
+private:
+  struct PidFileDirectory
+  {
+    // Number of watched pidfiles in the directory.
+    int pidFiles = 0;
+    QSet<QString> entries;
+  };
+
+  void watchDirectory(const QString &path);
+  void watchPidFile(const QString &pidFile);
+  void addPidFileWatch(const QString &pidFile);
+  void unwatchPidFile(const QString &pidFile);
+  void updateService(const QString &name);
+  QString stateOf(const QString &name) const;
+  bool isKnown(const QString &name) const;
+  void markChanged();
+
+  QString m_stateRoot;
+  QFileSystemWatcher m_watcher;
+  // Entries of every watched directory, so a change can be narrowed down to the services it adds
+  // or removes.
+  QHash<QString, QSet<QString>> m_directoryEntries;
+  QHash<QString, QString> m_pidFileByService;
+  QHash<QString, QString> m_serviceByPidFile;
+  // Directories watched for pidfiles, such as /run; a change only touches the services whose
+  // pidfile appeared or disappeared.
+  QHash<QString, PidFileDirectory> m_pidFileDirectories;
+  // Pidfiles that have no watch because they did not exist when it was last added.
+  QSet<QString> m_unwatchedPidFiles;
+  // Only touched on the thread the client lives on; m_mutex guards it against services().
+  QMap<QString, ServiceInfo> m_servicesByName;
+  mutable QMutex m_mutex;
+  mutable QList<ServiceInfo> m_services;
+  mutable bool m_servicesDirty = true;
+  std::atomic<quint64> m_generation{0};
+};
@@ -0,0 +1,155 @@
+#include "performancegraph.h"
+#include "samplehistory.h"
+
+#include <QPaintEvent>
+#include <QPainter>
+#include <QResizeEvent>
+#include <cmath>
+
+static constexpr int gridSpacing = 12;
+static constexpr int horizontalGridLines = 10;
+
+PerformanceGraph::PerformanceGraph(QWidget *parent)
+    : QWidget(parent)
+{
+  setAttribute(Qt::WA_OpaquePaintEvent);
+  setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+}
+
+void PerformanceGraph::setHistory(const SampleHistory *history)
+{
+  m_history = history;
+  m_paintedAppendCount = 0;
+  update();
+}
+
+void PerformanceGraph::setLineColor(const QColor &color)
+{
+  m_lineColor = color;
+  update();
+}
+
+void PerformanceGraph::setLineWidth(int width)
+{
+  m_lineWidth = width;
+  update();
+}
+
+void PerformanceGraph::setGridColor(const QColor &color)
+{
+  m_gridColor = color;
+  update();
+}
+
+void PerformanceGraph::setScrollingEnabled(bool enabled)
+{
+  m_scrolling = enabled;
+  update();
+}
+
+void PerformanceGraph::sampleAppended()
+{
+  if (!m_history)
+    return;
+
+  const quint64 appendCount = m_history->appendCount();
+  const quint64 newSamples = appendCount - m_paintedAppendCount;
+  const bool canScroll = m_scrolling && m_paintedAppendCount > 0 && isVisible();
+  m_paintedAppendCount = appendCount;
+
+  // Graphs that are not on screen (minimized, other tab, collapsed core grid) cost nothing
+  // here; they get a full paint when they are exposed again.
+  if (!isVisible())
+    return;
+
+  const int dx = static_cast<int>(newSamples * sampleStep());
+  if (!canScroll || dx <= 0 || dx >= width())
+  {
+    update();
+    return;
+  }
+
+  // Move what is already painted and only repaint the strip on the right, plus the area left of
+  // the oldest retained sample so that samples which fell out of the history disappear.
+  scroll(-dx, 0);
+  const int oldestX = static_cast<int>(std::floor(sampleX(0)));
+  if (oldestX > 0)
+    update(0, 0, oldestX + 1, height());
+}
+
+QSize PerformanceGraph::sizeHint() const
+{
+  return QSize(240, 120);
+}
+
+QSize PerformanceGraph::minimumSizeHint() const
+{
+  return QSize(60, 40);
+}
+
+qreal PerformanceGraph::sampleStep() const
+{
+  const int capacity = m_history ? m_history->capacity() : 1;
+  const qreal step = static_cast<qreal>(width() - 1) / qMax(1, capacity - 1);
+  // Scrolling moves whole pixels, so each sample has to cover a whole number of them.
+  return m_scrolling ? qMax<qreal>(1.0, std::round(step)) : step;
+}
+
+qreal PerformanceGraph::sampleX(int index) const
+{
+  const int age = m_history->size() - 1 - index;
+  return (width() - 1) - age * sampleStep();
+}
+
+qreal PerformanceGraph::valueY(double value) const
+{
+  const qreal bounded = qBound(0.0, value, 100.0);
+  return (height() - 1) * (1.0 - bounded / 100.0);
+}
+
+void PerformanceGraph::paintEvent(QPaintEvent *event)
+{
+  QPainter painter(this);
+  const QRect dirty = event->rect();
+  painter.fillRect(dirty, Qt::black);
+
+  const int right = width() - 1;
+  painter.setPen(m_gridColor);
+  for (int line = 1; line < horizontalGridLines; ++line)
+  {
+    const int y = (height() - 1) * line / horizontalGridLines;
+    if (y >= dirty.top() && y <= dirty.bottom())
+      painter.drawLine(dirty.left(), y, dirty.right(), y);
+  }
+
+  // Vertical grid lines are anchored to the samples, so the grid scrolls along with the data.
+  const qreal scrolledPixels = m_history ? m_history->appendCount() * sampleStep() : 0.0;
+  for (qreal x = right - std::fmod(scrolledPixels, gridSpacing); x >= dirty.left(); x -= gridSpacing)
+  {
+    if (x <= dirty.right())
+      painter.drawLine(QPointF(x, 0), QPointF(x, height() - 1));
+  }
+
+  if (!m_history || m_history->size() < 2)
+    return;
+
+  // Only the samples that reach into the dirty rectangle are turned into points.
+  const int size = m_history->size();
+  const qreal step = sampleStep();
+  const int visibleSamples = static_cast<int>(std::ceil((right - dirty.left()) / step)) + 2;
+  const int first = qMax(0, size - visibleSamples);
+
+  m_polyline.resize(size - first);
+  for (int index = first; index < size; ++index)
+    m_polyline[index - first] = QPointF(sampleX(index), valueY(m_history->value(index)));
+
+  painter.setRenderHint(QPainter::Antialiasing, !m_scrolling);
+  painter.setPen(QPen(m_lineColor, m_lineWidth));
+  painter.drawPolyline(m_polyline);
+}
+
+void PerformanceGraph::resizeEvent(QResizeEvent *event)
+{
+  QWidget::resizeEvent(event);
+  update();
+}
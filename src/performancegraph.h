@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QColor>
+#include <QPolygonF>
+#include <QWidget>
+
+class SampleHistory;
+
+// Classic green-on-black usage graph drawn straight from a SampleHistory with QPainter.
+// In scrolling mode every new sample moves the already painted pixels with QWidget::scroll()
+// and only the newly exposed strip on the right is repainted.
+class PerformanceGraph : public QWidget
+{
+  Q_OBJECT
+
+public:
+  explicit PerformanceGraph(QWidget *parent = nullptr);
+
+  // The history is not owned and has to outlive the graph.
+  void setHistory(const SampleHistory *history);
+  void setLineColor(const QColor &color);
+  void setLineWidth(int width);
+  void setGridColor(const QColor &color);
+  void setScrollingEnabled(bool enabled);
+
+  // Call after appending to the history.
+  void sampleAppended();
+
+  QSize sizeHint() const override;
+  QSize minimumSizeHint() const override;
+
+protected:
+  void paintEvent(QPaintEvent *event) override;
+  void resizeEvent(QResizeEvent *event) override;
+
+private:
+  qreal sampleStep() const;
+  qreal sampleX(int index) const;
+  qreal valueY(double value) const;
+
+  const SampleHistory *m_history = nullptr;
+  QColor m_lineColor = Qt::green;
+  int m_lineWidth = 1;
+  QColor m_gridColor = Qt::darkGreen;
+  bool m_scrolling = false;
+  quint64 m_paintedAppendCount = 0;
+  QPolygonF m_polyline;
+};
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <QHashFunctions>
+#include <QVector>
+#include <QtGlobal>
+#include <utility>
+
+// A PID is only unique together with its start time; keying on both keeps state from
+// leaking into an unrelated process that reuses the PID.
+struct ProcessKey
+{
+  int pid = 0;
+  qint64 starttime = 0;
+
+  bool operator==(const ProcessKey &other) const { return pid == other.pid && starttime == other.starttime; }
+  bool operator!=(const ProcessKey &other) const { return !(*this == other); }
+};
+
+inline size_t qHash(const ProcessKey &key, size_t seed = 0)
+{
+  return qHashMulti(seed, key.pid, key.starttime);
+}
+
+// Open addressing hash table (linear probing, backward shift deletion) for per-process state.
+// Every scan marks the processes it saw and sweep() drops the rest, so the table tracks the
+// live process set instead of growing with every PID ever observed. Lookups through the const
+// interface may run concurrently as long as nothing is marked or swept at the same time.
+template <typename Value>
+class ProcessTable
+{
+public:
+  explicit ProcessTable(int initialCapacity = minimumCapacity)
+  {
+    rehash(capacityFor(initialCapacity));
+  }
+
+  int size() const { return m_size; }
+  int capacity() const { return m_slots.size(); }
+
+  const Value *find(const ProcessKey &key) const
+  {
+    const int mask = m_slots.size() - 1;
+    for (int index = homeSlot(key); m_slots[index].occupied; index = (index + 1) & mask)
+    {
+      if (m_slots[index].key == key)
+        return &m_slots[index].value;
+    }
+    return nullptr;
+  }
+
+  void beginScan() { ++m_generation; }
+
+  // Returns the value stored for key, inserting a default constructed one if there is none,
+  // and marks the process as seen in the current scan.
+  Value &mark(const ProcessKey &key)
+  {
+    if ((m_size + 1) * 10 > m_slots.size() * 7)
+      rehash(m_slots.size() * 2);
+
+    const int mask = m_slots.size() - 1;
+    int index = homeSlot(key);
+    while (m_slots[index].occupied && m_slots[index].key != key)
+      index = (index + 1) & mask;
+
+    Slot &slot = m_slots[index];
+    if (!slot.occupied)
+    {
+      slot.occupied = true;
+      slot.key = key;
+      slot.value = Value();
+      ++m_size;
+    }
+    slot.generation = m_generation;
+    return slot.value;
+  }
+
+  // Removes the entry of key; returns false if there was none.
+  bool remove(const ProcessKey &key)
+  {
+    const int mask = m_slots.size() - 1;
+    for (int index = homeSlot(key); m_slots[index].occupied; index = (index + 1) & mask)
+    {
+      if (m_slots[index].key == key)
+      {
+        erase(index);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Calls visit(key, value) for every entry, in no particular order.
+  template <typename Visitor>
+  void forEach(Visitor visit) const
+  {
+    for (const Slot &slot : m_slots)
+    {
+      if (slot.occupied)
+        visit(slot.key, slot.value);
+    }
+  }
+
+  // Removes every entry that was not marked since beginScan() and returns how many were dropped.
+  int sweep()
+  {
+    return sweep([](const ProcessKey &, const Value &) {});
+  }
+
+  // Like sweep(), but calls onRemoved(key, value) for every entry before it is dropped.
+  template <typename Callback>
+  int sweep(Callback onRemoved)
+  {
+    int removed = 0;
+    for (int index = 0; index < m_slots.size();)
+    {
+      if (m_slots[index].occupied && m_slots[index].generation != m_generation)
+      {
+        onRemoved(m_slots[index].key, m_slots[index].value);
+        erase(index);
+        ++removed;
+        // erase() may have shifted a later entry into this slot, so look at it again.
+        continue;
+      }
+      ++index;
+    }
+
+    if (m_slots.size() > minimumCapacity && m_size * 8 < m_slots.size())
+      rehash(capacityFor(m_size * 2));
+    return removed;
+  }
+
+  void clear()
+  {
+    m_slots = QVector<Slot>(minimumCapacity);
+    m_size = 0;
+  }
+
+private:
+  static constexpr int minimumCapacity = 64;
+
+  struct Slot
+  {
+    ProcessKey key;
+    quint32 generation = 0;
+    bool occupied = false;
+    Value value = Value();
+  };
+
+  static int capacityFor(int count)
+  {
+    int capacity = minimumCapacity;
+    while (capacity < count)
+      capacity *= 2;
+    return capacity;
+  }
+
+  int homeSlot(const ProcessKey &key) const
+  {
+    quint64 hash = static_cast<quint64>(static_cast<quint32>(key.pid)) ^ (static_cast<quint64>(key.starttime) << 21);
+    hash *= Q_UINT64_C(0x9E3779B97F4A7C15);
+    return static_cast<int>(hash >> 32) & (m_slots.size() - 1);
+  }
+
+  void erase(int hole)
+  {
+    const int mask = m_slots.size() - 1;
+    int next = hole;
+    for (;;)
+    {
+      next = (next + 1) & mask;
+      if (!m_slots[next].occupied)
+        break;
+
+      // Leave the entry where it is if its home slot lies cyclically in (hole, next].
+      const int home = homeSlot(m_slots[next].key);
+      const bool reachable = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next);
+      if (reachable)
+        continue;
+
+      m_slots[hole] = std::move(m_slots[next]);
+      hole = next;
+    }
+
+    m_slots[hole].occupied = false;
+    m_slots[hole].value = Value();
+    --m_size;
+  }
+
+  void rehash(int capacity)
+  {
+    QVector<Slot> previous(capacity);
+    previous.swap(m_slots);
+    m_size = 0;
+
+    const int mask = capacity - 1;
+    for (Slot &slot : previous)
+    {
+      if (!slot.occupied)
+        continue;
+
+      int index = homeSlot(slot.key);
+      while (m_slots[index].occupied)
+        index = (index + 1) & mask;
+      m_slots[index] = std::move(slot);
+      ++m_size;
+    }
+  }
+
+  QVector<Slot> m_slots;
+  int m_size = 0;
+  quint32 m_generation = 0;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QLocale>
+#include <QVector>
+
+#include "processtable.h"
+#include "systemdataprovider.h"
+
+// Table of processes keyed by (pid, starttime), so a reused PID shows up as a new row rather
+// than as the old process with a new name. setProcesses() diffs the new list against the current rows and
+// only reports what changed: one removal per run of vanished rows, one insertion for all new
+// processes and one dataChanged per run of consecutive changed rows. Sorting is left to a proxy.
+class ProcessTableModel : public QAbstractTableModel
+{
+  Q_OBJECT
+
+public:
+  enum Column
+  {
+    NameColumn,
+    PidColumn,
+    UserColumn,
+    CpuColumn,
+    MemoryColumn,
+    ColumnCount
+  };
+
+  // Raw value of a cell, used as the sort role so that numbers sort as numbers.
+  static constexpr int SortRole = Qt::UserRole;
+
+  explicit ProcessTableModel(QObject *parent = nullptr);
+
+  int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+  int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+  QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+  QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+  void setProcesses(const QList<ProcessInfo> &processes);
+  int pidAt(int row) const;
+
+private:
+  static ProcessKey keyOf(const ProcessInfo &process) { return {process.pid, process.starttime}; }
+
+  QVector<ProcessInfo> m_rows;
+  QHash<ProcessKey, int> m_rowByKey;
+  QVector<int> m_sourceRowByRow;
+  QVector<int> m_newSourceRows;
+  QLocale m_locale;
+};
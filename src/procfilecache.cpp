@@ -0,0 +1,230 @@
+#include "procfilecache.h"
+#include "instrumentation.h"
+
+#include <QMutexLocker>
+#include <climits>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <utility>
+
+// The soft limit raiseOpenFileLimit() found; RLIM_INFINITY until it raised anything.
+static rlim_t originalSoftLimit = RLIM_INFINITY;
+
+void raiseOpenFileLimit()
+{
+  constexpr rlim_t maxSoftLimit = 1 << 20;
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+    return;
+
+  const rlim_t target = qMin(limit.rlim_max, maxSoftLimit);
+  if (limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur >= target)
+    return;
+  const rlim_t original = limit.rlim_cur;
+  limit.rlim_cur = target;
+  if (setrlimit(RLIMIT_NOFILE, &limit) == 0)
+    originalSoftLimit = original;
+}
+
+void restoreOpenFileLimit()
+{
+  if (originalSoftLimit == RLIM_INFINITY)
+    return;
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+    return;
+  limit.rlim_cur = originalSoftLimit;
+  setrlimit(RLIMIT_NOFILE, &limit);
+}
+
+// At least half of the soft limit is left to the rest of the application.
+static int defaultMaxOpenFiles()
+{
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+    return 512;
+  return static_cast<int>(qBound<rlim_t>(64, limit.rlim_cur / 2, 256 * 1024));
+}
+
+// Reads from offset 0 until a read comes back short. procfs generates these files in one go, so
+// a buffer larger than the file is filled by a single pread().
+static qsizetype preadWhole(int fd, QByteArray &buffer)
+{
+  qsizetype total = 0;
+  for (;;)
+  {
+    const qsizetype requested = buffer.size() - total;
+    const ssize_t bytesRead = ::pread(fd, buffer.data() + total, requested, total);
+    Instrumentation::countSyscall(Instrumentation::Read);
+    if (bytesRead < 0)
+      return -1;
+
+    total += bytesRead;
+    if (bytesRead < requested)
+      break;
+    buffer.resize(buffer.size() * 2);
+  }
+  return total;
+}
+
+ProcFileCache::ProcFileCache(const QByteArray &procRoot, int maxOpenFiles)
+    : m_procRoot(procRoot), m_maxOpenFiles(maxOpenFiles > 0 ? maxOpenFiles : defaultMaxOpenFiles())
+{
+}
+
+ProcFileCache::~ProcFileCache()
+{
+  for (Shard &shard : m_shards)
+  {
+    for (const Entry &entry : std::as_const(shard.entries))
+      ::close(entry.fd);
+  }
+}
+
+void ProcFileCache::beginScan(int processCount)
+{
+  ++m_generation;
+  // Descriptors that are not read again during an uncached scan are closed by endScan().
+  m_caching = processCount <= m_maxOpenFiles;
+}
+
+void ProcFileCache::endScan()
+{
+  const quint64 generation = m_generation;
+  for (Shard &shard : m_shards)
+  {
+    QMutexLocker locker(&shard.mutex);
+    for (auto it = shard.entries.begin(); it != shard.entries.end();)
+    {
+      if (it->generation != generation)
+      {
+        ::close(it->fd);
+        Instrumentation::countSyscall(Instrumentation::Close);
+        it = shard.entries.erase(it);
+        --m_openFiles;
+      }
+      else
+      {
+        ++it;
+      }
+    }
+  }
+}
+
+qsizetype ProcFileCache::readStat(int pid, QByteArray &buffer)
+{
+  buffer.resize(qMax<qsizetype>(buffer.capacity(), 1024));
+  if (!m_caching)
+    return readUncached(pid, buffer);
+
+  // The shard stays locked while reading so that no other worker can close the descriptor under us.
+  Shard &shard = shardFor(pid);
+  QMutexLocker locker(&shard.mutex);
+
+  auto it = shard.entries.find(pid);
+  if (it != shard.entries.end())
+  {
+    if (buffer.size() <= it->length)
+      buffer.resize(it->length * 2);
+    const qsizetype length = preadWhole(it->fd, buffer);
+    if (length > 0)
+    {
+      ++m_hits;
+      it->generation = m_generation;
+      it->length = length;
+      buffer.resize(length);
+      return length;
+    }
+
+    // The process behind the descriptor is gone (ESRCH); the PID may have been reused.
+    evict(shard, it);
+  }
+
+  // Processes that appeared since beginScan() can still push the count past the cap; those are
+  // read without keeping their descriptor.
+  if (m_openFiles >= m_maxOpenFiles)
+    return readUncached(pid, buffer);
+
+  ++m_misses;
+  const int fd = openStat(pid);
+  if (fd < 0)
+  {
+    buffer.resize(0);
+    return -1;
+  }
+
+  const qsizetype length = preadWhole(fd, buffer);
+  if (length <= 0)
+  {
+    ::close(fd);
+    Instrumentation::countSyscall(Instrumentation::Close);
+    buffer.resize(0);
+    return -1;
+  }
+
+  Entry entry;
+  entry.fd = fd;
+  entry.generation = m_generation;
+  entry.length = length;
+  shard.entries.insert(pid, entry);
+  ++m_openFiles;
+
+  buffer.resize(length);
+  return length;
+}
+
+void ProcFileCache::checkStartTime(int pid, qint64 starttime)
+{
+  Shard &shard = shardFor(pid);
+  QMutexLocker locker(&shard.mutex);
+
+  auto it = shard.entries.find(pid);
+  if (it == shard.entries.end())
+    return;
+
+  if (it->starttime >= 0 && it->starttime != starttime)
+    evict(shard, it);
+  else
+    it->starttime = starttime;
+}
+
+ProcFileCacheStats ProcFileCache::stats() const
+{
+  ProcFileCacheStats stats;
+  stats.hits = m_hits;
+  stats.misses = m_misses;
+  stats.openFiles = m_openFiles;
+  return stats;
+}
+
+qsizetype ProcFileCache::readUncached(int pid, QByteArray &buffer)
+{
+  ++m_misses;
+  const int fd = openStat(pid);
+  const qsizetype length = fd >= 0 ? preadWhole(fd, buffer) : -1;
+  if (fd >= 0)
+  {
+    ::close(fd);
+    Instrumentation::countSyscall(Instrumentation::Close);
+  }
+  buffer.resize(qMax<qsizetype>(0, length));
+  return length > 0 ? length : -1;
+}
+
+int ProcFileCache::openStat(int pid)
+{
+  char path[PATH_MAX];
+  std::snprintf(path, sizeof(path), "%s/%d/stat", m_procRoot.constData(), pid);
+  Instrumentation::countSyscall(Instrumentation::Open);
+  return ::open(path, O_RDONLY | O_CLOEXEC);
+}
+
+void ProcFileCache::evict(Shard &shard, QHash<int, Entry>::iterator it)
+{
+  ::close(it->fd);
+  Instrumentation::countSyscall(Instrumentation::Close);
+  shard.entries.erase(it);
+  --m_openFiles;
+}
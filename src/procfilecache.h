@@ -0,0 +1,84 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <array>
+#include <atomic>
+
+struct ProcFileCacheStats
+{
+  quint64 hits = 0;
+  quint64 misses = 0;
+  int openFiles = 0;
+
+  double hitRate() const { return hits + misses > 0 ? static_cast<double>(hits) / (hits + misses) : 0.0; }
+};
+
+// Distributions commonly keep the soft descriptor limit at 1024 and the hard one far higher, which
+// leaves room for only a few hundred cached files. main() raises the soft limit toward the hard
+// one before anything else runs; the cache sizes itself from whatever the soft limit is.
+void raiseOpenFileLimit();
+// Puts back the soft limit from before raiseOpenFileLimit(), so that programs started from the
+// application do not inherit it. Async-signal-safe, for QProcess::setChildProcessModifier().
+void restoreOpenFileLimit();
+
+// Keeps /proc/<pid>/stat open between refreshes and re-reads it with pread() at offset 0,
+// so that a steady state scan costs one syscall per process instead of open/read/close.
+// The number of open descriptors is capped. A scan of more processes than the cap reads every
+// file with open/read/close instead, since a full cyclic scan would evict each descriptor before
+// it is read again. Entries are sharded by PID so that parallel scan workers rarely contend on
+// the same lock.
+class ProcFileCache
+{
+public:
+  explicit ProcFileCache(const QByteArray &procRoot = QByteArrayLiteral("/proc"), int maxOpenFiles = 0);
+  ~ProcFileCache();
+
+  ProcFileCache(const ProcFileCache &) = delete;
+  ProcFileCache &operator=(const ProcFileCache &) = delete;
+
+  // processCount is the number of PIDs the scan is about to read.
+  void beginScan(int processCount);
+  // Closes the descriptors of every PID that was not read since beginScan().
+  void endScan();
+
+  qsizetype readStat(int pid, QByteArray &buffer);
+  // Drops the cached descriptor when the PID now belongs to a different process.
+  void checkStartTime(int pid, qint64 starttime);
+
+  ProcFileCacheStats stats() const;
+  int maxOpenFiles() const { return m_maxOpenFiles; }
+
+private:
+  static constexpr int shardCount = 64;
+
+  struct Entry
+  {
+    int fd = -1;
+    qint64 starttime = -1;
+    quint64 generation = 0;
+    // Size of the file on the last read, so the next one can be done with a single pread().
+    qsizetype length = 0;
+  };
+
+  struct Shard
+  {
+    QMutex mutex;
+    QHash<int, Entry> entries;
+  };
+
+  Shard &shardFor(int pid) { return m_shards[static_cast<unsigned>(pid) % shardCount]; }
+  int openStat(int pid);
+  qsizetype readUncached(int pid, QByteArray &buffer);
+  void evict(Shard &shard, QHash<int, Entry>::iterator it);
+
+  QByteArray m_procRoot;
+  int m_maxOpenFiles = 0;
+  std::atomic<quint64> m_generation{0};
+  std::atomic<bool> m_caching{true};
+  std::array<Shard, shardCount> m_shards;
+  std::atomic<quint64> m_hits{0};
+  std::atomic<quint64> m_misses{0};
+  std::atomic<int> m_openFiles{0};
+};
@@ -0,0 +1,371 @@
+#include "procparser.h"
+#include "instrumentation.h"
+
+#include <cstring>
+#include <initializer_list>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static bool isSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static const char *skipSpaces(const char *cursor, const char *end)
+{
+  while (cursor < end && isSpace(*cursor))
+    ++cursor;
+  return cursor;
+}
+
+static const char *skipToken(const char *cursor, const char *end)
+{
+  while (cursor < end && !isSpace(*cursor))
+    ++cursor;
+  return cursor;
+}
+
+static const char *parseInteger(const char *cursor, const char *end, qint64 &value)
+{
+  bool negative = false;
+  if (cursor < end && *cursor == '-')
+  {
+    negative = true;
+    ++cursor;
+  }
+
+  qint64 result = 0;
+  while (cursor < end && *cursor >= '0' && *cursor <= '9')
+  {
+    result = result * 10 + (*cursor - '0');
+    ++cursor;
+  }
+
+  value = negative ? -result : result;
+  return cursor;
+}
+
+void CpuTimes::resize(int count)
+{
+  for (QVector<qint64> *column : {&user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal, &guest})
+    column->resize(count);
+}
+
+void listProcessIds(const QByteArray &procRoot, QVector<int> &pids)
+{
+  pids.clear();
+
+  DIR *procDir = opendir(procRoot.constData());
+  Instrumentation::countSyscall(Instrumentation::Open);
+  if (!procDir)
+    return;
+
+  while (const dirent *entry = readdir(procDir))
+  {
+    Instrumentation::countSyscall(Instrumentation::DirectoryEntry);
+    const char *name = entry->d_name;
+    if (*name < '1' || *name > '9')
+      continue;
+
+    int pid = 0;
+    for (; *name >= '0' && *name <= '9'; ++name)
+      pid = pid * 10 + (*name - '0');
+    if (*name == '\0')
+      pids.append(pid);
+  }
+
+  closedir(procDir);
+  Instrumentation::countSyscall(Instrumentation::Close);
+}
+
+qsizetype readProcFile(const char *path, QByteArray &buffer)
+{
+  const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  Instrumentation::countSyscall(Instrumentation::Open);
+  if (fd < 0)
+    return -1;
+
+  // procfs files report a size of 0, so read until EOF and grow the buffer only when it fills up.
+  buffer.resize(qMax<qsizetype>(buffer.capacity(), 4096));
+  qsizetype total = 0;
+  for (;;)
+  {
+    const ssize_t bytesRead = ::read(fd, buffer.data() + total, buffer.size() - total);
+    Instrumentation::countSyscall(Instrumentation::Read);
+    if (bytesRead <= 0)
+      break;
+
+    total += bytesRead;
+    if (total == buffer.size())
+      buffer.resize(buffer.size() * 2);
+  }
+
+  ::close(fd);
+  Instrumentation::countSyscall(Instrumentation::Close);
+  buffer.resize(total);
+  return total;
+}
+
+int procFileContains(const char *path, std::initializer_list<QByteArrayView> needles)
+{
+  const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  Instrumentation::countSyscall(Instrumentation::Open);
+  if (fd < 0)
+    return -1;
+
+  qsizetype overlap = 0;
+  for (const QByteArrayView &needle : needles)
+    overlap = qMax(overlap, needle.size() - 1);
+
+  // The last overlap bytes of each chunk are carried over, so a needle that straddles two
+  // reads is still found.
+  constexpr qsizetype chunkSize = 4096;
+  char buffer[chunkSize + 64];
+  qsizetype carried = 0;
+  int found = 0;
+  for (;;)
+  {
+    const ssize_t bytesRead = ::read(fd, buffer + carried, chunkSize);
+    Instrumentation::countSyscall(Instrumentation::Read);
+    if (bytesRead <= 0)
+      break;
+
+    const qsizetype available = carried + bytesRead;
+    for (const QByteArrayView &needle : needles)
+    {
+      if (memmem(buffer, available, needle.data(), needle.size()))
+      {
+        found = 1;
+        break;
+      }
+    }
+    if (found)
+      break;
+
+    carried = qMin(overlap, available);
+    std::memmove(buffer, buffer + available - carried, carried);
+  }
+
+  ::close(fd);
+  Instrumentation::countSyscall(Instrumentation::Close);
+  return found;
+}
+
+bool parseProcStat(const char *data, qsizetype length, ProcStatFields &fields)
+{
+  const char *end = data + length;
+  const char *commBegin = static_cast<const char *>(std::memchr(data, '(', length));
+  if (!commBegin)
+    return false;
+
+  // comm may itself contain ')', so the last one closes it.
+  const char *commEnd = nullptr;
+  for (const char *cursor = end - 1; cursor > commBegin; --cursor)
+  {
+    if (*cursor == ')')
+    {
+      commEnd = cursor;
+      break;
+    }
+  }
+  if (!commEnd)
+    return false;
+
+  fields.comm = commBegin + 1;
+  fields.commLength = static_cast<int>(commEnd - commBegin - 1);
+
+  // Field indices are relative to the first field after comm (state = 0), as in proc(5) minus 3.
+  const char *cursor = commEnd + 1;
+  int index = 0;
+  while (index <= 21)
+  {
+    cursor = skipSpaces(cursor, end);
+    if (cursor >= end)
+      return false;
+
+    qint64 value = 0;
+    switch (index)
+    {
+    case 0:
+      fields.state = *cursor;
+      cursor = skipToken(cursor, end);
+      break;
+    case 1:
+      cursor = parseInteger(cursor, end, value);
+      fields.ppid = static_cast<int>(value);
+      break;
+    case 11:
+      cursor = parseInteger(cursor, end, fields.utime);
+      break;
+    case 12:
+      cursor = parseInteger(cursor, end, fields.stime);
+      break;
+    case 19:
+      cursor = parseInteger(cursor, end, fields.starttime);
+      break;
+    case 21:
+      cursor = parseInteger(cursor, end, fields.rssPages);
+      break;
+    default:
+      cursor = skipToken(cursor, end);
+      break;
+    }
+    ++index;
+  }
+
+  return true;
+}
+
+bool parseStatusUid(const char *data, qsizetype length, uid_t &uid)
+{
+  const char *end = data + length;
+  const char *line = data;
+  while (line < end)
+  {
+    const char *lineEnd = static_cast<const char *>(std::memchr(line, '\n', end - line));
+    if (!lineEnd)
+      lineEnd = end;
+
+    if (lineEnd - line > 4 && std::memcmp(line, "Uid:", 4) == 0)
+    {
+      const char *cursor = skipSpaces(line + 4, lineEnd);
+      if (cursor == lineEnd || *cursor < '0' || *cursor > '9')
+        return false;
+
+      qint64 value = 0;
+      parseInteger(cursor, lineEnd, value);
+      uid = static_cast<uid_t>(value);
+      return true;
+    }
+
+    line = lineEnd + 1;
+  }
+
+  return false;
+}
+
+bool parseProcStatCpu(const char *data, qsizetype length, CpuTimes &times)
+{
+  const char *end = data + length;
+  const char *line = data;
+  int index = 0;
+  while (line < end && end - line > 3 && std::memcmp(line, "cpu", 3) == 0)
+  {
+    const char *lineEnd = static_cast<const char *>(std::memchr(line, '\n', end - line));
+    if (!lineEnd)
+      lineEnd = end;
+
+    // user nice system idle iowait irq softirq steal guest; kernels before 2.6.33 have fewer columns.
+    qint64 values[9] = {};
+    int valueCount = 0;
+    const char *cursor = skipToken(line, lineEnd);
+    while (valueCount < 9)
+    {
+      cursor = skipSpaces(cursor, lineEnd);
+      if (cursor == lineEnd)
+        break;
+      cursor = parseInteger(cursor, lineEnd, values[valueCount++]);
+    }
+
+    if (valueCount >= 4)
+    {
+      if (index >= times.size())
+        times.resize(index + 1);
+      times.user[index] = values[0];
+      times.nice[index] = values[1];
+      times.system[index] = values[2];
+      times.idle[index] = values[3];
+      times.iowait[index] = values[4];
+      times.irq[index] = values[5];
+      times.softirq[index] = values[6];
+      times.steal[index] = values[7];
+      times.guest[index] = values[8];
+      ++index;
+    }
+
+    line = lineEnd + 1;
+  }
+
+  times.resize(index);
+  return index > 0;
+}
+
+void parseMemInfo(const char *data, qsizetype length, MemInfo &info)
+{
+  struct Field
+  {
+    const char *key;
+    int keyLength;
+    qint64 MemInfo::*value;
+  };
+  static const Field fields[] = {
+      {"MemTotal", 8, &MemInfo::memTotal},
+      {"MemAvailable", 12, &MemInfo::memAvailable},
+      {"MemFree", 7, &MemInfo::memFree},
+      {"Buffers", 7, &MemInfo::buffers},
+      {"Cached", 6, &MemInfo::cached},
+      {"SReclaimable", 12, &MemInfo::sReclaimable},
+      {"Shmem", 5, &MemInfo::shmem}};
+
+  const char *end = data + length;
+  const char *line = data;
+  while (line < end)
+  {
+    const char *lineEnd = static_cast<const char *>(std::memchr(line, '\n', end - line));
+    if (!lineEnd)
+      lineEnd = end;
+
+    const char *colon = static_cast<const char *>(std::memchr(line, ':', lineEnd - line));
+    if (colon)
+    {
+      const int keyLength = static_cast<int>(colon - line);
+      for (const Field &field : fields)
+      {
+        if (field.keyLength == keyLength && std::memcmp(line, field.key, keyLength) == 0)
+        {
+          parseInteger(skipSpaces(colon + 1, lineEnd), lineEnd, info.*field.value);
+          break;
+        }
+      }
+    }
+
+    line = lineEnd + 1;
+  }
+}
+
+qsizetype joinCmdline(char *data, qsizetype length)
+{
+  qsizetype out = 0;
+  bool pendingSeparator = false;
+  for (qsizetype in = 0; in < length; ++in)
+  {
+    const char c = data[in];
+    if (c == '\0')
+    {
+      pendingSeparator = out > 0;
+      continue;
+    }
+
+    if (pendingSeparator)
+    {
+      data[out++] = ' ';
+      pendingSeparator = false;
+    }
+    data[out++] = c;
+  }
+
+  while (out > 0 && isSpace(data[out - 1]))
+    --out;
+
+  qsizetype begin = 0;
+  while (begin < out && isSpace(data[begin]))
+    ++begin;
+  if (begin > 0)
+  {
+    std::memmove(data, data + begin, out - begin);
+    out -= begin;
+  }
+
+  return out;
+}
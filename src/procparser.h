@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QVector>
+#include <initializer_list>
+#include <sys/types.h>
+
+struct ProcStatFields
+{
+  char state = '?';
+  int ppid = 0;
+  qint64 utime = 0;
+  qint64 stime = 0;
+  qint64 starttime = 0;
+  qint64 rssPages = 0;
+  // Points into the buffer that was parsed, valid until that buffer is reused.
+  const char *comm = nullptr;
+  int commLength = 0;
+};
+
+// Cumulative CPU times from /proc/stat in clock ticks, one array per column so that a single
+// column can be walked for every core without touching the others. Index 0 is the aggregate
+// "cpu" line and index n + 1 is core n.
+struct CpuTimes
+{
+  QVector<qint64> user;
+  QVector<qint64> nice;
+  QVector<qint64> system;
+  QVector<qint64> idle;
+  QVector<qint64> iowait;
+  QVector<qint64> irq;
+  QVector<qint64> softirq;
+  QVector<qint64> steal;
+  QVector<qint64> guest;
+
+  int size() const { return user.size(); }
+  void resize(int count);
+  // guest time is already accounted for in user, so it is not added again.
+  qint64 total(int index) const
+  {
+    return user[index] + nice[index] + system[index] + idle[index] + iowait[index] + irq[index] + softirq[index] + steal[index];
+  }
+};
+
+// The /proc/meminfo fields used to compute memory usage, in kB; -1 when a field is missing.
+struct MemInfo
+{
+  qint64 memTotal = -1;
+  qint64 memAvailable = -1;
+  qint64 memFree = -1;
+  qint64 buffers = 0;
+  qint64 cached = 0;
+  qint64 sReclaimable = 0;
+  qint64 shmem = 0;
+};
+
+// Numeric entries of procRoot, read with readdir() instead of building a QFileInfo per entry.
+// procRoot is /proc on a live system; the collectors take it as a parameter so that they can be
+// run against a fixture tree.
+void listProcessIds(const QByteArray &procRoot, QVector<int> &pids);
+
+// Reads a whole procfs file into buffer, reusing its existing capacity.
+// Returns the number of bytes read, or -1 if the file could not be opened.
+qsizetype readProcFile(const char *path, QByteArray &buffer);
+
+// Streams a procfs file through a small fixed buffer and stops at the first occurrence of any
+// of the needles, so a large file is only read as far as needed. Needles must be shorter than
+// 64 bytes. Returns 1 if one was found, 0 if none was and -1 if the file could not be opened.
+int procFileContains(const char *path, std::initializer_list<QByteArrayView> needles);
+
+bool parseProcStat(const char *data, qsizetype length, ProcStatFields &fields);
+bool parseStatusUid(const char *data, qsizetype length, uid_t &uid);
+// Parses the leading cpu lines of /proc/stat; times keeps its capacity between calls.
+bool parseProcStatCpu(const char *data, qsizetype length, CpuTimes &times);
+void parseMemInfo(const char *data, qsizetype length, MemInfo &info);
+
+// Turns the NUL separated argv of /proc/<pid>/cmdline into a single space separated,
+// trimmed command line in place and returns its new length.
+qsizetype joinCmdline(char *data, qsizetype length);
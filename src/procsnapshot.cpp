@@ -0,0 +1,265 @@
+#include "procsnapshot.h"
+#include "helperutils.h"
+#include "procparser.h"
+#include "trace.h"
+
+#include <QFile>
+#include <QTextStream>
+#include <QThread>
+#include <climits>
+#include <cstdio>
+
+namespace
+{
+struct CaptureJob
+{
+  static constexpr int chunkSize = 128;
+
+  const QVector<int> *pids = nullptr;
+  const char *procRoot = nullptr;
+  ProcSnapshot::Fields fields;
+  ProcFileCache *fileCache = nullptr;
+  // Only read while the workers run; new identities are stored after they have finished.
+  const ProcessTable<QSharedPointer<const ProcessIdentity>> *identities = nullptr;
+  const ProcessTable<EnvironVerdict> *environVerdicts = nullptr;
+  // Environment verdicts scanned by each worker, stored the same way as new identities.
+  QVector<QVector<std::pair<ProcessKey, EnvironVerdict>>> loadedVerdicts;
+  std::atomic<int> nextChunk{0};
+  std::atomic<int> identityLoads{0};
+};
+}
+
+static QSharedPointer<const ProcessIdentity> loadIdentity(const char *procRoot, int pid, const ProcStatFields &stat, QByteArray &buffer)
+{
+  char path[PATH_MAX];
+  std::snprintf(path, sizeof(path), "%s/%d/cmdline", procRoot, pid);
+  if (readProcFile(path, buffer) < 0)
+    return {};
+
+  QSharedPointer<ProcessIdentity> identity(new ProcessIdentity);
+  identity->cmdline = QByteArray(buffer.constData(), buffer.size());
+  identity->comm = QByteArray(stat.comm, stat.commLength);
+
+  const qsizetype joinedLength = joinCmdline(buffer.data(), buffer.size());
+  identity->displayName = joinedLength > 0 ? QString::fromUtf8(buffer.constData(), joinedLength)
+                                           : QString::fromUtf8(identity->comm);
+  return identity;
+}
+
+// Workers claim fixed size chunks of the PID list from a shared counter until none are left,
+// so a worker that is slowed down by a few expensive processes does not hold up the others.
+static void captureChunks(CaptureJob &job, int worker, ProcSnapshot::Shard &shard)
+{
+  QVector<std::pair<ProcessKey, EnvironVerdict>> &loadedVerdicts = job.loadedVerdicts[worker];
+  // Reused for every PID so that the steady state scan does not allocate per file.
+  QByteArray statBuffer;
+  QByteArray fileBuffer;
+  char path[PATH_MAX];
+
+  const QVector<int> &pids = *job.pids;
+  for (;;)
+  {
+    const int first = job.nextChunk.fetch_add(CaptureJob::chunkSize, std::memory_order_relaxed);
+    if (first >= pids.size())
+      break;
+
+    const int last = qMin<int>(first + CaptureJob::chunkSize, pids.size());
+    for (int index = first; index < last; ++index)
+    {
+      ProcSnapshot::Entry entry;
+      entry.pid = pids[index];
+
+      ProcStatFields stat;
+      if (job.fields.testFlag(ProcSnapshot::Stat) && job.fileCache->readStat(entry.pid, statBuffer) >= 0 &&
+          parseProcStat(statBuffer.constData(), statBuffer.size(), stat))
+      {
+        job.fileCache->checkStartTime(entry.pid, stat.starttime);
+        entry.available |= ProcSnapshot::Stat;
+        entry.state = stat.state;
+        entry.ppid = stat.ppid;
+        entry.utime = stat.utime;
+        entry.stime = stat.stime;
+        entry.starttime = stat.starttime;
+        entry.rssPages = stat.rssPages;
+
+        // setuid() keeps both the image and the start time, so the owner is read every time.
+        if (job.fields.testFlag(ProcSnapshot::Status))
+        {
+          std::snprintf(path, sizeof(path), "%s/%d/status", job.procRoot, entry.pid);
+          if (readProcFile(path, fileBuffer) >= 0 && parseStatusUid(fileBuffer.constData(), fileBuffer.size(), entry.uid))
+          {
+            entry.available |= ProcSnapshot::Status;
+            entry.user = getUserFromUid(entry.uid);
+          }
+        }
+
+        // exec() keeps the start time but changes comm, so a comm mismatch means the cached
+        // identity belongs to the previous image.
+        if (job.fields.testFlag(ProcSnapshot::Cmdline))
+        {
+          const QSharedPointer<const ProcessIdentity> *cached = job.identities->find({entry.pid, entry.starttime});
+          if (cached && QByteArrayView((*cached)->comm) == QByteArrayView(stat.comm, stat.commLength))
+          {
+            entry.identity = *cached;
+          }
+          else
+          {
+            entry.identity = loadIdentity(job.procRoot, entry.pid, stat, fileBuffer);
+            job.identityLoads.fetch_add(1, std::memory_order_relaxed);
+          }
+          if (entry.identity)
+            entry.available |= ProcSnapshot::Cmdline;
+        }
+      }
+
+      if (job.fields.testFlag(ProcSnapshot::Environ) && entry.has(ProcSnapshot::Stat))
+      {
+        const EnvironVerdict *cached = job.environVerdicts->find({entry.pid, entry.starttime});
+        if (cached && QByteArrayView(cached->comm) == QByteArrayView(stat.comm, stat.commLength))
+        {
+          entry.available |= ProcSnapshot::Environ;
+          entry.waylandEnvironment = cached->waylandEnvironment;
+        }
+        else
+        {
+          // Unreadable environments are not cached, since a process can change its
+          // credentials without exec().
+          std::snprintf(path, sizeof(path), "%s/%d/environ", job.procRoot, entry.pid);
+          const int found = procFileContains(path, {"WAYLAND_DISPLAY=", "WAYLAND_SOCKET="});
+          if (found >= 0)
+          {
+            entry.available |= ProcSnapshot::Environ;
+            entry.waylandEnvironment = found;
+            EnvironVerdict verdict;
+            verdict.comm = QByteArray(stat.comm, stat.commLength);
+            verdict.waylandEnvironment = found;
+            loadedVerdicts.append({{entry.pid, entry.starttime}, verdict});
+          }
+        }
+      }
+
+      shard.entries.append(entry);
+    }
+  }
+}
+
+ProcSnapshotter::ProcSnapshotter(const QByteArray &procRoot)
+    : m_procRoot(procRoot), m_fileCache(procRoot)
+{
+  setThreadCount(qEnvironmentVariableIntValue("WINTASKMAN_SCAN_THREADS"));
+}
+
+QSharedPointer<const ProcSnapshot> ProcSnapshotter::capture(ProcSnapshot::Fields fields, quint64 tick)
+{
+  // Identities and environment verdicts are keyed by start time, which comes from stat, and
+  // status is only read for processes whose stat could be read.
+  if (fields & (ProcSnapshot::Status | ProcSnapshot::Cmdline | ProcSnapshot::Environ))
+    fields |= ProcSnapshot::Stat;
+
+  QSharedPointer<ProcSnapshot> snapshot(new ProcSnapshot);
+  snapshot->tick = tick;
+  snapshot->fields = fields;
+
+  listProcessIds(m_procRoot, m_pids);
+  snapshot->processCount = m_pids.size();
+
+  QFile uptimeFile(QString::fromLocal8Bit(m_procRoot + "/uptime"));
+  if (uptimeFile.open(QIODevice::ReadOnly))
+  {
+    QTextStream uptimeStream(&uptimeFile);
+    uptimeStream >> snapshot->uptimeSeconds;
+    uptimeFile.close();
+  }
+
+  // A plain PID count needs no per-process reads at all.
+  if (!fields)
+    return snapshot;
+
+  CaptureJob job;
+  job.pids = &m_pids;
+  job.procRoot = m_procRoot.constData();
+  job.fields = fields;
+  job.fileCache = &m_fileCache;
+  job.identities = &m_identities;
+  job.environVerdicts = &m_environVerdicts;
+
+  // Small process tables are not worth the thread handoff.
+  const int chunkCount = (m_pids.size() + CaptureJob::chunkSize - 1) / CaptureJob::chunkSize;
+  const int workerCount = qBound(1, threadCount(), qMax(1, chunkCount));
+
+  // Each worker fills its own shard; the calling thread is worker 0.
+  snapshot->shards.resize(workerCount);
+  job.loadedVerdicts.resize(workerCount);
+  if (fields.testFlag(ProcSnapshot::Stat))
+    m_fileCache.beginScan(m_pids.size());
+  if (workerCount > 1)
+  {
+    m_pool.setMaxThreadCount(workerCount - 1);
+    for (int worker = 1; worker < workerCount; ++worker)
+    {
+      ProcSnapshot::Shard *shard = &snapshot->shards[worker];
+      m_pool.start([&job, worker, shard]()
+                   { captureChunks(job, worker, *shard); });
+    }
+  }
+  captureChunks(job, 0, snapshot->shards[0]);
+  m_pool.waitForDone();
+  if (fields.testFlag(ProcSnapshot::Stat))
+    m_fileCache.endScan();
+
+  if (fields.testFlag(ProcSnapshot::Cmdline))
+  {
+    m_identities.beginScan();
+    for (const ProcSnapshot::Shard &shard : std::as_const(snapshot->shards))
+    {
+      for (const ProcSnapshot::Entry &entry : shard.entries)
+      {
+        if (entry.identity)
+          m_identities.mark({entry.pid, entry.starttime}) = entry.identity;
+      }
+    }
+    m_identities.sweep();
+  }
+
+  int environLoads = 0;
+  if (fields.testFlag(ProcSnapshot::Environ))
+  {
+    m_environVerdicts.beginScan();
+    for (const ProcSnapshot::Shard &shard : std::as_const(snapshot->shards))
+    {
+      for (const ProcSnapshot::Entry &entry : shard.entries)
+      {
+        if (entry.has(ProcSnapshot::Environ))
+          m_environVerdicts.mark({entry.pid, entry.starttime});
+      }
+    }
+    for (const auto &loaded : std::as_const(job.loadedVerdicts))
+    {
+      environLoads += int(loaded.size());
+      for (const auto &[key, verdict] : loaded)
+        m_environVerdicts.mark(key) = verdict;
+    }
+    m_environVerdicts.sweep();
+  }
+
+  WTM_TRACE("procsnapshot", "tick %llu: %d processes, fields 0x%x, %d workers, %d identities and %d environments loaded",
+            static_cast<unsigned long long>(tick), snapshot->processCount, static_cast<unsigned>(fields.toInt()),
+            workerCount, job.identityLoads.load(), environLoads);
+  return snapshot;
+}
+
+void ProcSnapshotter::setThreadCount(int count)
+{
+  m_threadCount = qMax(0, count);
+}
+
+int ProcSnapshotter::threadCount() const
+{
+  const int count = m_threadCount;
+  return count > 0 ? count : QThread::idealThreadCount();
+}
+
+ProcFileCacheStats ProcSnapshotter::fileCacheStats() const
+{
+  return m_fileCache.stats();
+}
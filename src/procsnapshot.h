@@ -0,0 +1,111 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFlags>
+#include <QSharedPointer>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include <atomic>
+#include <sys/types.h>
+
+#include "procfilecache.h"
+#include "processtable.h"
+
+// Fields that stay the same for the lifetime of a process image. They are loaded once per
+// (pid, starttime) and shared by every later snapshot. The owner is not among them: a process
+// can change its uid without exec(), so status is read on every scan.
+struct ProcessIdentity
+{
+  QByteArray comm;
+  // The raw, NUL separated argv of the process.
+  QByteArray cmdline;
+  // argv joined with spaces, or comm for processes without one (kernel threads, zombies).
+  QString displayName;
+};
+
+// Whether a process image was started with a Wayland connection in its environment. The
+// environment of an image never changes, so it is scanned once per (pid, starttime); comm
+// detects an exec() that kept the start time.
+struct EnvironVerdict
+{
+  QByteArray comm;
+  bool waylandEnvironment = false;
+};
+
+// The contents of /proc at one point in time. The directory is enumerated once and every
+// requested file is read at most once, so the usage, process and application collectors of
+// the same tick can all work from one capture. Snapshots are immutable once published.
+class ProcSnapshot
+{
+public:
+  enum Field
+  {
+    Stat = 0x1,
+    // Status and Cmdline imply Stat; identities are keyed by its start time.
+    Status = 0x2,
+    Cmdline = 0x4,
+    // Implies Stat, which provides the start time the environment verdicts are keyed by.
+    Environ = 0x8
+  };
+  Q_DECLARE_FLAGS(Fields, Field)
+
+  struct Entry
+  {
+    int pid = 0;
+    // The subset of the captured fields that could actually be read for this process.
+    Fields available;
+    char state = '?';
+    int ppid = 0;
+    qint64 utime = 0;
+    qint64 stime = 0;
+    qint64 starttime = 0;
+    qint64 rssPages = 0;
+    bool waylandEnvironment = false;
+    // Set whenever Status is available; user comes from the process wide uid -> name cache.
+    uid_t uid = 0;
+    QString user;
+    // Set whenever Cmdline is available.
+    QSharedPointer<const ProcessIdentity> identity;
+
+    bool has(Fields fields) const { return (available & fields) == fields; }
+  };
+
+  // Entries captured by one scan worker.
+  struct Shard
+  {
+    QVector<Entry> entries;
+  };
+
+  quint64 tick = 0;
+  Fields fields;
+  double uptimeSeconds = 0.0;
+  int processCount = 0;
+  QVector<Shard> shards;
+
+  bool has(Fields required) const { return (fields & required) == required; }
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(ProcSnapshot::Fields)
+
+class ProcSnapshotter
+{
+public:
+  explicit ProcSnapshotter(const QByteArray &procRoot = QByteArrayLiteral("/proc"));
+
+  QSharedPointer<const ProcSnapshot> capture(ProcSnapshot::Fields fields, quint64 tick);
+
+  // Number of threads used to scan /proc; 0 picks QThread::idealThreadCount().
+  void setThreadCount(int count);
+  int threadCount() const;
+  ProcFileCacheStats fileCacheStats() const;
+
+private:
+  QByteArray m_procRoot;
+  ProcFileCache m_fileCache;
+  ProcessTable<QSharedPointer<const ProcessIdentity>> m_identities;
+  ProcessTable<EnvironVerdict> m_environVerdicts;
+  QThreadPool m_pool;
+  std::atomic<int> m_threadCount{0};
+  QVector<int> m_pids;
+};
@@ -1,4 +1,5 @@
 #include "rundialog.h"
+#include "procfilecache.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QLineEdit>
@@ -16,6 +17,16 @@
 #include <QScreen>
 #include <QApplication>
 
+// Starts the program with the descriptor limit the application itself was started with.
+static bool startDetached(const QString &program, const QStringList &arguments)
+{
+  QProcess process;
+  process.setProgram(program);
+  process.setArguments(arguments);
+  process.setChildProcessModifier(restoreOpenFileLimit);
+  return process.startDetached();
+}
+
 RunDialog::RunDialog(QWidget *parent)
     : QDialog(parent)
 {
@@ -188,13 +199,13 @@ void RunDialog::onOkClicked()
   }
 
   // Try to start the command/program
-  if (!QProcess::startDetached(program, arguments))
+  if (!startDetached(program, arguments))
   {
     // If it's not an executable, try to open it with the system default application
     if (!QDesktopServices::openUrl(QUrl::fromLocalFile(command)))
     {
       // Fallback: try the command as-is with shell
-      QProcess::startDetached("sh", {"-c", command});
+      startDetached("sh", {"-c", command});
     }
   }
 
@@ -0,0 +1,52 @@
+#include "samplehistory.h"
+
+SampleHistory::SampleHistory(int capacity)
+    : m_values(qMax(1, capacity)), m_timestamps(qMax(1, capacity))
+{
+}
+
+void SampleHistory::setCapacity(int capacity)
+{
+  capacity = qMax(1, capacity);
+  if (capacity == m_values.size())
+    return;
+
+  const int kept = qMin(m_size, capacity);
+  QVector<double> values(capacity);
+  QVector<qint64> timestamps(capacity);
+  for (int index = 0; index < kept; ++index)
+  {
+    values[index] = value(m_size - kept + index);
+    timestamps[index] = timestamp(m_size - kept + index);
+  }
+
+  m_values.swap(values);
+  m_timestamps.swap(timestamps);
+  m_start = 0;
+  m_size = kept;
+}
+
+void SampleHistory::append(qint64 timestampMs, double value)
+{
+  int slot = 0;
+  if (m_size < m_values.size())
+  {
+    slot = physicalIndex(m_size);
+    ++m_size;
+  }
+  else
+  {
+    slot = m_start;
+    m_start = (m_start + 1) % m_values.size();
+  }
+
+  m_values[slot] = value;
+  m_timestamps[slot] = timestampMs;
+  ++m_appendCount;
+}
+
+void SampleHistory::clear()
+{
+  m_start = 0;
+  m_size = 0;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QVector>
+
+// Fixed capacity time series of the most recent samples. Appending overwrites the oldest
+// sample in O(1) instead of shifting the others, and every sample carries the monotonic
+// timestamp it was taken at.
+class SampleHistory
+{
+public:
+  explicit SampleHistory(int capacity = 60);
+
+  int capacity() const { return m_values.size(); }
+  int size() const { return m_size; }
+  bool isEmpty() const { return m_size == 0; }
+  // Total number of samples appended since construction, including overwritten ones.
+  quint64 appendCount() const { return m_appendCount; }
+
+  // Keeps the newest samples that still fit.
+  void setCapacity(int capacity);
+  void append(qint64 timestampMs, double value);
+  void clear();
+
+  // Index 0 is the oldest sample still held.
+  double value(int index) const { return m_values[physicalIndex(index)]; }
+  qint64 timestamp(int index) const { return m_timestamps[physicalIndex(index)]; }
+
+private:
+  int physicalIndex(int index) const { return (m_start + index) % m_values.size(); }
+
+  QVector<double> m_values;
+  QVector<qint64> m_timestamps;
+  int m_start = 0;
+  int m_size = 0;
+  quint64 m_appendCount = 0;
+};
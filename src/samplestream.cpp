@@ -0,0 +1,451 @@
+#include "samplestream.h"
+#include "instrumentation.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+// Stream header: magic followed by the format version.
+constexpr char streamMagic[] = "WTMS";
+constexpr char streamVersion = 2;
+constexpr qsizetype headerSize = 5;
+// Frames are never anywhere near this; a longer length means the stream is corrupt.
+constexpr quint64 maxPayloadSize = 256 * 1024 * 1024;
+
+enum RowField : quint8
+{
+  NameField = 0x1,
+  UserField = 0x2,
+  CpuField = 0x4,
+  MemoryField = 0x8
+};
+
+bool keyLess(const ProcessKey &a, const ProcessKey &b)
+{
+  return a.pid != b.pid ? a.pid < b.pid : a.starttime < b.starttime;
+}
+
+quint64 zigzag(qint64 value)
+{
+  return (quint64(value) << 1) ^ quint64(value >> 63);
+}
+
+qint64 unzigzag(quint64 value)
+{
+  return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+// Reads from a frame payload; once anything runs past the end, every later read fails too.
+class PayloadReader
+{
+public:
+  explicit PayloadReader(QByteArrayView data) : m_data(data) {}
+
+  bool ok() const { return m_ok; }
+  bool atEnd() const { return m_position == m_data.size(); }
+
+  quint8 byte()
+  {
+    if (m_position >= m_data.size())
+    {
+      m_ok = false;
+      return 0;
+    }
+    return quint8(m_data[m_position++]);
+  }
+
+  quint64 varint()
+  {
+    quint64 value = 0;
+    for (int shift = 0; shift < 64 && m_ok; shift += 7)
+    {
+      const quint8 next = byte();
+      value |= quint64(next & 0x7f) << shift;
+      if (!(next & 0x80))
+        return value;
+    }
+    m_ok = false;
+    return 0;
+  }
+
+  QString string()
+  {
+    const quint64 size = varint();
+    if (!m_ok || size > quint64(m_data.size() - m_position))
+    {
+      m_ok = false;
+      return QString();
+    }
+    const QString text = QString::fromUtf8(m_data.sliced(m_position, qsizetype(size)));
+    m_position += qsizetype(size);
+    return text;
+  }
+
+private:
+  QByteArrayView m_data;
+  qsizetype m_position = 0;
+  bool m_ok = true;
+};
+
+// Length of the varint at the start of data, or 0 if it is not complete yet.
+qsizetype peekVarint(QByteArrayView data, quint64 &value)
+{
+  value = 0;
+  for (qsizetype index = 0; index < data.size() && index < 10; ++index)
+  {
+    value |= quint64(quint8(data[index]) & 0x7f) << (7 * index);
+    if (!(quint8(data[index]) & 0x80))
+      return index + 1;
+  }
+  return 0;
+}
+
+bool sameRow(const ProcessInfo &a, const ProcessInfo &b)
+{
+  return cpuPermille(a.cpuPercent) == cpuPermille(b.cpuPercent) &&
+         qint64(a.memoryKb) == qint64(b.memoryKb) && a.name == b.name && a.user == b.user;
+}
+
+void appendVarint(QByteArray &out, quint64 value)
+{
+  while (value >= 0x80)
+  {
+    out += char((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out += char(value);
+}
+
+void appendString(QByteArray &out, const QString &text)
+{
+  const QByteArray utf8 = text.toUtf8();
+  appendVarint(out, quint64(utf8.size()));
+  out += utf8;
+}
+
+void appendUsage(QByteArray &out, const SystemUsage &usage)
+{
+  appendVarint(out, quint64(qMax(0, usage.cpuUsage)));
+  appendVarint(out, quint64(qMax<qint64>(0, usage.ramUsage)));
+  appendVarint(out, quint64(qMax<qint64>(0, usage.totalRam)));
+  appendVarint(out, quint64(qMax(0, usage.totalProcesses)));
+  appendVarint(out, quint64(qMax(0, cpuPermille(usage.iowaitPercent))));
+  appendVarint(out, quint64(qMax(0, cpuPermille(usage.stealPercent))));
+  appendVarint(out, quint64(usage.coreUsages.size()));
+  for (int coreUsage : usage.coreUsages)
+    appendVarint(out, quint64(qMax(0, coreUsage)));
+}
+
+QByteArray encodeBinary(const SampleFrame &frame)
+{
+  QByteArray payload;
+  payload.reserve(64 + frame.upserts.size() * 16 + frame.removed.size() * 8);
+  payload += char(frame.kind);
+  appendVarint(payload, frame.tick);
+  appendVarint(payload, quint64(qMax<qint64>(0, frame.timestampMs)));
+  appendUsage(payload, frame.usage);
+
+  // Sorted rows keep the pid distances, and with them the varints, short.
+  QVector<int> order(frame.upserts.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&frame](int a, int b)
+            { return keyLess({frame.upserts[a].pid, frame.upserts[a].starttime}, {frame.upserts[b].pid, frame.upserts[b].starttime}); });
+
+  appendVarint(payload, quint64(order.size()));
+  int previousPid = 0;
+  for (int index : std::as_const(order))
+  {
+    const ProcessInfo &row = frame.upserts[index];
+    const ProcessInfo &before = index < frame.previous.size() ? frame.previous[index] : ProcessInfo();
+    const int cpuDelta = cpuPermille(row.cpuPercent) - cpuPermille(before.cpuPercent);
+    const qint64 memoryDelta = qint64(row.memoryKb) - qint64(before.memoryKb);
+
+    quint8 fields = 0;
+    if (row.name != before.name)
+      fields |= NameField;
+    if (row.user != before.user)
+      fields |= UserField;
+    if (cpuDelta != 0)
+      fields |= CpuField;
+    if (memoryDelta != 0)
+      fields |= MemoryField;
+
+    appendVarint(payload, quint64(row.pid - previousPid));
+    previousPid = row.pid;
+    appendVarint(payload, quint64(row.starttime));
+    payload += char(fields);
+    if (fields & NameField)
+      appendString(payload, row.name);
+    if (fields & UserField)
+      appendString(payload, row.user);
+    if (fields & CpuField)
+      appendVarint(payload, zigzag(cpuDelta));
+    if (fields & MemoryField)
+      appendVarint(payload, zigzag(memoryDelta));
+  }
+
+  QVector<ProcessKey> removed = frame.removed;
+  std::sort(removed.begin(), removed.end(), keyLess);
+  appendVarint(payload, quint64(removed.size()));
+  previousPid = 0;
+  for (const ProcessKey &key : std::as_const(removed))
+  {
+    appendVarint(payload, quint64(key.pid - previousPid));
+    previousPid = key.pid;
+    appendVarint(payload, quint64(key.starttime));
+  }
+
+  QByteArray out;
+  out.reserve(payload.size() + 5);
+  appendVarint(out, quint64(payload.size()));
+  out += payload;
+  return out;
+}
+
+QByteArray encodeJson(const SampleFrame &frame)
+{
+  QJsonArray cores;
+  for (int coreUsage : frame.usage.coreUsages)
+    cores.append(coreUsage);
+
+  QJsonObject usage;
+  usage.insert(QStringLiteral("cpu"), frame.usage.cpuUsage);
+  usage.insert(QStringLiteral("cores"), cores);
+  usage.insert(QStringLiteral("ramKb"), frame.usage.ramUsage);
+  usage.insert(QStringLiteral("totalRamKb"), frame.usage.totalRam);
+  usage.insert(QStringLiteral("processes"), frame.usage.totalProcesses);
+  usage.insert(QStringLiteral("iowait"), cpuPermille(frame.usage.iowaitPercent) / 10.0);
+  usage.insert(QStringLiteral("steal"), cpuPermille(frame.usage.stealPercent) / 10.0);
+
+  QJsonArray upserts;
+  for (const ProcessInfo &row : frame.upserts)
+  {
+    QJsonObject object;
+    object.insert(QStringLiteral("pid"), row.pid);
+    object.insert(QStringLiteral("starttime"), row.starttime);
+    object.insert(QStringLiteral("name"), row.name);
+    object.insert(QStringLiteral("user"), row.user);
+    object.insert(QStringLiteral("cpu"), cpuPermille(row.cpuPercent) / 10.0);
+    object.insert(QStringLiteral("memoryKb"), qint64(row.memoryKb));
+    upserts.append(object);
+  }
+
+  QJsonArray removed;
+  for (const ProcessKey &key : frame.removed)
+    removed.append(QJsonArray{key.pid, key.starttime});
+
+  QJsonObject object;
+  object.insert(QStringLiteral("type"), frame.kind == SampleFrame::Baseline ? QStringLiteral("baseline") : QStringLiteral("delta"));
+  object.insert(QStringLiteral("tick"), qint64(frame.tick));
+  object.insert(QStringLiteral("time"), frame.timestampMs);
+  object.insert(QStringLiteral("usage"), usage);
+  object.insert(QStringLiteral("upserts"), upserts);
+  object.insert(QStringLiteral("removed"), removed);
+
+  QByteArray line = QJsonDocument(object).toJson(QJsonDocument::Compact);
+  line += '\n';
+  return line;
+}
+}
+
+int cpuPermille(double percent)
+{
+  return static_cast<int>(std::lround(percent * 10.0));
+}
+
+SampleFrame SampleDiffer::diff(quint64 tick, qint64 timestampMs, const SystemUsage &usage, const QList<ProcessInfo> &rows)
+{
+  SampleFrame frame;
+  frame.kind = m_started ? SampleFrame::Delta : SampleFrame::Baseline;
+  frame.tick = tick;
+  frame.timestampMs = timestampMs;
+  frame.usage = usage;
+
+  m_rows.beginScan();
+  for (const ProcessInfo &row : rows)
+  {
+    const bool known = m_rows.find({row.pid, row.starttime}) != nullptr;
+    ProcessInfo &previous = m_rows.mark({row.pid, row.starttime});
+    if (known && sameRow(previous, row))
+      continue;
+    frame.previous.append(known ? previous : ProcessInfo());
+    previous = row;
+    frame.upserts.append(row);
+  }
+  m_rows.sweep([&frame](const ProcessKey &key, const ProcessInfo &)
+               { frame.removed.append(key); });
+
+  m_started = true;
+  m_tick = tick;
+  m_timestampMs = timestampMs;
+  m_usage = usage;
+  return frame;
+}
+
+SampleFrame SampleDiffer::baseline() const
+{
+  SampleFrame frame;
+  frame.kind = SampleFrame::Baseline;
+  frame.tick = m_tick;
+  frame.timestampMs = m_timestampMs;
+  frame.usage = m_usage;
+  frame.upserts.reserve(m_rows.size());
+  frame.previous.fill(ProcessInfo(), m_rows.size());
+  m_rows.forEach([&frame](const ProcessKey &, const ProcessInfo &row)
+                 { frame.upserts.append(row); });
+  return frame;
+}
+
+QByteArray sampleStreamHeader(SampleFormat format)
+{
+  if (format == SampleFormat::Binary)
+    return QByteArray(streamMagic) + streamVersion;
+  return {};
+}
+
+QByteArray encodeSampleFrame(const SampleFrame &frame, SampleFormat format)
+{
+  return format == SampleFormat::Binary ? encodeBinary(frame) : encodeJson(frame);
+}
+
+bool SampleStreamDecoder::feed(QByteArrayView data)
+{
+  if (m_failed)
+    return false;
+
+  Instrumentation::StageTimer stageTimer(Instrumentation::StreamDecode);
+  m_buffer.append(data);
+  qsizetype position = 0;
+  if (!m_headerSeen)
+  {
+    if (m_buffer.size() < headerSize)
+      return true;
+    if (!m_buffer.startsWith(streamMagic) || m_buffer[headerSize - 1] != streamVersion)
+    {
+      m_failed = true;
+      return false;
+    }
+    m_headerSeen = true;
+    position = headerSize;
+  }
+
+  for (;;)
+  {
+    const QByteArrayView pending = QByteArrayView(m_buffer).sliced(position);
+    quint64 payloadSize = 0;
+    const qsizetype prefixSize = peekVarint(pending, payloadSize);
+    if (prefixSize == 0 && pending.size() >= 10)
+      m_failed = true;
+    if (prefixSize == 0 || m_failed)
+      break;
+    if (payloadSize > maxPayloadSize)
+    {
+      m_failed = true;
+      break;
+    }
+    if (quint64(pending.size() - prefixSize) < payloadSize)
+      break;
+
+    if (!applyFrame(pending.sliced(prefixSize, qsizetype(payloadSize))))
+    {
+      m_failed = true;
+      break;
+    }
+    position += prefixSize + qsizetype(payloadSize);
+  }
+
+  m_buffer.remove(0, position);
+  return !m_failed;
+}
+
+void SampleStreamDecoder::reset()
+{
+  m_buffer.clear();
+  m_headerSeen = false;
+  m_failed = false;
+  m_synchronized = false;
+  m_frameCount = 0;
+  m_tick = 0;
+  m_timestampMs = 0;
+  m_usage = SystemUsage();
+  m_processes.clear();
+}
+
+bool SampleStreamDecoder::applyFrame(QByteArrayView payload)
+{
+  PayloadReader reader(payload);
+  const quint8 kind = reader.byte();
+  if (kind != SampleFrame::Baseline && kind != SampleFrame::Delta)
+    return false;
+  // Deltas only make sense on top of the baseline they follow.
+  if (kind == SampleFrame::Delta && !m_synchronized)
+    return false;
+
+  const quint64 tick = reader.varint();
+  const qint64 timestampMs = qint64(reader.varint());
+  SystemUsage usage;
+  usage.cpuUsage = int(reader.varint());
+  usage.ramUsage = qint64(reader.varint());
+  usage.totalRam = qint64(reader.varint());
+  usage.totalProcesses = int(reader.varint());
+  usage.iowaitPercent = reader.varint() / 10.0;
+  usage.stealPercent = reader.varint() / 10.0;
+  const quint64 coreCount = reader.varint();
+  if (!reader.ok() || coreCount > quint64(payload.size()))
+    return false;
+  usage.coreCount = int(coreCount);
+  usage.coreUsages.reserve(usage.coreCount);
+  for (int core = 0; core < usage.coreCount; ++core)
+    usage.coreUsages.append(int(reader.varint()));
+
+  if (kind == SampleFrame::Baseline)
+    m_processes.clear();
+
+  const quint64 upsertCount = reader.varint();
+  if (!reader.ok() || upsertCount > quint64(payload.size()))
+    return false;
+  int pid = 0;
+  for (quint64 count = 0; count < upsertCount && reader.ok(); ++count)
+  {
+    pid += int(reader.varint());
+    const qint64 starttime = qint64(reader.varint());
+    const quint8 fields = reader.byte();
+
+    ProcessInfo &row = m_processes.mark({pid, starttime});
+    row.pid = pid;
+    row.starttime = starttime;
+    if (fields & NameField)
+      row.name = reader.string();
+    if (fields & UserField)
+      row.user = reader.string();
+    if (fields & CpuField)
+      row.cpuPercent = (cpuPermille(row.cpuPercent) + unzigzag(reader.varint())) / 10.0;
+    if (fields & MemoryField)
+      row.memoryKb = double(qint64(row.memoryKb) + unzigzag(reader.varint()));
+  }
+
+  const quint64 removedCount = reader.varint();
+  if (!reader.ok() || removedCount > quint64(payload.size()))
+    return false;
+  pid = 0;
+  for (quint64 count = 0; count < removedCount && reader.ok(); ++count)
+  {
+    pid += int(reader.varint());
+    m_processes.remove({pid, qint64(reader.varint())});
+  }
+
+  if (!reader.ok() || !reader.atEnd())
+    return false;
+
+  m_synchronized = true;
+  ++m_frameCount;
+  m_tick = tick;
+  m_timestampMs = timestampMs;
+  m_usage = std::move(usage);
+  return true;
+}
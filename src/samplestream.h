@@ -0,0 +1,103 @@
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QList>
+#include <QVector>
+
+#include "processtable.h"
+#include "systemsampler.h"
+
+// One tick of the agent's stream. A baseline frame carries every row and replaces whatever the
+// consumer had; a delta frame only carries the rows that appeared or changed since the previous
+// frame, plus the keys of the processes that exited.
+struct SampleFrame
+{
+  enum Kind : quint8
+  {
+    Baseline = 1,
+    Delta = 2
+  };
+
+  Kind kind = Delta;
+  quint64 tick = 0;
+  // Milliseconds since the epoch at which the sample was taken.
+  qint64 timestampMs = 0;
+  SystemUsage usage;
+  QList<ProcessInfo> upserts;
+  // For every upsert, the row the consumer had before this frame; default constructed for
+  // processes that are new to it. The binary encoding only sends the difference.
+  QList<ProcessInfo> previous;
+  QVector<ProcessKey> removed;
+};
+
+enum class SampleFormat
+{
+  JsonLines,
+  Binary
+};
+
+// Keeps the rows of the previous sample and turns every new sample into the frame that brings a
+// consumer of the previous one up to date. Rows are compared on the values the encoders send, so
+// CPU jitter below their resolution does not count as a change.
+class SampleDiffer
+{
+public:
+  // The first call returns a baseline, later ones return deltas.
+  SampleFrame diff(quint64 tick, qint64 timestampMs, const SystemUsage &usage, const QList<ProcessInfo> &rows);
+  // A baseline of the state after the last diff(), for consumers that join mid-stream.
+  SampleFrame baseline() const;
+
+private:
+  ProcessTable<ProcessInfo> m_rows;
+  bool m_started = false;
+  quint64 m_tick = 0;
+  qint64 m_timestampMs = 0;
+  SystemUsage m_usage;
+};
+
+// CPU shares are sent in tenths of a percent.
+int cpuPermille(double percent);
+
+// Bytes a binary stream starts with, before its first frame.
+QByteArray sampleStreamHeader(SampleFormat format);
+// A JSON Lines frame is one line of JSON with the full upserted rows. A binary frame is a varint
+// payload length followed by the payload, which is made of varints and length prefixed UTF-8
+// strings. Its rows are sorted by (pid, starttime) and each one is sent as the pid's distance to
+// the previous row's pid, the starttime, a mask of the fields that changed and, for those, the
+// new name or user and the zigzag encoded change of CPU permille and memory kB.
+QByteArray encodeSampleFrame(const SampleFrame &frame, SampleFormat format);
+
+// Applies a binary stream as it arrives, keeping the state its frames describe: the latest usage
+// and every live process. Data may be fed in pieces of any size.
+class SampleStreamDecoder
+{
+public:
+  // Decodes every complete frame in the buffered data. Returns false once the stream turned out
+  // to be malformed; nothing is applied after that until reset().
+  bool feed(QByteArrayView data);
+  // Forgets all state, for a new connection.
+  void reset();
+
+  bool hasFailed() const { return m_failed; }
+  // Whether a baseline has been applied, before which the state is empty.
+  bool isSynchronized() const { return m_synchronized; }
+  quint64 frameCount() const { return m_frameCount; }
+  quint64 tick() const { return m_tick; }
+  qint64 timestampMs() const { return m_timestampMs; }
+  const SystemUsage &usage() const { return m_usage; }
+  const ProcessTable<ProcessInfo> &processes() const { return m_processes; }
+
+private:
+  bool applyFrame(QByteArrayView payload);
+
+  QByteArray m_buffer;
+  bool m_headerSeen = false;
+  bool m_failed = false;
+  bool m_synchronized = false;
+  quint64 m_frameCount = 0;
+  quint64 m_tick = 0;
+  qint64 m_timestampMs = 0;
+  SystemUsage m_usage;
+  ProcessTable<ProcessInfo> m_processes;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QSharedPointer>
+#include <atomic>
+
+// Hands immutable snapshots from one producer thread to one consumer thread through three slots
+// (triple buffering). publish() and latest() never block and never copy the snapshot itself: the
+// producer fills its private slot and swaps it with the shared middle slot, the consumer swaps the
+// middle slot with its own when something new was published. Each side only ever touches the slot
+// it currently owns, so the slots themselves need no locking.
+template <typename T>
+class SnapshotChannel
+{
+public:
+  using Snapshot = QSharedPointer<const T>;
+
+  // Producer side. Superseded snapshots are released here, on the producer's thread.
+  void publish(Snapshot snapshot)
+  {
+    m_slots[m_back] = std::move(snapshot);
+    const int previous = m_middle.exchange(m_back | freshFlag, std::memory_order_acq_rel);
+    m_back = previous & indexMask;
+  }
+
+  // Consumer side. Returns the newest published snapshot, which is the one returned by the
+  // previous call if nothing was published since (null before the first publish()).
+  Snapshot latest()
+  {
+    if (m_middle.load(std::memory_order_relaxed) & freshFlag)
+    {
+      const int previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+      m_front = previous & indexMask;
+    }
+    return m_slots[m_front];
+  }
+
+private:
+  static constexpr int indexMask = 0x3;
+  static constexpr int freshFlag = 0x4;
+
+  Snapshot m_slots[3];
+  alignas(64) int m_back = 0;
+  alignas(64) std::atomic<int> m_middle{1};
+  alignas(64) int m_front = 2;
+};
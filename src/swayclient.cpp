@@ -0,0 +1,285 @@
+#include "swayclient.h"
+#include "trace.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutexLocker>
+#include <QVector>
+#include <QtEndian>
+#include <algorithm>
+
+// Every message is the magic string, the payload length and the message type, both as 32 bit
+// integers in host byte order, followed by the JSON payload.
+static const QByteArray ipcMagic = QByteArrayLiteral("i3-ipc");
+static constexpr int headerSize = 14;
+
+static constexpr quint32 subscribeMessage = 2;
+static constexpr quint32 getTreeMessage = 4;
+static constexpr quint32 workspaceEvent = 0x80000000;
+static constexpr quint32 windowEvent = 0x80000003;
+
+static constexpr int initialRetryIntervalMs = 1000;
+static constexpr int maxRetryIntervalMs = 60000;
+
+// Reads the id, application id and visibility of a tree node; returns false if it is not a window.
+static bool windowFromNode(const QJsonObject &node, qint64 &id, QString &appId, bool &visible)
+{
+  const QString type = node.value(QLatin1String("type")).toString();
+  if ((type != QLatin1String("con") && type != QLatin1String("floating_con")) || node.value(QLatin1String("window")).isNull())
+    return false;
+
+  const QJsonObject properties = node.value(QLatin1String("window_properties")).toObject();
+  appId = properties.value(QLatin1String("class")).toString();
+  if (appId.isEmpty())
+    appId = properties.value(QLatin1String("instance")).toString();
+  if (appId.isEmpty())
+    appId = node.value(QLatin1String("app_id")).toString();
+  if (appId.isEmpty())
+    appId = node.value(QLatin1String("name")).toString();
+
+  id = node.value(QLatin1String("id")).toInteger();
+  visible = node.value(QLatin1String("visible")).toBool();
+  return true;
+}
+
+SwayClient::SwayClient(const QString &socketPath, QObject *parent)
+    : QObject(parent), m_socketPath(socketPath), m_retryIntervalMs(initialRetryIntervalMs)
+{
+  if (socketPath.isEmpty())
+  {
+    m_state = Unavailable;
+    return;
+  }
+
+  connect(&m_socket, &QLocalSocket::connected, this, &SwayClient::onConnected);
+  connect(&m_socket, &QLocalSocket::readyRead, this, &SwayClient::onReadyRead);
+  connect(&m_socket, &QLocalSocket::disconnected, this, &SwayClient::onDisconnected);
+  connect(&m_socket, &QLocalSocket::errorOccurred, this, &SwayClient::onErrorOccurred);
+  m_retryTimer.setSingleShot(true);
+  connect(&m_retryTimer, &QTimer::timeout, this, &SwayClient::reconnect);
+  m_socket.connectToServer(m_socketPath);
+}
+
+SwayClient::~SwayClient()
+{
+  // The socket is destroyed after the members its disconnect would touch, and must not schedule
+  // a retry.
+  m_socket.disconnect(this);
+}
+
+SwayClient::State SwayClient::state() const
+{
+  return m_state.load();
+}
+
+quint64 SwayClient::generation() const
+{
+  return m_generation.load();
+}
+
+QStringList SwayClient::applications() const
+{
+  QMutexLocker locker(&m_mutex);
+  if (m_applicationsDirty)
+  {
+    m_applications.clear();
+    for (const Window &window : m_windowsById)
+    {
+      if (window.visible && !window.appId.isEmpty())
+        m_applications.append(window.appId);
+    }
+    m_applications.removeDuplicates();
+    m_applications.sort();
+    m_applicationsDirty = false;
+  }
+  return m_applications;
+}
+
+void SwayClient::onConnected()
+{
+  // Subscribing before the tree is requested means no change can slip in between the two;
+  // events that arrive before the tree are superseded by it.
+  send(subscribeMessage, QByteArrayLiteral("[\"window\",\"workspace\"]"));
+  requestTree();
+}
+
+void SwayClient::onReadyRead()
+{
+  m_buffer.append(m_socket.readAll());
+
+  qsizetype offset = 0;
+  while (m_buffer.size() - offset >= headerSize)
+  {
+    const char *header = m_buffer.constData() + offset;
+    if (QByteArrayView(header, ipcMagic.size()) != QByteArrayView(ipcMagic))
+    {
+      WTM_TRACE("sway", "bad message header");
+      setUnavailable();
+      return;
+    }
+
+    const quint32 length = qFromUnaligned<quint32>(header + 6);
+    const quint32 type = qFromUnaligned<quint32>(header + 10);
+    if (m_buffer.size() - offset - headerSize < qsizetype(length))
+      break;
+
+    handleMessage(type, m_buffer.mid(offset + headerSize, length));
+    // A failed message drops the connection along with the buffer.
+    if (m_socket.state() != QLocalSocket::ConnectedState)
+      return;
+    offset += headerSize + length;
+  }
+  m_buffer.remove(0, offset);
+}
+
+void SwayClient::onDisconnected()
+{
+  WTM_TRACE("sway", "disconnected");
+  setUnavailable();
+}
+
+void SwayClient::onErrorOccurred(QLocalSocket::LocalSocketError error)
+{
+  WTM_TRACE("sway", "socket error %d: %s", static_cast<int>(error), qPrintable(m_socket.errorString()));
+  setUnavailable();
+}
+
+void SwayClient::reconnect()
+{
+  WTM_TRACE("sway", "reconnecting");
+  m_socket.connectToServer(m_socketPath);
+}
+
+void SwayClient::send(quint32 type, const QByteArray &payload)
+{
+  QByteArray message(headerSize, Qt::Uninitialized);
+  std::copy(ipcMagic.cbegin(), ipcMagic.cend(), message.begin());
+  qToUnaligned<quint32>(payload.size(), message.data() + 6);
+  qToUnaligned<quint32>(type, message.data() + 10);
+  message.append(payload);
+  m_socket.write(message);
+}
+
+void SwayClient::requestTree()
+{
+  if (m_treePending)
+    return;
+  m_treePending = true;
+  send(getTreeMessage, QByteArray());
+}
+
+void SwayClient::handleMessage(quint32 type, const QByteArray &payload)
+{
+  const QJsonObject object = QJsonDocument::fromJson(payload).object();
+  switch (type)
+  {
+  case subscribeMessage:
+    if (!object.value(QLatin1String("success")).toBool())
+    {
+      WTM_TRACE("sway", "subscribe failed");
+      setUnavailable();
+    }
+    break;
+  case getTreeMessage:
+    m_treePending = false;
+    applyTree(object);
+    break;
+  case windowEvent:
+    applyWindowEvent(object);
+    break;
+  case workspaceEvent:
+    // Switching workspaces changes the visibility of every window on them.
+    requestTree();
+    break;
+  default:
+    break;
+  }
+}
+
+void SwayClient::applyTree(const QJsonObject &root)
+{
+  QHash<qint64, Window> windows;
+  QVector<QJsonObject> pending{root};
+  while (!pending.isEmpty())
+  {
+    const QJsonObject node = pending.takeLast();
+    qint64 id = 0;
+    Window window;
+    if (windowFromNode(node, id, window.appId, window.visible))
+      windows.insert(id, window);
+
+    for (const char *key : {"nodes", "floating_nodes"})
+    {
+      for (const QJsonValue &child : node.value(QLatin1String(key)).toArray())
+        pending.append(child.toObject());
+    }
+  }
+
+  {
+    QMutexLocker locker(&m_mutex);
+    m_windowsById = std::move(windows);
+    markChanged();
+  }
+  m_state = Ready;
+  m_retryIntervalMs = initialRetryIntervalMs;
+  WTM_TRACE("sway", "tree with %lld windows", static_cast<long long>(m_windowsById.size()));
+}
+
+void SwayClient::applyWindowEvent(const QJsonObject &event)
+{
+  const QString change = event.value(QLatin1String("change")).toString();
+  const QJsonObject container = event.value(QLatin1String("container")).toObject();
+  WTM_TRACE("sway", "window event %s", qPrintable(change));
+
+  // A move can take a window to or from a visible workspace, which the event does not tell.
+  if (change == QLatin1String("move"))
+  {
+    requestTree();
+    return;
+  }
+
+  QMutexLocker locker(&m_mutex);
+  if (change == QLatin1String("close"))
+  {
+    if (m_windowsById.remove(container.value(QLatin1String("id")).toInteger()) > 0)
+      markChanged();
+    return;
+  }
+
+  qint64 id = 0;
+  Window window;
+  if (!windowFromNode(container, id, window.appId, window.visible))
+    return;
+
+  const auto it = m_windowsById.constFind(id);
+  if (it != m_windowsById.cend() && it->appId == window.appId && it->visible == window.visible)
+    return;
+  m_windowsById.insert(id, window);
+  markChanged();
+}
+
+void SwayClient::setUnavailable()
+{
+  // A failure is reported both as an error and as a disconnect, and aborting the socket reports
+  // the disconnect again; only the first of them schedules a retry.
+  m_socket.abort();
+  m_buffer.clear();
+  m_treePending = false;
+  if (!m_retryTimer.isActive())
+  {
+    m_retryTimer.start(m_retryIntervalMs);
+    m_retryIntervalMs = qMin(m_retryIntervalMs * 2, maxRetryIntervalMs);
+  }
+
+  if (m_state.exchange(Unavailable) == Unavailable)
+    return;
+  QMutexLocker locker(&m_mutex);
+  m_windowsById.clear();
+  markChanged();
+}
+
+void SwayClient::markChanged()
+{
+  m_applicationsDirty = true;
+  ++m_generation;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <atomic>
+
+// Keeps the windows of a Sway session up to date over its IPC socket instead of running
+// swaymsg. The tree is fetched once and then patched from window events; workspace events and
+// moves refetch it, since they change which windows are visible. Nothing is done while no
+// window changes. A lost or refused connection is retried with a growing delay, so a restarted
+// compositor is picked up again. The socket path is passed in so that the client can be pointed
+// at a test server instead of $SWAYSOCK.
+class SwayClient : public QObject
+{
+  Q_OBJECT
+
+public:
+  enum State
+  {
+    Connecting,
+    Ready,
+    Unavailable
+  };
+
+  // Has to be created on a thread that runs an event loop; the socket reports there.
+  explicit SwayClient(const QString &socketPath, QObject *parent = nullptr);
+  ~SwayClient() override;
+
+  // Connecting until the first tree has arrived; Unavailable while the socket cannot be used,
+  // and Ready again once a reconnect has fetched a tree.
+  State state() const;
+  // Bumped on every change to the set of visible windows; only meaningful once ready.
+  quint64 generation() const;
+  // Thread-safe; application ids of the visible windows, sorted and without duplicates.
+  QStringList applications() const;
+
+private slots:
+  void onConnected();
+  void onReadyRead();
+  void onDisconnected();
+  void onErrorOccurred(QLocalSocket::LocalSocketError error);
+  void reconnect();
+
+private:
+  struct Window
+  {
+    QString appId;
+    bool visible = false;
+  };
+
+  void send(quint32 type, const QByteArray &payload);
+  void requestTree();
+  void handleMessage(quint32 type, const QByteArray &payload);
+  void applyTree(const QJsonObject &root);
+  void applyWindowEvent(const QJsonObject &event);
+  void setUnavailable();
+  void markChanged();
+
+  QString m_socketPath;
+  QLocalSocket m_socket;
+  QTimer m_retryTimer;
+  int m_retryIntervalMs = 0;
+  // Bytes received but not yet forming a whole message.
+  QByteArray m_buffer;
+  bool m_treePending = false;
+  // Only touched on the thread the client lives on; m_mutex guards it against applications().
+  QHash<qint64, Window> m_windowsById;
+  mutable QMutex m_mutex;
+  mutable QStringList m_applications;
+  mutable bool m_applicationsDirty = true;
+  std::atomic<State> m_state{Connecting};
+  std::atomic<quint64> m_generation{0};
+};
@@ -1,662 +1,482 @@
 #include "systemdataprovider.h"
+#include "instrumentation.h"
 #include "helperutils.h"
-
-#include <QDebug>
-#include <QDir>
+#include "procparser.h"
+#include "openrcclient.h"
+#include "procsnapshot.h"
+#include "swayclient.h"
+#include "systemdclient.h"
+#include "trace.h"
+#include "unixsockets.h"
+#include "x11client.h"
+
+#include <QDBusConnection>
 #include <QFile>
 #include <QFileInfo>
-#include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QProcess>
-#include <QProcessEnvironment>
+#include <QMutexLocker>
 #include <QRegularExpression>
 #include <QSet>
 #include <QStandardPaths>
-#include <QTextStream>
 #include <QDateTime>
-#include <functional>
 #include <unistd.h>
-#include <sys/sysinfo.h>
-
-SystemDataProvider::SystemDataProvider()
-{
-  m_currentUser = qgetenv("USER");
-  if (m_currentUser.isEmpty())
-    m_currentUser = qgetenv("LOGNAME");
-}
-
-QString SystemDataProvider::currentUser() const
-{
-  return m_currentUser;
-}
 
-SystemUsage SystemDataProvider::refreshSystemUsage()
+namespace
 {
-  SystemUsage usage = readSystemUsage();
-  usage.totalProcesses = 0;
-
-  QDir procDir("/proc");
-  const QStringList procEntries = procDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
-  for (const QString &entry : procEntries)
-  {
-    if (entry.toInt() > 0)
-      usage.totalProcesses++;
-  }
-
-  return usage;
-}
-
-QList<ProcessInfo> SystemDataProvider::refreshProcessList(bool includeAllUsers)
+// Parses the JSON array printed by `systemctl list-units --output=json` one unit object at a
+// time as the output streams in, instead of buffering the whole document first.
+class SystemctlUnitParser : public StreamParser<QList<ServiceInfo>>
 {
-  QList<ProcessInfo> processList;
-  QDir procDir("/proc");
-  const QFileInfoList procEntries = procDir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
-
-  const long pageSizeKb = sysconf(_SC_PAGESIZE) / 1024;
-  const long ticksPerSec = sysconf(_SC_CLK_TCK);
-  const int numCores = sysconf(_SC_NPROCESSORS_ONLN);
-
-  QFile uptimeFile("/proc/uptime");
-  double uptimeSeconds = 0.0;
-  if (uptimeFile.open(QIODevice::ReadOnly))
-  {
-    QTextStream uptimeStream(&uptimeFile);
-    uptimeStream >> uptimeSeconds;
-    uptimeFile.close();
-  }
-
-  for (const QFileInfo &entry : procEntries)
+public:
+  void feed(QByteArrayView data) override
   {
-    if (!entry.isDir())
-      continue;
-
-    const int pid = entry.fileName().toInt();
-    if (pid <= 0)
-      continue;
-
-    QFile statFile(entry.filePath() + "/stat");
-    QFile cmdlineFile(entry.filePath() + "/cmdline");
-    QFile statusFile(entry.filePath() + "/status");
-
-    if (!statFile.open(QIODevice::ReadOnly) || !cmdlineFile.open(QIODevice::ReadOnly) || !statusFile.open(QIODevice::ReadOnly))
-      continue;
-
-    const QString stat = QTextStream(&statFile).readAll();
-    const QString cmdline = QTextStream(&cmdlineFile).readAll();
-    const QString status = QTextStream(&statusFile).readAll();
-
-    statFile.close();
-    cmdlineFile.close();
-    statusFile.close();
-
-    uid_t uid = 0;
-    for (const QString &line : status.split('\n', Qt::SkipEmptyParts))
+    qsizetype objectStart = m_depth >= 2 ? 0 : -1;
+    for (qsizetype index = 0; index < data.size() && !m_failed; ++index)
     {
-      if (line.startsWith("Uid:"))
+      const char c = data[index];
+      if (m_inString)
+      {
+        if (m_escaped)
+          m_escaped = false;
+        else if (c == '\\')
+          m_escaped = true;
+        else if (c == '"')
+          m_inString = false;
+        continue;
+      }
+
+      switch (c)
       {
-        const QString uidToken = line.mid(4).trimmed();
-        const QStringList uidParts = uidToken.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
-        if (!uidParts.isEmpty())
+      case '"':
+        m_inString = true;
+        break;
+      case '[':
+      case '{':
+        if (m_depth == 0 && c != '[')
+          m_failed = true;
+        else if (m_depth == 1 && c != '{')
+          m_failed = true;
+        if (m_depth == 0)
+          m_sawArray = true;
+        if (m_depth == 1)
+          objectStart = index;
+        ++m_depth;
+        break;
+      case ']':
+      case '}':
+        --m_depth;
+        if (m_depth < 0)
+          m_failed = true;
+        else if (m_depth == 1)
         {
-          bool ok = false;
-          uid = static_cast<uid_t>(uidParts.first().toInt(&ok));
-          if (!ok)
-            uid = 0;
+          m_object.append(data.sliced(objectStart, index + 1 - objectStart));
+          addUnit();
+          objectStart = -1;
         }
         break;
+      default:
+        break;
       }
     }
 
-    const QString user = getUserFromUid(uid);
-    if (!includeAllUsers && user != m_currentUser)
-      continue;
-
-    int begin = stat.indexOf('(');
-    int end = stat.lastIndexOf(')');
-    if (begin < 0 || end < 0 || end <= begin)
-      continue;
-
-    const QStringList statFields = stat.mid(end + 2).split(' ', Qt::SkipEmptyParts);
-    if (statFields.size() < 22)
-      continue;
-
-    const QString commandLine = cmdline.split(QLatin1Char('\0'), Qt::SkipEmptyParts).join(' ').trimmed();
-    const QString statName = stat.mid(begin + 1, end - begin - 1);
-    const QString name = commandLine.isEmpty() ? statName : commandLine;
-
-    const long utime = statFields[11].toLong();
-    const long stime = statFields[12].toLong();
-    const long starttime = statFields[19].toLong();
-    const long rssPages = statFields[21].toLong();
-    const double totalCpuTime = static_cast<double>(utime + stime);
-    const double processSeconds = uptimeSeconds - (static_cast<double>(starttime) / ticksPerSec);
+    if (objectStart >= 0 && !m_failed)
+      m_object.append(data.sliced(objectStart));
+  }
 
-    double cpuPercent = 0.0;
-    if (processSeconds > 0.0)
-    {
-      const double previousCpu = m_previousProcessCpu.value(pid, 0);
-      const double previousTime = m_previousProcessTime.value(pid, 0.0);
-      const double deltaCpu = totalCpuTime - previousCpu;
-      const double deltaTime = processSeconds - previousTime;
-      if (deltaTime > 0.0 && deltaCpu > 0.0)
-        cpuPercent = (deltaCpu / ticksPerSec) / deltaTime * 100.0 / qMax(1, numCores);
-    }
+  bool finish(QList<ServiceInfo> &result) override
+  {
+    if (m_failed || !m_sawArray || m_depth != 0)
+      return false;
+    result = std::move(m_services);
+    return true;
+  }
 
-    m_previousProcessCpu[pid] = static_cast<qint64>(totalCpuTime);
-    m_previousProcessTime[pid] = processSeconds;
+private:
+  void addUnit()
+  {
+    const QJsonObject serviceObject = QJsonDocument::fromJson(m_object).object();
+    m_object.clear();
 
-    ProcessInfo info;
-    info.pid = pid;
-    info.name = name.isEmpty() ? statName : name;
-    info.user = user;
-    info.cpuPercent = cpuPercent;
-    info.memoryKb = static_cast<double>(rssPages) * pageSizeKb;
-    processList.append(info);
+    ServiceInfo service;
+    service.name = serviceObject.value("unit").toString();
+    service.pid = serviceObject.contains("mainPID") ? QString::number(serviceObject.value("mainPID").toInt()) : "-";
+    service.description = serviceObject.value("description").toString();
+    service.state = serviceObject.value("active").toString();
+    service.scope = QStringLiteral("user");
+    m_services.append(service);
   }
 
-  return processList;
-}
+  QList<ServiceInfo> m_services;
+  QByteArray m_object;
+  int m_depth = 0;
+  bool m_inString = false;
+  bool m_escaped = false;
+  bool m_sawArray = false;
+  bool m_failed = false;
+};
 
-static QString findOpenRCPidFromPidFiles(const QString &serviceName)
+class OpenRCStatusParser : public StreamParser<QList<ServiceInfo>>
 {
-  static const QStringList pidLocations = {
-      QStringLiteral("/run/%1.pid"),
-      QStringLiteral("/var/run/%1.pid"),
-      QStringLiteral("/run/%1/%1.pid"),
-      QStringLiteral("/var/run/%1/%1.pid")};
-
-  for (const QString &templatePath : pidLocations)
+public:
+  void feed(QByteArrayView data) override
   {
-    const QString path = templatePath.arg(serviceName);
-    QFile pidFile(path);
-    if (!pidFile.exists() || !pidFile.open(QIODevice::ReadOnly | QIODevice::Text))
-      continue;
-
-    const QString pidLine = QString::fromUtf8(pidFile.readLine()).trimmed();
-    const int pid = pidLine.toInt();
-    if (pid > 0)
-      return QString::number(pid);
+    m_lines.feed(data, [this](QByteArrayView line)
+                 { parseLine(line); });
   }
 
-  return QStringLiteral("-");
-}
-
-static QList<ServiceInfo> parseOpenRCServices(const QByteArray &output)
-{
-  QList<ServiceInfo> services;
-  const QStringList lines = QString::fromUtf8(output).split('\n', Qt::SkipEmptyParts);
-  const QRegularExpression serviceLineRegex(R"(^\s*([^\s\[]+)\s+\[\s*([^\]]+)\s*\])");
+  bool finish(QList<ServiceInfo> &result) override
+  {
+    m_lines.flush([this](QByteArrayView line)
+                  { parseLine(line); });
+    result = std::move(m_services);
+    return true;
+  }
 
-  for (const QString &line : lines)
+private:
+  void parseLine(QByteArrayView line)
   {
-    const QRegularExpressionMatch match = serviceLineRegex.match(line);
+    static const QRegularExpression serviceLineRegex(R"(^\s*([^\s\[]+)\s+\[\s*([^\]]+)\s*\])");
+    const QRegularExpressionMatch match = serviceLineRegex.match(QString::fromUtf8(line));
     if (!match.hasMatch())
-      continue;
+      return;
 
     ServiceInfo service;
     service.name = match.captured(1);
     service.state = match.captured(2).trimmed();
     service.description = QString();
-    service.pid = service.state.compare(QStringLiteral("started"), Qt::CaseInsensitive) == 0 ? findOpenRCPidFromPidFiles(service.name) : QStringLiteral("-");
-    services.append(service);
+    service.pid = service.state.compare(QStringLiteral("started"), Qt::CaseInsensitive) == 0 ? OpenRCClient::readPid(OpenRCClient::findPidFile(service.name)) : QStringLiteral("-");
+    service.scope = QStringLiteral("system");
+    m_services.append(service);
   }
 
-  return services;
-}
+  LineSplitter m_lines;
+  QList<ServiceInfo> m_services;
+};
 
-QList<ServiceInfo> SystemDataProvider::refreshServices()
+CommandExecutor::Command commandFor(const QString &program, const QStringList &arguments, int timeoutMs)
 {
-  QList<ServiceInfo> services;
-  QProcess process;
-  const QString systemctlPath = QStandardPaths::findExecutable("systemctl");
-
-  if (!systemctlPath.isEmpty())
-  {
-    process.setProgram(systemctlPath);
-    process.setArguments({"--user", "list-units", "--type=service", "--all", "--output=json"});
-    process.start();
-    process.waitForFinished();
-
-    const QByteArray output = process.readAllStandardOutput();
-    const QJsonDocument document = QJsonDocument::fromJson(output);
-    if (document.isArray())
-    {
-      for (const QJsonValue &value : document.array())
-      {
-        const QJsonObject serviceObject = value.toObject();
-        ServiceInfo service;
-        service.name = serviceObject.value("unit").toString();
-        service.pid = serviceObject.contains("mainPID") ? QString::number(serviceObject.value("mainPID").toInt()) : "-";
-        service.description = serviceObject.value("description").toString();
-        service.state = serviceObject.value("active").toString();
-        services.append(service);
-      }
+  CommandExecutor::Command command;
+  command.program = QStandardPaths::findExecutable(program);
+  command.arguments = arguments;
+  command.timeoutMs = timeoutMs;
+  return command;
+}
+}
 
-      return services;
-    }
-  }
+static bool isX11Session()
+{
+  const QString displayType = qEnvironmentVariable("XDG_SESSION_TYPE").toLower();
+  return displayType == "x11" || displayType == "xorg";
+}
 
-  const QString rcStatusPath = QStandardPaths::findExecutable("rc-status");
-  if (!rcStatusPath.isEmpty())
-  {
-    process.setProgram(rcStatusPath);
-    process.setArguments({"--all"});
-    process.start();
-    process.waitForFinished();
+SystemDataProvider::SystemDataProvider(const QByteArray &procRoot)
+    : m_sampler(procRoot),
+      m_systemctlQuery(m_commandExecutor, commandFor("systemctl", {"--user", "list-units", "--type=service", "--all", "--output=json"}, 5000), []()
+                       { return std::make_unique<SystemctlUnitParser>(); }),
+      m_rcStatusQuery(m_commandExecutor, commandFor("rc-status", {"--all"}, 5000), []()
+                      { return std::make_unique<OpenRCStatusParser>(); })
+{
+  m_systemctlAvailable = !QStandardPaths::findExecutable("systemctl").isEmpty();
+  m_rcStatusAvailable = !QStandardPaths::findExecutable("rc-status").isEmpty();
+  if (procRoot == "/proc")
+    m_applicationsState.addSocketPeers = addKernelUnixSocketPeers;
+  m_userSystemd = std::make_unique<SystemdClient>(QDBusConnection::sessionBus(), QStringLiteral("user"));
+  m_systemSystemd = std::make_unique<SystemdClient>(QDBusConnection::systemBus(), QStringLiteral("system"));
+  m_openRC = std::make_unique<OpenRCClient>();
+  m_sway = std::make_unique<SwayClient>(qEnvironmentVariable("SWAYSOCK"));
+  if (isX11Session())
+    m_x11 = std::make_unique<X11Client>();
+}
 
-    if (process.exitStatus() == QProcess::NormalExit)
-    {
-      services = parseOpenRCServices(process.readAllStandardOutput());
-      return services;
-    }
-  }
+SystemDataProvider::~SystemDataProvider() = default;
 
-  return services;
+QString SystemDataProvider::currentUser() const
+{
+  return m_sampler.currentUser();
 }
 
-static bool isExcludedWaylandClient(const QString &name)
+ProcFileCacheStats SystemDataProvider::procFileCacheStats() const
 {
-  static const QSet<QString> excluded = {
-      "xwayland", "wayland", "gnome-shell", "kwin_wayland", "plasmashell",
-      "sway", "weston", "waybar", "pipewire", "wireplumber",
-      "xdg-desktop-portal", "xdg-desktop-portal-wlr", "dbus-daemon",
-      "systemd", "bash", "sh", "zsh", "fish", "login", "loginctl",
-      "gnome-session", "ksmserver", "kded5", "autostart"};
-  return excluded.contains(name.toLower());
+  return m_sampler.procFileCacheStats();
 }
 
-static bool hasOpenWaylandSocket(int pid)
+void SystemDataProvider::setScanThreadCount(int count)
 {
-  const QString fdDirPath = QStringLiteral("/proc/%1/fd").arg(pid);
-  QDir fdDir(fdDirPath);
-  if (!fdDir.exists())
-    return false;
+  m_sampler.setScanThreadCount(count);
+}
 
-  const QFileInfoList fdEntries = fdDir.entryInfoList(QDir::NoDotAndDotDot | QDir::AllEntries);
-  for (const QFileInfo &fdEntry : fdEntries)
-  {
-    const QString target = QFile::symLinkTarget(fdEntry.filePath());
-    if (target.contains(QStringLiteral("wayland-"), Qt::CaseInsensitive))
-      return true;
-    if (target.contains(QStringLiteral("/run/user/"), Qt::CaseInsensitive) && target.contains(QStringLiteral("wayland"), Qt::CaseInsensitive))
-      return true;
-  }
+int SystemDataProvider::scanThreadCount() const
+{
+  return m_sampler.scanThreadCount();
+}
 
-  return false;
+void SystemDataProvider::setUnixSocketPeerLookup(UnixSocketPeerLookup lookup)
+{
+  QMutexLocker locker(&m_applicationsState.mutex);
+  m_applicationsState.addSocketPeers = std::move(lookup);
 }
 
-static QStringList collectSwayApplications()
+bool SystemDataProvider::usesGenericWaylandDetection() const
 {
-  QProcess process;
-  process.setProgram("swaymsg");
-  process.setArguments({"-t", "get_tree"});
-  process.start();
-  if (!process.waitForFinished(1000))
-    return {};
+  const QString displayType = qEnvironmentVariable("XDG_SESSION_TYPE").toLower();
+  const bool isWayland = displayType == "wayland" || !qEnvironmentVariable("WAYLAND_DISPLAY").isEmpty();
+  return !isX11Session() && isWayland && m_sway->state() == SwayClient::Unavailable;
+}
 
-  const QJsonDocument document = QJsonDocument::fromJson(process.readAllStandardOutput());
-  if (!document.isObject())
-    return {};
+static const ProcSnapshot::Fields waylandApplicationFields = ProcSnapshot::Stat | ProcSnapshot::Status | ProcSnapshot::Cmdline | ProcSnapshot::Environ;
 
-  QStringList applications;
-  const std::function<void(const QJsonObject &)> scanNode = [&](const QJsonObject &node)
-  {
-    const QString type = node.value("type").toString();
-    const bool visible = node.value("visible").toBool();
-    const bool hasWindow = !node.value("window").isNull();
+void SystemDataProvider::beginTick(bool includeProcesses, bool includeApplications)
+{
+  ProcSnapshot::Fields fields;
+  if (includeProcesses)
+    fields |= SystemSampler::processListFields();
+  if (includeApplications && usesGenericWaylandDetection())
+    fields |= waylandApplicationFields;
 
-    if ((type == "con" || type == "floating_con") && hasWindow && visible)
-    {
-      const QJsonObject properties = node.value("window_properties").toObject();
-      QString appId = properties.value("class").toString();
-      if (appId.isEmpty())
-        appId = properties.value("instance").toString();
-      if (appId.isEmpty())
-        appId = node.value("app_id").toString();
-      if (appId.isEmpty())
-        appId = node.value("name").toString();
-
-      if (!appId.isEmpty() && !isExcludedWaylandClient(appId))
-        applications.append(appId);
-    }
+  m_sampler.beginTick(fields);
+}
 
-    for (const QJsonValue &child : node.value("nodes").toArray())
-      scanNode(child.toObject());
-    for (const QJsonValue &child : node.value("floating_nodes").toArray())
-      scanNode(child.toObject());
-  };
+SystemUsage SystemDataProvider::refreshSystemUsage()
+{
+  return m_sampler.refreshSystemUsage();
+}
 
-  scanNode(document.object());
-  applications.removeDuplicates();
-  applications.sort();
-  return applications;
+QList<ProcessInfo> SystemDataProvider::refreshProcessList(bool includeAllUsers)
+{
+  return m_sampler.refreshProcessList(includeAllUsers);
 }
 
-static QStringList collectGenericWaylandApplications(const QString &currentUser)
+QList<ServiceInfo> SystemDataProvider::refreshServices()
 {
-  const uid_t currentUid = geteuid();
-  QStringList applications;
-  QDir procDir("/proc");
-  const QFileInfoList procEntries = procDir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+  Instrumentation::StageTimer stageTimer(Instrumentation::ServiceCollector);
 
-  for (const QFileInfo &entry : procEntries)
+  // The D-Bus clients keep their lists current from systemd's change signals, so this is only a
+  // copy of what they already hold.
+  const SystemdClient::State userState = m_userSystemd->state();
+  const SystemdClient::State systemState = m_systemSystemd->state();
+  if (userState == SystemdClient::Ready || systemState == SystemdClient::Ready)
   {
-    const int pid = entry.fileName().toInt();
-    if (pid <= 0)
-      continue;
-
-    QFile environFile(entry.filePath() + "/environ");
-    if (!environFile.open(QIODevice::ReadOnly))
-    {
-      qDebug() << "cannot open environ for" << pid << environFile.errorString();
-      continue;
-    }
-
-    const QByteArray envData = environFile.readAll();
-    environFile.close();
-    if (!envData.contains("WAYLAND_DISPLAY=") && !envData.contains("WAYLAND_SOCKET="))
-      continue;
-
-    if (!hasOpenWaylandSocket(pid))
-    {
-      qDebug() << "pid" << pid << "has no open Wayland socket";
-      continue;
-    }
-
-    qDebug() << "wayland candidate pid" << pid << "env contains" << envData.contains("WAYLAND_DISPLAY=") << envData.contains("WAYLAND_SOCKET=");
-
-    QFile statusFile(entry.filePath() + "/status");
-    if (!statusFile.open(QIODevice::ReadOnly))
-    {
-      qDebug() << "cannot open status for" << pid << statusFile.errorString();
-      continue;
-    }
-
-    const QByteArray statusData = statusFile.readAll();
-    statusFile.close();
-
-    uid_t ownerUid = 0;
-    const QStringList statusLines = QString::fromLocal8Bit(statusData).split('\n', Qt::SkipEmptyParts);
-    for (const QString &line : statusLines)
-    {
-      if (line.startsWith("Uid:"))
-      {
-        const QStringList uidParts = line.mid(4).trimmed().split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
-        if (!uidParts.isEmpty())
-          ownerUid = static_cast<uid_t>(uidParts.first().toInt());
-        break;
-      }
-    }
+    QList<ServiceInfo> services;
+    if (userState == SystemdClient::Ready)
+      services = m_userSystemd->services();
+    if (systemState == SystemdClient::Ready)
+      services += m_systemSystemd->services();
+    return services;
+  }
+  if (userState == SystemdClient::Connecting || systemState == SystemdClient::Connecting)
+    return {};
 
-    if (ownerUid != currentUid)
-    {
-      qDebug() << "pid" << pid << "skipping ownerUid" << ownerUid << "currentUid" << currentUid;
-      continue;
-    }
+  if (usesOpenRC())
+    return m_openRC->services();
 
-    QString appName;
-    QFile cmdlineFile(entry.filePath() + "/cmdline");
-    if (cmdlineFile.open(QIODevice::ReadOnly))
-    {
-      const QByteArray cmdlineData = cmdlineFile.readAll();
-      cmdlineFile.close();
-      const QStringList parts = QString::fromLocal8Bit(cmdlineData).split(QLatin1Char('\0'), Qt::SkipEmptyParts);
-      qDebug() << "pid" << pid << "cmdline raw" << cmdlineData << "parts" << parts;
-      if (!parts.isEmpty())
-        appName = QFileInfo(parts.first()).fileName();
-    }
+  // Otherwise fall back to the command line tools. While a query is running the last good list
+  // is returned, and nothing before the first one completes, so a slow or hung service manager
+  // delays the tab instead of blocking this thread.
+  bool hasResult = false;
+  if (m_systemctlAvailable)
+  {
+    const QList<ServiceInfo> services = m_systemctlQuery.latest(&hasResult);
+    if (hasResult)
+      return services;
+    // rc-status is only the fallback for a systemctl that has answered and failed.
+    if (!m_systemctlQuery.hasCompleted())
+      return {};
+  }
 
-    if (appName.isEmpty())
-    {
-      QFile commFile(entry.filePath() + "/comm");
-      if (commFile.open(QIODevice::ReadOnly))
-      {
-        appName = QString::fromLocal8Bit(commFile.readAll()).trimmed();
-        commFile.close();
-        qDebug() << "pid" << pid << "comm name" << appName;
-      }
-    }
+  if (m_rcStatusAvailable)
+  {
+    const QList<ServiceInfo> services = m_rcStatusQuery.latest(&hasResult);
+    if (hasResult)
+      return services;
+  }
 
-    qDebug() << "pid" << pid << "appName" << appName;
-    if (appName.isEmpty())
-      continue;
+  return {};
+}
 
-    if (isExcludedWaylandClient(appName))
-    {
-      qDebug() << "pid" << pid << "excluded" << appName;
+quint64 SystemDataProvider::servicesGeneration() const
+{
+  // Each client's generation only grows and jumps when it becomes ready, so the sum changes
+  // whenever either list does.
+  quint64 generation = 0;
+  bool anyReady = false;
+  for (const SystemdClient *client : {m_userSystemd.get(), m_systemSystemd.get()})
+  {
+    if (client->state() != SystemdClient::Ready)
       continue;
-    }
-
-    applications.append(appName);
+    generation += client->generation();
+    anyReady = true;
   }
+  if (anyReady)
+    return generation;
+  return usesOpenRC() ? m_openRC->generation() : 0;
+}
 
-  applications.removeDuplicates();
-  applications.sort();
-  qDebug() << "collectWaylandApplications found" << applications.size() << "apps";
-  return applications;
+quint64 SystemDataProvider::applicationsGeneration() const
+{
+  if (m_x11)
+    return m_x11->state() == X11Client::Ready ? m_x11->generation() : 0;
+  return m_sway->state() == SwayClient::Ready ? m_sway->generation() : 0;
 }
 
-static QStringList collectWaylandApplications(const QString &currentUser)
+bool SystemDataProvider::usesOpenRC() const
 {
-  if (!qEnvironmentVariable("SWAYSOCK").isEmpty())
-    return collectSwayApplications();
+  return m_userSystemd->state() == SystemdClient::Unavailable && m_systemSystemd->state() == SystemdClient::Unavailable && m_openRC->isAvailable();
+}
 
-  return collectGenericWaylandApplications(currentUser);
+static bool isExcludedWaylandClient(const QString &name)
+{
+  static const QSet<QString> excluded = {
+      "xwayland", "wayland", "gnome-shell", "kwin_wayland", "plasmashell",
+      "sway", "weston", "waybar", "pipewire", "wireplumber",
+      "xdg-desktop-portal", "xdg-desktop-portal-wlr", "dbus-daemon",
+      "systemd", "bash", "sh", "zsh", "fish", "login", "loginctl",
+      "gnome-session", "ksmserver", "kded5", "autostart"};
+  return excluded.contains(name.toLower());
 }
 
-QStringList SystemDataProvider::refreshApplications()
+QStringList SystemDataProvider::collectGenericWaylandApplications(const ProcSnapshot &snapshot)
 {
-  const QString displayType = qEnvironmentVariable("XDG_SESSION_TYPE").toLower();
-  const bool isWayland = displayType == "wayland" || !qEnvironmentVariable("WAYLAND_DISPLAY").isEmpty();
-  const bool isX11 = displayType == "x11" || displayType == "xorg";
+  const uid_t currentUid = geteuid();
+  QStringList applications;
+
+  QMutexLocker locker(&m_applicationsState.mutex);
+  ApplicationsState &state = m_applicationsState;
+  QSet<quint64> sockets;
+  readWaylandSocketInodes(m_sampler.procRoot(), state.unixSocketBuffer, sockets, state.addSocketPeers);
 
-  if (isX11)
+  // A process can only have gained a Wayland connection if a socket appeared since its verdict,
+  // and only lost one if a socket went away, so verdicts are kept until that happens.
+  ++state.epoch;
+  for (const quint64 inode : std::as_const(sockets))
   {
-    QStringList applications;
-    QProcess process;
-    process.setProcessEnvironment(QProcessEnvironment::systemEnvironment());
-    process.start("bash", QStringList() << "-lc" << R"(xlsclients | awk '{print $2}' | sort -u)");
-    process.waitForFinished();
-    const QString output = QString::fromLocal8Bit(process.readAllStandardOutput());
-    for (const QString &line : output.split('\n', Qt::SkipEmptyParts))
-      applications.append(line.trimmed());
-    applications.removeDuplicates();
-    applications.sort();
-    return applications;
+    if (!state.waylandSockets.contains(inode))
+    {
+      state.socketsAddedEpoch = state.epoch;
+      break;
+    }
   }
-  else if (isWayland)
+  for (const quint64 inode : std::as_const(state.waylandSockets))
   {
-    return collectWaylandApplications(m_currentUser);
+    if (!sockets.contains(inode))
+    {
+      state.socketsRemovedEpoch = state.epoch;
+      break;
+    }
   }
+  state.waylandSockets = std::move(sockets);
+  state.verdicts.beginScan();
 
-  return QStringList{"Unknown display server"};
-}
-
-SystemUsage SystemDataProvider::readSystemUsage()
-{
-  SystemUsage usage;
-
-  QFile cpuFile("/proc/stat");
-  if (cpuFile.open(QIODevice::ReadOnly | QIODevice::Text))
+  for (const ProcSnapshot::Shard &shard : snapshot.shards)
   {
-    QTextStream stream(&cpuFile);
-    QString line;
-    int index = 0;
-    while (!stream.atEnd())
+    for (const ProcSnapshot::Entry &entry : shard.entries)
     {
-      line = stream.readLine().trimmed();
-      if (!line.startsWith("cpu"))
-        break;
-
-      const QStringList parts = line.split(' ', Qt::SkipEmptyParts);
-      if (parts.size() < 5)
+      const int pid = entry.pid;
+      if (!entry.has(ProcSnapshot::Environ))
+      {
+        WTM_TRACE("wayland", "pid %d: cannot open environ", pid);
         continue;
+      }
 
-      const qint64 user = parts[1].toLongLong();
-      const qint64 nice = parts[2].toLongLong();
-      const qint64 system = parts[3].toLongLong();
-      const qint64 idle = parts[4].toLongLong();
-      const qint64 iowait = parts.size() > 5 ? parts[5].toLongLong() : 0;
-      const qint64 irq = parts.size() > 6 ? parts[6].toLongLong() : 0;
-      const qint64 softirq = parts.size() > 7 ? parts[7].toLongLong() : 0;
-      const qint64 steal = parts.size() > 8 ? parts[8].toLongLong() : 0;
-
-      const qint64 total = user + nice + system + idle + iowait + irq + softirq + steal;
-      const qint64 used = total - idle;
+      if (!entry.waylandEnvironment)
+        continue;
 
-      if (m_previousCpuTotals.size() != index + 1)
+      if (!entry.has(ProcSnapshot::Status))
       {
-        m_previousCpuTotals.resize(index + 1);
-        m_previousCpuIdles.resize(index + 1);
-        m_previousCpuTotals[index] = 0;
-        m_previousCpuIdles[index] = 0;
+        WTM_TRACE("wayland", "pid %d: cannot open status", pid);
+        continue;
       }
 
-      if (m_previousCpuTotals[index] > 0 && total > m_previousCpuTotals[index])
+      if (entry.uid != currentUid)
       {
-        const qint64 deltaTotal = total - m_previousCpuTotals[index];
-        const qint64 deltaIdle = idle - m_previousCpuIdles[index];
-        const int usageValue = static_cast<int>((deltaTotal - deltaIdle) * 100 / deltaTotal);
-        if (index == 0)
-          usage.cpuUsage = usageValue;
-        else
-          usage.coreUsages.append(usageValue);
+        WTM_TRACE("wayland", "pid %d: skipping owner uid %u, current uid %u", pid, entry.uid, currentUid);
+        continue;
       }
-      else if (index > 0)
+
+      if (!entry.has(ProcSnapshot::Cmdline))
       {
-        usage.coreUsages.append(0);
+        WTM_TRACE("wayland", "pid %d: cannot open cmdline", pid);
+        continue;
       }
 
-      m_previousCpuTotals[index] = total;
-      m_previousCpuIdles[index] = idle;
-      index++;
-    }
-
-    usage.coreCount = index > 0 ? index - 1 : 0;
-    cpuFile.close();
-  }
-
-  qint64 memTotal = -1;
-  qint64 memAvailable = -1;
-  qint64 memFree = -1;
-  qint64 buffers = 0;
-  qint64 cached = 0;
-  qint64 sReclaimable = 0;
-  qint64 shmem = 0;
-
-  QFile memFile("/proc/meminfo");
-  if (memFile.open(QIODevice::ReadOnly | QIODevice::Text))
-  {
-    // Dump raw meminfo content for debugging
-    const QByteArray rawMem = memFile.readAll();
-    memFile.seek(0);
-    QTextStream stream(&memFile);
-    QFile rawDbg("/tmp/wintaskman_meminfo_raw.log");
-    if (rawDbg.open(QIODevice::WriteOnly | QIODevice::Text))
-    {
-      rawDbg.write(rawMem);
-      rawDbg.close();
-    }
+      WaylandClientVerdict &verdict = state.verdicts.mark({pid, entry.starttime});
+      const quint64 staleBefore = verdict.connected ? state.socketsRemovedEpoch : state.socketsAddedEpoch;
+      if (verdict.epoch == 0 || verdict.epoch < staleBefore)
+      {
+        verdict.connected = hasSocketInode(m_sampler.procRoot(), pid, state.waylandSockets);
+        verdict.epoch = state.epoch;
+      }
 
-    while (!stream.atEnd())
-    {
-      const QString line = stream.readLine().trimmed();
-      const QStringList fields = line.split(':', Qt::SkipEmptyParts);
-      if (fields.size() < 2)
+      if (!verdict.connected)
+      {
+        WTM_TRACE("wayland", "pid %d: no open Wayland socket", pid);
         continue;
+      }
 
-      const QString key = fields[0].trimmed();
-      const QStringList tokens = fields[1].trimmed().split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
-      const qint64 value = tokens.value(0).toLongLong();
-
-      if (key == QLatin1String("MemTotal"))
-        memTotal = value;
-      else if (key == QLatin1String("MemAvailable"))
-        memAvailable = value;
-      else if (key == QLatin1String("MemFree"))
-        memFree = value;
-      else if (key == QLatin1String("Buffers"))
-        buffers = value;
-      else if (key == QLatin1String("Cached"))
-        cached = value;
-      else if (key == QLatin1String("SReclaimable"))
-        sReclaimable = value;
-      else if (key == QLatin1String("Shmem"))
-        shmem = value;
-
-      if (memTotal > 0 && memAvailable > 0)
-        break;
-    }
-    memFile.close();
-
-    qDebug() << "meminfo parsed:" << "MemTotal=" << memTotal << "MemAvailable=" << memAvailable
-             << "MemFree=" << memFree << "Buffers=" << buffers << "Cached=" << cached
-             << "SReclaimable=" << sReclaimable << "Shmem=" << shmem;
-    QFile dbgFile("/tmp/wintaskman_meminfo_debug.log");
-    if (dbgFile.open(QIODevice::Append | QIODevice::Text))
-    {
-      QTextStream ts(&dbgFile);
-      ts << "meminfo parsed: MemTotal=" << memTotal << " MemAvailable=" << memAvailable
-         << " MemFree=" << memFree << " Buffers=" << buffers << " Cached=" << cached
-         << " SReclaimable=" << sReclaimable << " Shmem=" << shmem << "\n";
-      dbgFile.close();
-    }
-
-    if (memTotal <= 0)
-    {
-      const long pageSizeKb = sysconf(_SC_PAGESIZE) / 1024;
-      const long physPages = sysconf(_SC_PHYS_PAGES);
-      if (pageSizeKb > 0 && physPages > 0)
-        memTotal = static_cast<qint64>(physPages) * pageSizeKb;
-    }
-
-    if (memTotal > 0)
-    {
-      usage.totalRam = memTotal;
-      if (memAvailable > 0)
+      const ProcessIdentity &identity = *entry.identity;
+      QString appName;
+      const QByteArrayView cmdline = identity.cmdline;
+      for (qsizetype begin = 0; begin < cmdline.size();)
       {
-        usage.ramUsage = memTotal - memAvailable;
+        qsizetype end = begin;
+        while (end < cmdline.size() && cmdline[end] != '\0')
+          ++end;
+        if (end > begin)
+        {
+          appName = QFileInfo(QString::fromLocal8Bit(cmdline.sliced(begin, end - begin))).fileName();
+          break;
+        }
+        begin = end + 1;
       }
-      else if (memFree >= 0)
+
+      if (appName.isEmpty())
+        appName = QString::fromLocal8Bit(identity.comm).trimmed();
+      if (appName.isEmpty())
+        continue;
+
+      if (isExcludedWaylandClient(appName))
       {
-        qint64 availableEstimate = memFree + buffers + cached;
-        if (sReclaimable > 0)
-          availableEstimate += sReclaimable;
-        if (shmem > 0)
-          availableEstimate -= shmem;
-        usage.ramUsage = qMax<qint64>(0, memTotal - availableEstimate);
+        WTM_TRACE("wayland", "pid %d: excluded %s", pid, qPrintable(appName));
+        continue;
       }
-    }
 
-    qDebug() << "readSystemUsage:" << usage.totalRam << "kB total," << usage.ramUsage << "kB used";
+      applications.append(appName);
+    }
   }
+  state.verdicts.sweep();
+  locker.unlock();
+
+  applications.removeDuplicates();
+  applications.sort();
+  WTM_TRACE("wayland", "found %lld applications", static_cast<long long>(applications.size()));
+  return applications;
+}
 
-  // Use sysinfo() when available as a reliable source for total/free RAM. Prefer MemAvailable if parsed.
-  struct sysinfo si;
-  if (sysinfo(&si) == 0)
+QStringList SystemDataProvider::refreshApplications()
+{
+  Instrumentation::StageTimer stageTimer(Instrumentation::ApplicationCollector);
+  const QString displayType = qEnvironmentVariable("XDG_SESSION_TYPE").toLower();
+  const bool isWayland = displayType == "wayland" || !qEnvironmentVariable("WAYLAND_DISPLAY").isEmpty();
+
+  // Like the Sway client, the X11 client follows the window manager's client list on its own.
+  if (m_x11)
+    return m_x11->applications();
+  else if (isWayland)
   {
-    const qint64 totalKb_sys = (static_cast<qint64>(si.totalram) * si.mem_unit) / 1024;
-    const qint64 freeKb_sys = (static_cast<qint64>(si.freeram) * si.mem_unit) / 1024;
-    // Ensure totalRam is set
-    if (usage.totalRam <= 0)
-      usage.totalRam = totalKb_sys;
-
-    // Prefer MemAvailable-based usage when available, otherwise use sysinfo values
-    if (memAvailable > 0 && memTotal > 0)
-      usage.ramUsage = memTotal - memAvailable;
-    else
-      usage.ramUsage = qMax<qint64>(0, usage.totalRam - freeKb_sys);
-
-    qDebug() << "sysinfo primary: totalKb" << totalKb_sys << "freeKb" << freeKb_sys << "usedKb" << usage.ramUsage;
-    QFile dbgFile2("/tmp/wintaskman_meminfo_debug.log");
-    if (dbgFile2.open(QIODevice::Append | QIODevice::Text))
+    // The Sway client keeps its window list current from the compositor's events, so this is
+    // only a copy of what it already holds. Without Sway the processes are inspected instead.
+    const SwayClient::State swayState = m_sway->state();
+    if (swayState == SwayClient::Ready)
     {
-      QTextStream ts(&dbgFile2);
-      ts << "sysinfo primary: totalKb=" << totalKb_sys << " freeKb=" << freeKb_sys << " usedKb=" << usage.ramUsage << "\n";
-      dbgFile2.close();
+      QStringList applications = m_sway->applications();
+      applications.removeIf(isExcludedWaylandClient);
+      return applications;
     }
+    if (swayState == SwayClient::Connecting)
+      return {};
+
+    return collectGenericWaylandApplications(*m_sampler.acquireSnapshot(waylandApplicationFields));
   }
 
-  return usage;
+  return QStringList{"Unknown display server"};
 }
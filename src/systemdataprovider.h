@@ -1,18 +1,24 @@
 #pragma once
 
 #include <QList>
-#include <QMap>
 #include <QVector>
 #include <QString>
+#include <QStringList>
+#include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
+#include <memory>
 
-struct ProcessInfo
-{
-  int pid = 0;
-  QString name;
-  QString user;
-  double cpuPercent = 0.0;
-  double memoryKb = 0.0;
-};
+#include "commandexecutor.h"
+#include "procsnapshot.h"
+#include "processtable.h"
+#include "systemsampler.h"
+#include "unixsockets.h"
+
+class OpenRCClient;
+class SwayClient;
+class X11Client;
+class SystemdClient;
 
 struct ServiceInfo
 {
@@ -20,35 +26,80 @@ struct ServiceInfo
   QString pid;
   QString description;
   QString state;
+  // "user" or "system".
+  QString scope;
 };
 
-struct SystemUsage
-{
-  int cpuUsage = 0;
-  qint64 ramUsage = 0;
-  qint64 totalRam = 0;
-  int coreCount = 0;
-  QVector<int> coreUsages;
-  int totalProcesses = 0;
-};
-
+// The desktop side of the collection engine: services and applications on top of the procfs
+// sampling of SystemSampler, which it forwards the usage and process collectors to.
 class SystemDataProvider
 {
 public:
-  SystemDataProvider();
+  // procRoot is where procfs is read from; a fixture tree can be passed instead of /proc.
+  explicit SystemDataProvider(const QByteArray &procRoot = QByteArrayLiteral("/proc"));
+  ~SystemDataProvider();
 
   QString currentUser() const;
+  ProcFileCacheStats procFileCacheStats() const;
+  // Number of threads used to scan /proc; 0 picks QThread::idealThreadCount().
+  void setScanThreadCount(int count);
+  int scanThreadCount() const;
+  // How the Wayland detector finds the client ends of the compositor's sockets. Defaults to the
+  // kernel's sock_diag for /proc and to none for a fixture tree, whose sockets the kernel does
+  // not know. Must be set before the first refresh.
+  void setUnixSocketPeerLookup(UnixSocketPeerLookup lookup);
+  // Announces which collectors will run this tick, so that the first one to capture /proc
+  // reads everything the others need as well.
+  void beginTick(bool includeProcesses, bool includeApplications);
   SystemUsage refreshSystemUsage();
   QList<ProcessInfo> refreshProcessList(bool includeAllUsers);
   QList<ServiceInfo> refreshServices();
+  // Changes whenever the service list may have changed; 0 when that cannot be told without
+  // refreshing.
+  quint64 servicesGeneration() const;
   QStringList refreshApplications();
+  // Changes whenever the application list may have changed; 0 when that cannot be told without
+  // refreshing.
+  quint64 applicationsGeneration() const;
 
 private:
-  QString m_currentUser;
-  QVector<qint64> m_previousCpuTotals;
-  QVector<qint64> m_previousCpuIdles;
-  QMap<int, qint64> m_previousProcessCpu;
-  QMap<int, double> m_previousProcessTime;
+  // Like the sampler's, the application state has its own mutex so that the collectors can run
+  // concurrently.
+  struct WaylandClientVerdict
+  {
+    bool connected = false;
+    // Collector run in which the fds were last scanned; 0 if they never were.
+    quint64 epoch = 0;
+  };
+
+  struct ApplicationsState
+  {
+    QMutex mutex;
+    QByteArray unixSocketBuffer;
+    UnixSocketPeerLookup addSocketPeers;
+    QSet<quint64> waylandSockets;
+    quint64 epoch = 0;
+    quint64 socketsAddedEpoch = 0;
+    quint64 socketsRemovedEpoch = 0;
+    ProcessTable<WaylandClientVerdict> verdicts;
+  };
+
+  SystemSampler m_sampler;
+  ApplicationsState m_applicationsState;
+  std::unique_ptr<SystemdClient> m_userSystemd;
+  std::unique_ptr<SystemdClient> m_systemSystemd;
+  std::unique_ptr<OpenRCClient> m_openRC;
+  std::unique_ptr<SwayClient> m_sway;
+  // Only created in X11 sessions.
+  std::unique_ptr<X11Client> m_x11;
+  // The executor has to outlive the queries that hand it work.
+  CommandExecutor m_commandExecutor;
+  CommandQuery<QList<ServiceInfo>> m_systemctlQuery;
+  CommandQuery<QList<ServiceInfo>> m_rcStatusQuery;
+  bool m_systemctlAvailable = false;
+  bool m_rcStatusAvailable = false;
 
-  SystemUsage readSystemUsage();
+  bool usesOpenRC() const;
+  bool usesGenericWaylandDetection() const;
+  QStringList collectGenericWaylandApplications(const ProcSnapshot &snapshot);
 };
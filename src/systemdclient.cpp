@@ -0,0 +1,245 @@
+#include "systemdclient.h"
+#include "trace.h"
+
+#include <QDBusArgument>
+#include <QDBusPendingReply>
+#include <QDBusVariant>
+#include <QMutexLocker>
+#include <algorithm>
+
+static const QString systemdService = QStringLiteral("org.freedesktop.systemd1");
+static const QString managerPath = QStringLiteral("/org/freedesktop/systemd1");
+static const QString managerInterface = QStringLiteral("org.freedesktop.systemd1.Manager");
+static const QString unitInterface = QStringLiteral("org.freedesktop.systemd1.Unit");
+static const QString serviceInterface = QStringLiteral("org.freedesktop.systemd1.Service");
+static const QString propertiesInterface = QStringLiteral("org.freedesktop.DBus.Properties");
+
+static bool isRunningState(const QString &activeState)
+{
+  return activeState != QLatin1String("inactive") && activeState != QLatin1String("failed");
+}
+
+static QString pidText(uint pid)
+{
+  return pid > 0 ? QString::number(pid) : QStringLiteral("-");
+}
+
+SystemdClient::SystemdClient(const QDBusConnection &connection, const QString &scope, QObject *parent)
+    : QObject(parent), m_connection(connection), m_scope(scope)
+{
+  if (!m_connection.isConnected())
+  {
+    m_state = Unavailable;
+    return;
+  }
+
+  // The signals are connected and Subscribe is sent before ListUnits, so a change cannot slip in
+  // between the listing and the first signal.
+  m_connection.connect(systemdService, managerPath, managerInterface, QStringLiteral("UnitNew"), this, SLOT(onUnitNew(QString, QDBusObjectPath)));
+  m_connection.connect(systemdService, managerPath, managerInterface, QStringLiteral("UnitRemoved"), this, SLOT(onUnitRemoved(QString, QDBusObjectPath)));
+  m_connection.connect(systemdService, QString(), propertiesInterface, QStringLiteral("PropertiesChanged"), this,
+                       SLOT(onPropertiesChanged(QString, QVariantMap, QStringList, QDBusMessage)));
+
+  m_connection.asyncCall(QDBusMessage::createMethodCall(systemdService, managerPath, managerInterface, QStringLiteral("Subscribe")));
+  QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+      m_connection.asyncCall(QDBusMessage::createMethodCall(systemdService, managerPath, managerInterface, QStringLiteral("ListUnits"))), this);
+  connect(watcher, &QDBusPendingCallWatcher::finished, this, &SystemdClient::onListUnitsFinished);
+}
+
+SystemdClient::State SystemdClient::state() const
+{
+  return m_state.load();
+}
+
+quint64 SystemdClient::generation() const
+{
+  return m_generation.load();
+}
+
+QList<ServiceInfo> SystemdClient::services() const
+{
+  QMutexLocker locker(&m_mutex);
+  if (m_servicesDirty)
+  {
+    m_services = m_unitsByPath.values();
+    std::sort(m_services.begin(), m_services.end(), [](const ServiceInfo &left, const ServiceInfo &right)
+              { return left.name < right.name; });
+    m_servicesDirty = false;
+  }
+  return m_services;
+}
+
+void SystemdClient::onListUnitsFinished(QDBusPendingCallWatcher *watcher)
+{
+  watcher->deleteLater();
+  const QDBusMessage reply = watcher->reply();
+  if (reply.type() != QDBusMessage::ReplyMessage || reply.arguments().isEmpty())
+  {
+    WTM_TRACE("systemd", "%s manager unavailable: %s", qPrintable(m_scope), qPrintable(reply.errorMessage()));
+    m_state = Unavailable;
+    return;
+  }
+
+  // a(ssssssouso): name, description, load state, active state, sub state, followed unit,
+  // unit path, job id, job type and job path.
+  QHash<QString, ServiceInfo> units;
+  const QDBusArgument argument = reply.arguments().constFirst().value<QDBusArgument>();
+  argument.beginArray();
+  while (!argument.atEnd())
+  {
+    QString name, description, loadState, activeState, subState, following, jobType;
+    QDBusObjectPath unitPath, jobPath;
+    uint jobId = 0;
+    argument.beginStructure();
+    argument >> name >> description >> loadState >> activeState >> subState >> following >> unitPath >> jobId >> jobType >> jobPath;
+    argument.endStructure();
+
+    if (!name.endsWith(QLatin1String(".service")))
+      continue;
+
+    ServiceInfo service;
+    service.name = name;
+    service.pid = QStringLiteral("-");
+    service.description = description;
+    service.state = activeState;
+    service.scope = m_scope;
+    units.insert(unitPath.path(), service);
+  }
+  argument.endArray();
+
+  // The reply reflects the manager's state after every signal that arrived before it, so it
+  // replaces whatever those signals built up.
+  {
+    QMutexLocker locker(&m_mutex);
+    m_unitsByPath = std::move(units);
+    markChanged();
+  }
+  m_state = Ready;
+  WTM_TRACE("systemd", "%s manager: %lld services", qPrintable(m_scope), static_cast<long long>(m_unitsByPath.size()));
+
+  // ListUnits does not carry the main PID, so it is fetched once for every running service and
+  // kept current from PropertiesChanged afterwards.
+  for (auto it = m_unitsByPath.cbegin(); it != m_unitsByPath.cend(); ++it)
+  {
+    if (isRunningState(it.value().state))
+      requestMainPid(it.key());
+  }
+}
+
+void SystemdClient::onUnitNew(const QString &name, const QDBusObjectPath &path)
+{
+  if (!name.endsWith(QLatin1String(".service")) || m_unitsByPath.contains(path.path()))
+    return;
+
+  ServiceInfo service;
+  service.name = name;
+  service.pid = QStringLiteral("-");
+  service.scope = m_scope;
+  {
+    QMutexLocker locker(&m_mutex);
+    m_unitsByPath.insert(path.path(), service);
+    markChanged();
+  }
+  requestUnitProperties(path.path());
+}
+
+void SystemdClient::onUnitRemoved(const QString &name, const QDBusObjectPath &path)
+{
+  Q_UNUSED(name);
+  QMutexLocker locker(&m_mutex);
+  if (m_unitsByPath.remove(path.path()) > 0)
+    markChanged();
+}
+
+void SystemdClient::onPropertiesChanged(const QString &interface, const QVariantMap &changed, const QStringList &invalidated, const QDBusMessage &message)
+{
+  const QString path = message.path();
+  if (!m_unitsByPath.contains(path))
+    return;
+
+  if (interface == unitInterface)
+  {
+    applyUnitProperties(path, changed);
+    if (invalidated.contains(QLatin1String("ActiveState")) || invalidated.contains(QLatin1String("Description")))
+      requestUnitProperties(path);
+  }
+  else if (interface == serviceInterface)
+  {
+    if (changed.contains(QStringLiteral("MainPID")))
+      setMainPid(path, changed.value(QStringLiteral("MainPID")).toUInt());
+    else if (invalidated.contains(QLatin1String("MainPID")))
+      requestMainPid(path);
+  }
+}
+
+void SystemdClient::requestMainPid(const QString &path)
+{
+  QDBusMessage call = QDBusMessage::createMethodCall(systemdService, path, propertiesInterface, QStringLiteral("Get"));
+  call << serviceInterface << QStringLiteral("MainPID");
+  QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(m_connection.asyncCall(call), this);
+  connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, path](QDBusPendingCallWatcher *watcher)
+          {
+    watcher->deleteLater();
+    const QDBusPendingReply<QDBusVariant> reply = *watcher;
+    if (!reply.isError())
+      setMainPid(path, reply.value().variant().toUInt()); });
+}
+
+void SystemdClient::requestUnitProperties(const QString &path)
+{
+  QDBusMessage call = QDBusMessage::createMethodCall(systemdService, path, propertiesInterface, QStringLiteral("GetAll"));
+  call << unitInterface;
+  QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(m_connection.asyncCall(call), this);
+  connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, path](QDBusPendingCallWatcher *watcher)
+          {
+    watcher->deleteLater();
+    const QDBusPendingReply<QVariantMap> reply = *watcher;
+    if (reply.isError())
+      return;
+    applyUnitProperties(path, reply.value());
+    if (isRunningState(reply.value().value(QStringLiteral("ActiveState")).toString()))
+      requestMainPid(path); });
+}
+
+void SystemdClient::applyUnitProperties(const QString &path, const QVariantMap &properties)
+{
+  QMutexLocker locker(&m_mutex);
+  const auto it = m_unitsByPath.find(path);
+  if (it == m_unitsByPath.end())
+    return;
+
+  bool changed = false;
+  const auto description = properties.constFind(QStringLiteral("Description"));
+  if (description != properties.cend() && description->toString() != it->description)
+  {
+    it->description = description->toString();
+    changed = true;
+  }
+  const auto activeState = properties.constFind(QStringLiteral("ActiveState"));
+  if (activeState != properties.cend() && activeState->toString() != it->state)
+  {
+    it->state = activeState->toString();
+    changed = true;
+  }
+
+  if (changed)
+    markChanged();
+}
+
+void SystemdClient::setMainPid(const QString &path, uint pid)
+{
+  QMutexLocker locker(&m_mutex);
+  const auto it = m_unitsByPath.find(path);
+  const QString text = pidText(pid);
+  if (it == m_unitsByPath.end() || it->pid == text)
+    return;
+
+  it->pid = text;
+  markChanged();
+}
+
+void SystemdClient::markChanged()
+{
+  m_servicesDirty = true;
+  ++m_generation;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusObjectPath>
+#include <QDBusPendingCallWatcher>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+#include <atomic>
+
+#include "systemdataprovider.h"
+
+// Keeps the service units of one systemd manager up to date over D-Bus. The unit list is fetched
+// once with ListUnits and then patched from the UnitNew, UnitRemoved and PropertiesChanged
+// signals, so nothing is done while no unit changes. The connection is passed in so that the
+// client can be pointed at the user manager, the system manager or a private test bus.
+class SystemdClient : public QObject
+{
+  Q_OBJECT
+
+public:
+  enum State
+  {
+    Connecting,
+    Ready,
+    Unavailable
+  };
+
+  // Has to be created on a thread that runs an event loop; the signals are handled there.
+  SystemdClient(const QDBusConnection &connection, const QString &scope, QObject *parent = nullptr);
+
+  // Connecting until the initial unit list has arrived; Unavailable if there is no manager.
+  State state() const;
+  // Bumped on every change to the unit list; only meaningful once ready.
+  quint64 generation() const;
+  // Thread-safe; sorted by unit name.
+  QList<ServiceInfo> services() const;
+
+private slots:
+  void onListUnitsFinished(QDBusPendingCallWatcher *watcher);
+  void onUnitNew(const QString &name, const QDBusObjectPath &path);
+  void onUnitRemoved(const QString &name, const QDBusObjectPath &path);
+  void onPropertiesChanged(const QString &interface, const QVariantMap &changed, const QStringList &invalidated, const QDBusMessage &message);
+
+private:
+  void requestMainPid(const QString &path);
+  void requestUnitProperties(const QString &path);
+  void applyUnitProperties(const QString &path, const QVariantMap &properties);
+  void setMainPid(const QString &path, uint pid);
+  void markChanged();
+
+  QDBusConnection m_connection;
+  QString m_scope;
+  // Only touched on the thread the client lives on; m_mutex guards it against services().
+  QHash<QString, ServiceInfo> m_unitsByPath;
+  mutable QMutex m_mutex;
+  mutable QList<ServiceInfo> m_services;
+  mutable bool m_servicesDirty = true;
+  std::atomic<State> m_state{Connecting};
+  std::atomic<quint64> m_generation{0};
+};
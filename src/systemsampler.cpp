@@ -0,0 +1,279 @@
+#include "systemsampler.h"
+#include "helperutils.h"
+#include "instrumentation.h"
+#include "procparser.h"
+#include "trace.h"
+
+#include <QMutexLocker>
+#include <unistd.h>
+#include <sys/sysinfo.h>
+
+SystemSampler::SystemSampler(const QByteArray &procRoot)
+    : m_procRoot(procRoot), m_procSnapshotter(procRoot)
+{
+  m_usageState.procStatPath = m_procRoot + "/stat";
+  m_usageState.memInfoPath = m_procRoot + "/meminfo";
+
+  m_currentUser = qgetenv("USER");
+  if (m_currentUser.isEmpty())
+    m_currentUser = qgetenv("LOGNAME");
+  // Services, cron jobs and `env -i` run without either variable.
+  if (m_currentUser.isEmpty())
+    m_currentUser = getUserFromUid(geteuid());
+}
+
+QByteArray SystemSampler::procRoot() const
+{
+  return m_procRoot;
+}
+
+QString SystemSampler::currentUser() const
+{
+  return m_currentUser;
+}
+
+ProcFileCacheStats SystemSampler::procFileCacheStats() const
+{
+  return m_procSnapshotter.fileCacheStats();
+}
+
+void SystemSampler::setScanThreadCount(int count)
+{
+  m_procSnapshotter.setThreadCount(count);
+}
+
+int SystemSampler::scanThreadCount() const
+{
+  return m_procSnapshotter.threadCount();
+}
+
+ProcSnapshot::Fields SystemSampler::processListFields()
+{
+  return ProcSnapshot::Stat | ProcSnapshot::Status | ProcSnapshot::Cmdline;
+}
+
+void SystemSampler::beginTick(ProcSnapshot::Fields fields)
+{
+  QMutexLocker locker(&m_snapshotMutex);
+  ++m_tick;
+  m_tickFields = fields;
+}
+
+QSharedPointer<const ProcSnapshot> SystemSampler::acquireSnapshot(ProcSnapshot::Fields required)
+{
+  // The first collector of a tick captures everything announced in beginTick(); the others
+  // wait for that capture and then reuse it instead of scanning /proc again.
+  std::promise<QSharedPointer<const ProcSnapshot>> promise;
+  std::shared_ptr<PendingCapture> capture;
+  {
+    QMutexLocker locker(&m_snapshotMutex);
+    if (m_snapshot && m_snapshot->tick == m_tick && m_snapshot->has(required))
+      return m_snapshot;
+
+    if (m_pendingCapture && m_pendingCapture->tick == m_tick && (m_pendingCapture->fields & required) == required)
+    {
+      const std::shared_future<QSharedPointer<const ProcSnapshot>> result = m_pendingCapture->result;
+      locker.unlock();
+      return result.get();
+    }
+
+    capture = std::make_shared<PendingCapture>();
+    capture->tick = m_tick;
+    capture->fields = m_tickFields | required;
+    capture->result = promise.get_future().share();
+    m_pendingCapture = capture;
+  }
+
+  QSharedPointer<const ProcSnapshot> snapshot;
+  {
+    // A capture that is still running for an earlier tick finishes first.
+    QMutexLocker captureLocker(&m_captureMutex);
+    snapshot = m_procSnapshotter.capture(capture->fields, capture->tick);
+  }
+
+  // Published before the waiters are woken, so that no later caller starts another capture.
+  {
+    QMutexLocker locker(&m_snapshotMutex);
+    if (!m_snapshot || m_snapshot->tick <= snapshot->tick)
+      m_snapshot = snapshot;
+    if (m_pendingCapture == capture)
+      m_pendingCapture.reset();
+  }
+  promise.set_value(snapshot);
+  return snapshot;
+}
+
+SystemUsage SystemSampler::refreshSystemUsage()
+{
+  Instrumentation::StageTimer stageTimer(Instrumentation::UsageCollector);
+  SystemUsage usage = readSystemUsage();
+  usage.totalProcesses = acquireSnapshot({})->processCount;
+  return usage;
+}
+
+QList<ProcessInfo> SystemSampler::refreshProcessList(bool includeAllUsers)
+{
+  Instrumentation::StageTimer stageTimer(Instrumentation::ProcessCollector);
+  const QSharedPointer<const ProcSnapshot> snapshot = acquireSnapshot(processListFields());
+
+  const long pageSizeKb = sysconf(_SC_PAGESIZE) / 1024;
+  const long ticksPerSec = sysconf(_SC_CLK_TCK);
+  const int numCores = sysconf(_SC_NPROCESSORS_ONLN);
+
+  QList<ProcessInfo> processList;
+  processList.reserve(snapshot->processCount);
+
+  QMutexLocker locker(&m_processListState.mutex);
+  ProcessTable<CpuBaseline> &cpuBaselines = m_processListState.cpuBaselines;
+  cpuBaselines.beginScan();
+  for (const ProcSnapshot::Shard &shard : snapshot->shards)
+  {
+    for (const ProcSnapshot::Entry &entry : shard.entries)
+    {
+      if (!entry.has(processListFields()))
+        continue;
+
+      const double totalCpuTime = static_cast<double>(entry.utime + entry.stime);
+      const double processSeconds = snapshot->uptimeSeconds - (static_cast<double>(entry.starttime) / ticksPerSec);
+
+      CpuBaseline &baseline = cpuBaselines.mark({entry.pid, entry.starttime});
+      // A collector that runs twice on the same snapshot keeps the previous reading.
+      if (processSeconds > baseline.processSeconds)
+      {
+        double cpuPercent = 0.0;
+        if (processSeconds > 0.0)
+        {
+          const double deltaCpu = totalCpuTime - baseline.cpuTicks;
+          const double deltaTime = processSeconds - baseline.processSeconds;
+          if (deltaTime > 0.0 && deltaCpu > 0.0)
+            cpuPercent = (deltaCpu / ticksPerSec) / deltaTime * 100.0 / qMax(1, numCores);
+        }
+
+        baseline.cpuTicks = static_cast<qint64>(totalCpuTime);
+        baseline.processSeconds = processSeconds;
+        baseline.cpuPercent = cpuPercent;
+      }
+
+      if (!includeAllUsers && entry.user != m_currentUser)
+        continue;
+
+      ProcessInfo info;
+      info.pid = entry.pid;
+      info.starttime = entry.starttime;
+      info.name = entry.identity->displayName;
+      info.user = entry.user;
+      info.cpuPercent = baseline.cpuPercent;
+      info.memoryKb = static_cast<double>(entry.rssPages) * pageSizeKb;
+      processList.append(info);
+    }
+  }
+  cpuBaselines.sweep();
+  locker.unlock();
+
+  return processList;
+}
+
+SystemUsage SystemSampler::readSystemUsage()
+{
+  SystemUsage usage;
+  QMutexLocker locker(&m_usageState.mutex);
+  QByteArray &procStatBuffer = m_usageState.procStatBuffer;
+  QByteArray &memInfoBuffer = m_usageState.memInfoBuffer;
+
+  if (readProcFile(m_usageState.procStatPath.constData(), procStatBuffer) >= 0 &&
+      parseProcStatCpu(procStatBuffer.constData(), procStatBuffer.size(), usage.cpuTimes))
+  {
+    const CpuTimes &current = usage.cpuTimes;
+    const CpuTimes &previous = m_usageState.previousCpuTimes;
+    const int count = current.size();
+    usage.coreUsages.reserve(count - 1);
+
+    for (int index = 0; index < count; ++index)
+    {
+      const qint64 total = current.total(index);
+      const qint64 previousTotal = index < previous.size() ? previous.total(index) : 0;
+
+      if (previousTotal > 0 && total > previousTotal)
+      {
+        const qint64 deltaTotal = total - previousTotal;
+        const qint64 deltaIdle = current.idle[index] - previous.idle[index];
+        const int usageValue = static_cast<int>((deltaTotal - deltaIdle) * 100 / deltaTotal);
+        if (index == 0)
+        {
+          usage.cpuUsage = usageValue;
+          usage.iowaitPercent = (current.iowait[0] - previous.iowait[0]) * 100.0 / deltaTotal;
+          usage.stealPercent = (current.steal[0] - previous.steal[0]) * 100.0 / deltaTotal;
+        }
+        else
+        {
+          usage.coreUsages.append(usageValue);
+        }
+      }
+      else if (index > 0)
+      {
+        usage.coreUsages.append(0);
+      }
+    }
+
+    usage.coreCount = count > 0 ? count - 1 : 0;
+    m_usageState.previousCpuTimes = usage.cpuTimes;
+  }
+
+  MemInfo memInfo;
+  if (readProcFile(m_usageState.memInfoPath.constData(), memInfoBuffer) >= 0)
+  {
+    parseMemInfo(memInfoBuffer.constData(), memInfoBuffer.size(), memInfo);
+    WTM_TRACE("meminfo", "MemTotal=%lld MemAvailable=%lld MemFree=%lld Buffers=%lld Cached=%lld SReclaimable=%lld Shmem=%lld",
+              memInfo.memTotal, memInfo.memAvailable, memInfo.memFree, memInfo.buffers, memInfo.cached,
+              memInfo.sReclaimable, memInfo.shmem);
+
+    if (memInfo.memTotal <= 0)
+    {
+      const long pageSizeKb = sysconf(_SC_PAGESIZE) / 1024;
+      const long physPages = sysconf(_SC_PHYS_PAGES);
+      if (pageSizeKb > 0 && physPages > 0)
+        memInfo.memTotal = static_cast<qint64>(physPages) * pageSizeKb;
+    }
+
+    if (memInfo.memTotal > 0)
+    {
+      usage.totalRam = memInfo.memTotal;
+      if (memInfo.memAvailable > 0)
+      {
+        usage.ramUsage = memInfo.memTotal - memInfo.memAvailable;
+      }
+      else if (memInfo.memFree >= 0)
+      {
+        qint64 availableEstimate = memInfo.memFree + memInfo.buffers + memInfo.cached;
+        if (memInfo.sReclaimable > 0)
+          availableEstimate += memInfo.sReclaimable;
+        if (memInfo.shmem > 0)
+          availableEstimate -= memInfo.shmem;
+        usage.ramUsage = qMax<qint64>(0, memInfo.memTotal - availableEstimate);
+      }
+    }
+
+    WTM_TRACE("meminfo", "%lld kB total, %lld kB used", usage.totalRam, usage.ramUsage);
+  }
+
+  // Use sysinfo() when available as a reliable source for total/free RAM. Prefer MemAvailable if parsed.
+  struct sysinfo si;
+  if (sysinfo(&si) == 0)
+  {
+    const qint64 totalKb_sys = (static_cast<qint64>(si.totalram) * si.mem_unit) / 1024;
+    const qint64 freeKb_sys = (static_cast<qint64>(si.freeram) * si.mem_unit) / 1024;
+    // Ensure totalRam is set
+    if (usage.totalRam <= 0)
+      usage.totalRam = totalKb_sys;
+
+    // Prefer MemAvailable-based usage when available, otherwise use sysinfo values
+    if (memInfo.memAvailable > 0 && memInfo.memTotal > 0)
+      usage.ramUsage = memInfo.memTotal - memInfo.memAvailable;
+    else
+      usage.ramUsage = qMax<qint64>(0, usage.totalRam - freeKb_sys);
+
+    WTM_TRACE("sysinfo", "totalKb=%lld freeKb=%lld usedKb=%lld", totalKb_sys, freeKb_sys, usage.ramUsage);
+  }
+
+  return usage;
+}
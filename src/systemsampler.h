@@ -0,0 +1,120 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include <future>
+#include <memory>
+
+#include "procparser.h"
+#include "procsnapshot.h"
+#include "processtable.h"
+
+struct ProcessInfo
+{
+  int pid = 0;
+  // Together with pid, identifies the process across samples.
+  qint64 starttime = 0;
+  QString name;
+  QString user;
+  double cpuPercent = 0.0;
+  double memoryKb = 0.0;
+};
+
+struct CpuBaseline
+{
+  qint64 cpuTicks = 0;
+  double processSeconds = 0.0;
+  double cpuPercent = 0.0;
+};
+
+struct SystemUsage
+{
+  int cpuUsage = 0;
+  qint64 ramUsage = 0;
+  qint64 totalRam = 0;
+  int coreCount = 0;
+  QVector<int> coreUsages;
+  int totalProcesses = 0;
+  // Share of the last interval spent waiting for I/O and stolen by the hypervisor, over all cores.
+  double iowaitPercent = 0.0;
+  double stealPercent = 0.0;
+  CpuTimes cpuTimes;
+};
+
+// The procfs side of the collection engine: system usage, the process list and the shared /proc
+// snapshot they are computed from. It only needs Qt Core, so the desktop application and the
+// headless agent both sample through it.
+class SystemSampler
+{
+public:
+  // procRoot is where procfs is read from; a fixture tree can be passed instead of /proc.
+  explicit SystemSampler(const QByteArray &procRoot = QByteArrayLiteral("/proc"));
+
+  QByteArray procRoot() const;
+  QString currentUser() const;
+  ProcFileCacheStats procFileCacheStats() const;
+  // Number of threads used to scan /proc; 0 picks QThread::idealThreadCount().
+  void setScanThreadCount(int count);
+  int scanThreadCount() const;
+
+  // What refreshProcessList() needs from a snapshot.
+  static ProcSnapshot::Fields processListFields();
+  // Announces the fields the collectors of this tick need, so that the first one to capture /proc
+  // reads everything the others need as well.
+  void beginTick(ProcSnapshot::Fields fields);
+  // The snapshot of the current tick, captured with at least required on first use.
+  QSharedPointer<const ProcSnapshot> acquireSnapshot(ProcSnapshot::Fields required);
+
+  SystemUsage refreshSystemUsage();
+  QList<ProcessInfo> refreshProcessList(bool includeAllUsers);
+
+private:
+  // Mutable state is split per collector and each part is only touched under its own mutex, so
+  // the collectors can run concurrently on pool threads. The /proc snapshot is the one thing they
+  // share, and it is immutable once captured.
+  struct UsageState
+  {
+    QMutex mutex;
+    CpuTimes previousCpuTimes;
+    QByteArray procStatPath;
+    QByteArray memInfoPath;
+    QByteArray procStatBuffer;
+    QByteArray memInfoBuffer;
+  };
+
+  struct ProcessListState
+  {
+    QMutex mutex;
+    ProcessTable<CpuBaseline> cpuBaselines;
+  };
+
+  // A capture in progress. Collectors of the same tick that need no more fields wait for its
+  // result instead of scanning /proc again.
+  struct PendingCapture
+  {
+    quint64 tick = 0;
+    ProcSnapshot::Fields fields;
+    std::shared_future<QSharedPointer<const ProcSnapshot>> result;
+  };
+
+  SystemUsage readSystemUsage();
+
+  QByteArray m_procRoot;
+  QString m_currentUser;
+  UsageState m_usageState;
+  ProcessListState m_processListState;
+  ProcSnapshotter m_procSnapshotter;
+  // Serializes captures, which update the snapshotter's caches.
+  QMutex m_captureMutex;
+  // Guards the tick and the published snapshot; never held while /proc is read, so beginTick()
+  // and callers that find a current snapshot do not wait for a capture.
+  QMutex m_snapshotMutex;
+  quint64 m_tick = 0;
+  ProcSnapshot::Fields m_tickFields;
+  QSharedPointer<const ProcSnapshot> m_snapshot;
+  std::shared_ptr<PendingCapture> m_pendingCapture;
+};
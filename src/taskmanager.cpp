@@ -1,15 +1,20 @@
 #include "taskmanager.h"
+#include "collectorscheduler.h"
+#include "diagnosticsdialog.h"
+#include "hostsview.h"
+#include "performancegraph.h"
+#include "processtablemodel.h"
 #include "rundialog.h"
+#include "trace.h"
 #include <QtConcurrent/QtConcurrent>
 #include <QAction>
-#include <QChart>
-#include <QChartView>
+#include <QActionGroup>
 #include <QDebug>
+#include <QFileDialog>
 #include <QHBoxLayout>
 #include <QIcon>
-#include <QLineSeries>
+#include <QLabel>
 #include <QColor>
-#include <QAbstractAxis>
 #include <QMenuBar>
 #include <QPainter>
 #include <QSizePolicy>
@@ -18,16 +23,15 @@
 #include <QStatusBar>
 #include <QTabWidget>
 #include <QTextStream>
-#include <QTimer>
 #include <QTreeWidget>
 #include <QVBoxLayout>
 #include <QGridLayout>
 #include <QScrollArea>
-#include <QValueAxis>
+#include <QSortFilterProxyModel>
+#include <QTreeView>
 #include <QCheckBox>
 #include <QMessageBox>
 #include <QProcessEnvironment>
-#include <QLocale>
 #include <QPointF>
 #include <unistd.h>
 #include <signal.h>
@@ -41,6 +45,10 @@ TaskManager::TaskManager(QWidget *parent)
   createMenus();
   createTabs();
   createPerformanceChart();
+  m_hostsView = new HostsView(this);
+  m_tabWidget->addTab(m_hostsView, "Hosts");
+
+  m_historyClock.start();
 
   m_statusBar = new QStatusBar(this);
   setStatusBar(m_statusBar);
@@ -49,16 +57,32 @@ TaskManager::TaskManager(QWidget *parent)
 
   connect(m_tabWidget, &QTabWidget::currentChanged, this, &TaskManager::onTabChanged);
 
-  connect(&m_usageWatcher, &QFutureWatcher<SystemUsage>::finished, this, &TaskManager::onUsageRefreshFinished);
-  connect(&m_applicationsWatcher, &QFutureWatcher<QStringList>::finished, this, &TaskManager::onApplicationsRefreshFinished);
-  connect(&m_processesWatcher, &QFutureWatcher<QList<ProcessInfo>>::finished, this, &TaskManager::onProcessesRefreshFinished);
-  connect(&m_servicesWatcher, &QFutureWatcher<QList<ServiceInfo>>::finished, this, &TaskManager::onServicesRefreshFinished);
-
-  m_updateTimer = new QTimer(this);
-  connect(m_updateTimer, &QTimer::timeout, this, &TaskManager::refreshData);
+  connect(&m_usageWatcher, &QFutureWatcher<void>::finished, this, &TaskManager::onUsageRefreshFinished);
+  connect(&m_applicationsWatcher, &QFutureWatcher<void>::finished, this, &TaskManager::onApplicationsRefreshFinished);
+  connect(&m_processesWatcher, &QFutureWatcher<void>::finished, this, &TaskManager::onProcessesRefreshFinished);
+  connect(&m_servicesWatcher, &QFutureWatcher<void>::finished, this, &TaskManager::onServicesRefreshFinished);
+
+  // Usage is cheap and keeps the graph history continuous, so it also runs while the window is
+  // hidden; the other collectors only feed visible tabs.
+  m_scheduler = new CollectorScheduler(this, this);
+  m_usageCollector = m_scheduler->addCollector("Usage", 1, 0.25, false, [this]()
+                                               { return refreshUsageAsync(); });
+  m_processesCollector = m_scheduler->addCollector("Processes", 1, 0.5, true, [this]()
+                                                   { return refreshProcessesAsync(); });
+  m_applicationsCollector = m_scheduler->addCollector("Applications", 2, 0.5, true, [this]()
+                                                      { return refreshApplicationsAsync(); });
+  m_servicesCollector = m_scheduler->addCollector("Services", 5, 0.5, true, [this]()
+                                                  { return refreshServicesAsync(); });
+  connect(m_scheduler, &CollectorScheduler::aboutToStart, this, &TaskManager::onCollectorsDue);
+  connect(m_scheduler, &CollectorScheduler::exposedChanged, this, &TaskManager::onExposedChanged);
   setUpdateSpeed(UpdateSpeed::Normal);
 
-  refreshData();
+  m_scheduler->runAll();
+}
+
+void TaskManager::connectToAgent(const QString &address)
+{
+  m_hostsView->addAgent(address);
 }
 
 void TaskManager::createMenus()
@@ -84,6 +108,17 @@ void TaskManager::createMenus()
   updateSpeedMenu->addAction("Paused", this, [this]()
                              { setUpdateSpeed(UpdateSpeed::Paused); });
 
+  QMenu *historyLengthMenu = viewMenu->addMenu("History length");
+  QActionGroup *historyLengthGroup = new QActionGroup(historyLengthMenu);
+  for (const int samples : {60, 120, 300, 600})
+  {
+    QAction *action = historyLengthMenu->addAction(QString("%1 samples").arg(samples), this, [this, samples]()
+                                                   { setHistoryLength(samples); });
+    action->setCheckable(true);
+    action->setChecked(samples == m_historyLength);
+    historyLengthGroup->addAction(action);
+  }
+
   viewMenu->addSeparator();
   QAction *individualCore = viewMenu->addAction("Individual core usage");
   individualCore->setCheckable(true);
@@ -92,22 +127,42 @@ void TaskManager::createMenus()
           {
             if (m_coreScrollArea)
               m_coreScrollArea->setVisible(checked);
-            if (m_cpuChartView)
-              m_cpuChartView->setVisible(!checked);
+            if (m_cpuGraph)
+              m_cpuGraph->setVisible(!checked);
             if (checked && m_coreScrollArea && m_coreScrollArea->widget())
             {
               m_coreScrollArea->widget()->adjustSize();
               m_coreScrollArea->widget()->resize(m_coreScrollArea->widget()->sizeHint());
               m_coreScrollArea->widget()->updateGeometry();
               m_coreScrollArea->update();
-              for (QChartView *view : m_coreChartViews)
-              {
-                view->chart()->update();
-                view->update();
-              }
             } });
   viewMenu->addAction("Show history for all processes", this, []() {})->setCheckable(true);
 
+  viewMenu->addSeparator();
+  viewMenu->addAction("Diagnostics...", this, &TaskManager::showDiagnostics);
+  QAction *showSelfUsage = viewMenu->addAction("Show own usage in status bar");
+  showSelfUsage->setCheckable(true);
+  connect(showSelfUsage, &QAction::toggled, this, [this](bool checked)
+          {
+            m_showSelfUsage = checked;
+            if (m_usage)
+              updateStatusBar(); });
+
+#ifdef WINTASKMAN_ENABLE_TRACING
+  viewMenu->addSeparator();
+  QMenu *tracingMenu = viewMenu->addMenu("Tracing");
+  QAction *enableTracing = tracingMenu->addAction("Enable tracing");
+  enableTracing->setCheckable(true);
+  enableTracing->setChecked(Trace::isEnabled());
+  connect(enableTracing, &QAction::toggled, this, [](bool checked)
+          { Trace::setEnabled(checked); });
+  tracingMenu->addAction("Dump trace buffer...", this, [this]()
+                         {
+            const QString path = QFileDialog::getSaveFileName(this, "Dump trace buffer", "wintaskman-trace.log");
+            if (!path.isEmpty() && !Trace::dump(path))
+              QMessageBox::warning(this, "Tracing", QString("Could not write %1").arg(path)); });
+#endif
+
   helpMenu->addAction("Help topics", this, &TaskManager::openHelp);
   helpMenu->addSeparator();
   helpMenu->addAction("About Task Manager", this, &TaskManager::showAbout);
@@ -133,12 +188,19 @@ void TaskManager::createTabs()
   processesLayout->setContentsMargins(12, 12, 10, 10);
   processesLayout->setSpacing(5);
 
-  m_processesTab = new QTreeWidget(this);
-  m_processesTab->setColumnCount(5);
-  m_processesTab->setHeaderLabels({"Name", "PID", "User", "CPU", "Working Set (Memory)"});
+  // The proxy sorts once per refresh in updateProcesses() instead of after every change.
+  m_processModel = new ProcessTableModel(this);
+  m_processProxyModel = new QSortFilterProxyModel(this);
+  m_processProxyModel->setSourceModel(m_processModel);
+  m_processProxyModel->setSortRole(ProcessTableModel::SortRole);
+  m_processProxyModel->setDynamicSortFilter(false);
+
+  m_processesTab = new QTreeView(this);
+  m_processesTab->setModel(m_processProxyModel);
   m_processesTab->setRootIsDecorated(false);
+  m_processesTab->setUniformRowHeights(true);
   m_processesTab->setSortingEnabled(true);
-  m_processesTab->setStyleSheet("QTreeWidget { border: 1px solid gray; font-size: 11px; }");
+  m_processesTab->setStyleSheet("QTreeView { border: 1px solid gray; font-size: 11px; }");
 
   QHBoxLayout *controlsLayout = new QHBoxLayout();
   QCheckBox *toggleFilterButton = new QCheckBox("Show processes from all users", this);
@@ -158,30 +220,30 @@ void TaskManager::createTabs()
   connect(toggleFilterButton, &QCheckBox::toggled, this, [this](bool checked)
           {
         m_showAllProcesses = checked;
-        refreshProcessesAsync(); });
+        m_scheduler->run(m_processesCollector); });
 
-  connect(m_processesTab, &QTreeWidget::itemSelectionChanged, this, [this, endProcessButton]()
-          { endProcessButton->setEnabled(!m_processesTab->selectedItems().isEmpty()); });
+  connect(m_processesTab->selectionModel(), &QItemSelectionModel::selectionChanged, this, [this, endProcessButton]()
+          { endProcessButton->setEnabled(m_processesTab->selectionModel()->hasSelection()); });
 
   connect(endProcessButton, &QPushButton::clicked, this, [this]()
           {
-        QTreeWidgetItem *selectedItem = m_processesTab->currentItem();
-        if (!selectedItem)
+        const QModelIndex selectedIndex = m_processesTab->currentIndex();
+        if (!selectedIndex.isValid())
         {
             QMessageBox::warning(this, "No Selection", "Please select a process to end.");
             return;
         }
 
-        const int pid = selectedItem->data(1, Qt::UserRole).toInt();
+        const int pid = m_processModel->pidAt(m_processProxyModel->mapToSource(selectedIndex).row());
         if (QMessageBox::question(this, "Confirm", "Are you sure you want to end this process?") == QMessageBox::Yes)
         {
             kill(pid, SIGTERM);
-            refreshProcessesAsync();
+            m_scheduler->run(m_processesCollector);
         } });
 
   m_servicesTab = new QTreeWidget(this);
-  m_servicesTab->setColumnCount(4);
-  m_servicesTab->setHeaderLabels({"Name", "PID", "Description", "Status"});
+  m_servicesTab->setColumnCount(5);
+  m_servicesTab->setHeaderLabels({"Name", "PID", "Description", "Status", "Scope"});
   m_servicesTab->setRootIsDecorated(false);
   m_servicesTab->setSortingEnabled(true);
   m_servicesTab->setStyleSheet("QTreeWidget { border: 1px solid gray; font-size: 11px; }");
@@ -196,51 +258,21 @@ void TaskManager::createTabs()
 
 void TaskManager::createPerformanceChart()
 {
-  // Create CPU chart (total)
-  m_performanceSeries = new QLineSeries();
-  QChart *cpuChart = new QChart();
-  cpuChart->addSeries(m_performanceSeries);
-  cpuChart->legend()->hide();
-  cpuChart->setBackgroundBrush(QBrush(Qt::black));
-  cpuChart->setPlotAreaBackgroundVisible(true);
-  cpuChart->setPlotAreaBackgroundBrush(QBrush(Qt::black));
-  m_performanceSeries->setName("CPU %");
-  m_performanceSeries->setPen(QPen(Qt::green, 2));
-  QValueAxis *cpuAxisX = new QValueAxis();
-  QValueAxis *cpuAxisY = new QValueAxis();
-  cpuAxisX->setRange(0, 60);
-  cpuAxisY->setRange(0, 100);
-  cpuAxisX->setGridLinePen(QPen(Qt::darkGreen));
-  cpuAxisY->setGridLinePen(QPen(Qt::darkGreen));
-  cpuChart->addAxis(cpuAxisX, Qt::AlignBottom);
-  cpuChart->addAxis(cpuAxisY, Qt::AlignLeft);
-  m_performanceSeries->attachAxis(cpuAxisX);
-  m_performanceSeries->attachAxis(cpuAxisY);
-  m_cpuChartView = new QChartView(cpuChart);
-
-  // Create Memory chart
-  m_memorySeries = new QLineSeries();
-  QChart *memChart = new QChart();
-  memChart->addSeries(m_memorySeries);
-  memChart->legend()->hide();
-  memChart->setBackgroundBrush(QBrush(Qt::black));
-  memChart->setPlotAreaBackgroundVisible(true);
-  memChart->setPlotAreaBackgroundBrush(QBrush(Qt::black));
-  m_memorySeries->setName("Memory %");
-  m_memorySeries->setPen(QPen(Qt::blue, 2));
-  QValueAxis *memAxisX = new QValueAxis();
-  QValueAxis *memAxisY = new QValueAxis();
-  memAxisX->setRange(0, 60);
-  memAxisY->setRange(0, 100);
-  memAxisX->setGridLinePen(QPen(Qt::darkBlue));
-  memAxisY->setGridLinePen(QPen(Qt::darkBlue));
-  memChart->addAxis(memAxisX, Qt::AlignBottom);
-  memChart->addAxis(memAxisY, Qt::AlignLeft);
-  m_memorySeries->attachAxis(memAxisX);
-  m_memorySeries->attachAxis(memAxisY);
-  m_memoryChartView = new QChartView(memChart);
-
-  // Container for per-core charts
+  m_cpuGraph = new PerformanceGraph();
+  m_cpuGraph->setLineColor(Qt::green);
+  m_cpuGraph->setLineWidth(2);
+  m_cpuGraph->setGridColor(Qt::darkGreen);
+  m_cpuGraph->setScrollingEnabled(true);
+  m_cpuGraph->setHistory(&m_cpuHistory);
+
+  m_memoryGraph = new PerformanceGraph();
+  m_memoryGraph->setLineColor(Qt::blue);
+  m_memoryGraph->setLineWidth(2);
+  m_memoryGraph->setGridColor(Qt::darkBlue);
+  m_memoryGraph->setScrollingEnabled(true);
+  m_memoryGraph->setHistory(&m_memoryHistory);
+
+  // Container for per-core graphs
   m_coreContainerWidget = new QWidget();
   m_coreGridLayout = new QGridLayout(m_coreContainerWidget);
   m_coreGridLayout->setSpacing(6);
@@ -257,85 +289,127 @@ void TaskManager::createPerformanceChart()
   QVBoxLayout *performanceLayout = new QVBoxLayout(performanceTab);
   performanceLayout->setContentsMargins(12, 12, 10, 10);
   performanceLayout->setSpacing(8);
-  performanceLayout->addWidget(m_cpuChartView);
+  performanceLayout->addWidget(m_cpuGraph);
   performanceLayout->addWidget(m_coreScrollArea);
-  performanceLayout->addWidget(m_memoryChartView);
-  // hide per-core charts by default; summary (memory) remains visible
+  m_cpuBreakdownLabel = new QLabel(performanceTab);
+  performanceLayout->addWidget(m_cpuBreakdownLabel);
+  performanceLayout->addWidget(m_memoryGraph);
+  // hide per-core graphs by default; summary (memory) remains visible
   if (m_coreScrollArea)
     m_coreScrollArea->setVisible(false);
   performanceTab->setLayout(performanceLayout);
   m_tabWidget->addTab(performanceTab, "Performance");
 }
 
-void TaskManager::refreshData()
+void TaskManager::onCollectorsDue(const QVector<int> &due)
 {
-  refreshUsageAsync();
-  refreshApplicationsAsync();
-  refreshProcessesAsync();
-  refreshServicesAsync();
+  const int currentTab = m_tabWidget->currentIndex();
+  m_dataProvider.beginTick(currentTab == 1 && due.contains(m_processesCollector),
+                           currentTab == 0 && due.contains(m_applicationsCollector));
 }
 
-void TaskManager::refreshUsageAsync()
+void TaskManager::onExposedChanged(bool exposed)
 {
-  if (m_usageWatcher.isRunning())
+  if (!exposed)
     return;
 
+  // Rendering was skipped while hidden; catch up from the histories and refresh the visible tab.
+  if (m_usage)
+    updateStatusBar();
+  for (PerformanceGraph *graph : m_coreGraphs)
+    graph->update();
+  m_cpuGraph->update();
+  m_memoryGraph->update();
+  m_scheduler->runAll();
+}
+
+bool TaskManager::refreshUsageAsync()
+{
+  if (m_usageWatcher.isRunning())
+    return false;
+
   m_usageWatcher.setFuture(QtConcurrent::run([this]()
-                                             { return m_dataProvider.refreshSystemUsage(); }));
+                                             { m_usageChannel.publish(QSharedPointer<const SystemUsage>::create(m_dataProvider.refreshSystemUsage())); }));
+  return true;
 }
 
-void TaskManager::refreshApplicationsAsync()
+bool TaskManager::refreshApplicationsAsync()
 {
   if (m_applicationsWatcher.isRunning() || m_tabWidget->currentIndex() != 0)
-    return;
+    return false;
+
+  // With Sway's window events there is nothing to collect until a window actually changes.
+  const quint64 generation = m_dataProvider.applicationsGeneration();
+  if (generation != 0 && generation == m_applicationsGeneration)
+    return false;
+  m_applicationsGeneration = generation;
 
   m_applicationsWatcher.setFuture(QtConcurrent::run([this]()
-                                                    { return m_dataProvider.refreshApplications(); }));
+                                                    { m_applicationsChannel.publish(QSharedPointer<const QStringList>::create(m_dataProvider.refreshApplications())); }));
+  return true;
 }
 
-void TaskManager::refreshProcessesAsync()
+bool TaskManager::refreshProcessesAsync()
 {
   if (m_processesWatcher.isRunning() || m_tabWidget->currentIndex() != 1)
-    return;
+    return false;
 
   const bool includeAllUsers = m_showAllProcesses;
   m_processesWatcher.setFuture(QtConcurrent::run([this, includeAllUsers]()
-                                                 { return m_dataProvider.refreshProcessList(includeAllUsers); }));
+                                                 { m_processesChannel.publish(QSharedPointer<const QList<ProcessInfo>>::create(m_dataProvider.refreshProcessList(includeAllUsers))); }));
+  return true;
 }
 
-void TaskManager::refreshServicesAsync()
+bool TaskManager::refreshServicesAsync()
 {
   if (m_servicesWatcher.isRunning() || m_tabWidget->currentIndex() != 2)
-    return;
+    return false;
+
+  // With systemd's change signals there is nothing to collect until a unit actually changes.
+  const quint64 generation = m_dataProvider.servicesGeneration();
+  if (generation != 0 && generation == m_servicesGeneration)
+    return false;
+  m_servicesGeneration = generation;
 
   m_servicesWatcher.setFuture(QtConcurrent::run([this]()
-                                                { return m_dataProvider.refreshServices(); }));
+                                                { m_servicesChannel.publish(QSharedPointer<const QList<ServiceInfo>>::create(m_dataProvider.refreshServices())); }));
+  return true;
 }
 
 void TaskManager::onUsageRefreshFinished()
 {
-  m_usage = m_usageWatcher.result();
-  updateStatusBar();
+  m_scheduler->collectorFinished(m_usageCollector);
+  m_usage = m_usageChannel.latest();
+  if (!m_usage)
+    return;
+  m_selfUsage = Instrumentation::sampleSelfUsage();
+  if (m_diagnosticsDialog && m_diagnosticsDialog->isVisible())
+    m_diagnosticsDialog->setSelfUsage(m_selfUsage);
+  if (m_scheduler->isExposed())
+    updateStatusBar();
   updateGraphs();
 }
 
 void TaskManager::onApplicationsRefreshFinished()
 {
-  m_cachedApplications = m_applicationsWatcher.result();
+  m_scheduler->collectorFinished(m_applicationsCollector);
+  m_cachedApplications = m_applicationsChannel.latest();
   if (m_tabWidget->currentIndex() == 0)
     updateApplications();
 }
 
 void TaskManager::onProcessesRefreshFinished()
 {
-  m_cachedProcesses = m_processesWatcher.result();
+  m_scheduler->collectorFinished(m_processesCollector);
+  m_cachedProcesses = m_processesChannel.latest();
   if (m_tabWidget->currentIndex() == 1)
     updateProcesses();
 }
 
 void TaskManager::onServicesRefreshFinished()
 {
-  m_cachedServices = m_servicesWatcher.result();
+  m_scheduler->collectorFinished(m_servicesCollector);
+  m_cachedServices = m_servicesChannel.latest();
   if (m_tabWidget->currentIndex() == 2)
     updateServices();
 }
@@ -345,19 +419,19 @@ void TaskManager::onTabChanged(int index)
   switch (index)
   {
   case 0:
-    if (!m_cachedApplications.isEmpty())
+    if (m_cachedApplications && !m_cachedApplications->isEmpty())
       updateApplications();
-    refreshApplicationsAsync();
+    m_scheduler->run(m_applicationsCollector);
     break;
   case 1:
-    if (!m_cachedProcesses.isEmpty())
+    if (m_cachedProcesses && !m_cachedProcesses->isEmpty())
       updateProcesses();
-    refreshProcessesAsync();
+    m_scheduler->run(m_processesCollector);
     break;
   case 2:
-    if (!m_cachedServices.isEmpty())
+    if (m_cachedServices && !m_cachedServices->isEmpty())
       updateServices();
-    refreshServicesAsync();
+    m_scheduler->run(m_servicesCollector);
     break;
   default:
     break;
@@ -369,13 +443,13 @@ void TaskManager::updateActiveTab()
   switch (m_tabWidget->currentIndex())
   {
   case 0:
-    refreshApplicationsAsync();
+    m_scheduler->run(m_applicationsCollector);
     break;
   case 1:
-    refreshProcessesAsync();
+    m_scheduler->run(m_processesCollector);
     break;
   case 2:
-    refreshServicesAsync();
+    m_scheduler->run(m_servicesCollector);
     break;
   default:
     break;
@@ -384,106 +458,84 @@ void TaskManager::updateActiveTab()
 
 void TaskManager::updateStatusBar()
 {
-  const double memoryPercent = m_usage.totalRam > 0 ? (m_usage.ramUsage * 100.0) / m_usage.totalRam : 0.0;
-  const QString statusText = QString("Processes: %1 | CPU Usage: %2% | Physical Memory: %3%")
-                                 .arg(m_usage.totalProcesses)
-                                 .arg(m_usage.cpuUsage)
-                                 .arg(QString::number(memoryPercent, 'f', 1));
+  Instrumentation::StageTimer stageTimer(Instrumentation::StatusBarUpdate);
+  const double memoryPercent = m_usage->totalRam > 0 ? (m_usage->ramUsage * 100.0) / m_usage->totalRam : 0.0;
+  QString statusText = QString("Processes: %1 | CPU Usage: %2% | Physical Memory: %3%")
+                           .arg(m_usage->totalProcesses)
+                           .arg(m_usage->cpuUsage)
+                           .arg(QString::number(memoryPercent, 'f', 1));
+  if (m_showSelfUsage)
+    statusText += QString(" | Task Manager: %1% CPU, %2 MB")
+                      .arg(QString::number(m_selfUsage.cpuPercent, 'f', 1))
+                      .arg(QString::number(m_selfUsage.rssKb / 1024.0, 'f', 1));
   m_statusBar->showMessage(statusText);
+
+  const ProcFileCacheStats cacheStats = m_dataProvider.procFileCacheStats();
+  m_statusBar->setToolTip(QString("/proc stat cache: %1% hit rate, %2 open files\n%3")
+                              .arg(QString::number(cacheStats.hitRate() * 100.0, 'f', 1))
+                              .arg(cacheStats.openFiles)
+                              .arg(m_scheduler->timingSummary()));
 }
 
 void TaskManager::updateGraphs()
 {
-  if (!m_performanceSeries || !m_memorySeries || !m_cpuChartView || !m_memoryChartView)
+  Instrumentation::StageTimer stageTimer(Instrumentation::GraphUpdate);
+  if (!m_usage || !m_cpuGraph || !m_memoryGraph)
     return;
 
-  const int coreCount = m_usage.coreCount;
+  const int coreCount = m_usage->coreCount;
 
-  // create or remove per-core chart widgets/series as needed
-  while (m_coreSeries.size() < coreCount)
+  // create or remove per-core graph widgets as needed
+  while (m_coreGraphs.size() < coreCount)
   {
-    const int idx = m_coreSeries.size();
-    QLineSeries *series = new QLineSeries();
-    series->setName(QString("Core %1").arg(idx));
-    QColor c = QColor::fromHsv((idx * 40) % 360, 200, 200);
-    series->setPen(QPen(c, 1));
-
-    QChart *chart = new QChart();
-    chart->addSeries(series);
-    chart->legend()->hide();
-    chart->setBackgroundBrush(QBrush(Qt::black));
-    chart->setPlotAreaBackgroundVisible(true);
-    chart->setPlotAreaBackgroundBrush(QBrush(Qt::black));
-    QValueAxis *axisX = new QValueAxis();
-    QValueAxis *axisY = new QValueAxis();
-    axisX->setRange(0, 60);
-    axisY->setRange(0, 100);
-    axisX->setGridLinePen(QPen(Qt::darkGreen));
-    axisY->setGridLinePen(QPen(Qt::darkGreen));
-    chart->addAxis(axisX, Qt::AlignBottom);
-    chart->addAxis(axisY, Qt::AlignLeft);
-    series->attachAxis(axisX);
-    series->attachAxis(axisY);
-
-    QChartView *view = new QChartView(chart);
-    view->setRenderHint(QPainter::Antialiasing);
-    view->setMinimumHeight(80);
-    view->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Preferred);
+    const int idx = m_coreGraphs.size();
+    PerformanceGraph *graph = new PerformanceGraph();
+    graph->setLineColor(QColor::fromHsv((idx * 40) % 360, 200, 200));
+    graph->setGridColor(Qt::darkGreen);
+    graph->setScrollingEnabled(true);
+    graph->setMinimumHeight(80);
+    graph->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Preferred);
 
     const int cols = 4;
     const int row = idx / cols;
     const int col = idx % cols;
-    m_coreGridLayout->addWidget(view, row, col);
+    m_coreGridLayout->addWidget(graph, row, col);
 
-    m_coreSeries.append(series);
-    m_coreChartViews.append(view);
+    m_coreGraphs.append(graph);
   }
 
-  while (m_coreSeries.size() > coreCount)
+  while (m_coreGraphs.size() > coreCount)
   {
-    QLineSeries *s = m_coreSeries.takeLast();
-    QChartView *v = m_coreChartViews.takeLast();
-    m_coreGridLayout->removeWidget(v);
-    delete v;
-    delete s;
+    PerformanceGraph *graph = m_coreGraphs.takeLast();
+    m_coreGridLayout->removeWidget(graph);
+    delete graph;
   }
 
-  auto shiftAndTrim = [](QLineSeries *series)
-  {
-    while (series->count() >= 60)
-      series->removePoints(0, 1);
-    for (int i = 0; i < series->count(); ++i)
-    {
-      QPointF point = series->at(i);
-      series->replace(i, QPointF(point.x() - 1.0, point.y()));
-    }
-  };
-
-  // Shift existing points
-  shiftAndTrim(m_performanceSeries);
-  shiftAndTrim(m_memorySeries);
-  for (QLineSeries *coreSeries : m_coreSeries)
-    shiftAndTrim(coreSeries);
-
-  // Append new values at right edge (60)
-  m_performanceSeries->append(60, m_usage.cpuUsage);
-  const double memoryPercent = m_usage.totalRam > 0 ? (m_usage.ramUsage * 100.0) / m_usage.totalRam : 0.0;
-  m_memorySeries->append(60, memoryPercent);
+  const qint64 now = m_historyClock.elapsed();
+  const double memoryPercent = m_usage->totalRam > 0 ? (m_usage->ramUsage * 100.0) / m_usage->totalRam : 0.0;
+  m_cpuHistory.append(now, m_usage->cpuUsage);
+  m_memoryHistory.append(now, memoryPercent);
 
-  for (int i = 0; i < m_coreSeries.size(); ++i)
+  // Resizing may move the histories, so the graphs are pointed at them again afterwards.
+  if (m_coreHistories.size() != m_coreGraphs.size())
   {
-    int val = 0;
-    if (i < m_usage.coreUsages.size())
-      val = m_usage.coreUsages[i];
-    m_coreSeries[i]->append(60, val);
+    m_coreHistories.resize(m_coreGraphs.size(), SampleHistory(m_historyLength));
+    for (int i = 0; i < m_coreGraphs.size(); ++i)
+      m_coreGraphs[i]->setHistory(&m_coreHistories[i]);
   }
+  for (int i = 0; i < m_coreHistories.size(); ++i)
+    m_coreHistories[i].append(now, i < m_usage->coreUsages.size() ? m_usage->coreUsages[i] : 0);
+
+  // Nothing to render while the window is hidden; onExposedChanged() repaints from the histories.
+  if (!m_scheduler->isExposed())
+    return;
 
   // show/hide core area and CPU summary depending on 'Individual core usage' toggle
-  if (m_graphSummaryAction && m_coreScrollArea && m_cpuChartView)
+  if (m_graphSummaryAction && m_coreScrollArea && m_cpuGraph)
   {
     const bool showIndividual = m_graphSummaryAction->isChecked();
     m_coreScrollArea->setVisible(showIndividual);
-    m_cpuChartView->setVisible(!showIndividual);
+    m_cpuGraph->setVisible(!showIndividual);
     if (showIndividual && m_coreScrollArea->widget())
     {
       m_coreScrollArea->widget()->adjustSize();
@@ -491,16 +543,21 @@ void TaskManager::updateGraphs()
     }
   }
 
-  // refresh views
-  m_cpuChartView->chart()->update();
-  m_memoryChartView->chart()->update();
-  for (QChartView *v : m_coreChartViews)
-    v->chart()->update();
+  if (m_cpuBreakdownLabel)
+    m_cpuBreakdownLabel->setText(QString("I/O wait: %1%   Steal: %2%")
+                                     .arg(QString::number(m_usage->iowaitPercent, 'f', 1))
+                                     .arg(QString::number(m_usage->stealPercent, 'f', 1)));
+
+  m_cpuGraph->sampleAppended();
+  m_memoryGraph->sampleAppended();
+  for (PerformanceGraph *graph : m_coreGraphs)
+    graph->sampleAppended();
 }
 
 void TaskManager::updateApplications()
 {
-  const QStringList &applications = m_cachedApplications;
+  Instrumentation::StageTimer stageTimer(Instrumentation::ApplicationsViewUpdate);
+  const QStringList &applications = *m_cachedApplications;
 
   for (auto it = m_appToItemMap.begin(); it != m_appToItemMap.end(); ++it)
     it.value()->setData(0, Qt::UserRole, false);
@@ -539,76 +596,44 @@ void TaskManager::updateApplications()
 
 void TaskManager::updateProcesses()
 {
-  const QList<ProcessInfo> &processes = m_cachedProcesses;
+  Instrumentation::StageTimer stageTimer(Instrumentation::ProcessesViewUpdate);
 
-  for (auto it = m_pidToItemMap.begin(); it != m_pidToItemMap.end(); ++it)
-    it.value()->setData(0, Qt::UserRole, false);
+  m_processModel->setProcesses(*m_cachedProcesses);
+  if (m_processProxyModel->sortColumn() >= 0)
+    m_processProxyModel->sort(m_processProxyModel->sortColumn(), m_processProxyModel->sortOrder());
 
-  for (const ProcessInfo &process : processes)
-  {
-    QTreeWidgetItem *item = nullptr;
-    if (m_pidToItemMap.contains(process.pid))
-    {
-      item = m_pidToItemMap[process.pid];
-    }
-    else
-    {
-      item = new QTreeWidgetItem(m_processesTab);
-      m_pidToItemMap.insert(process.pid, item);
-    }
-
-    item->setText(0, process.name);
-    item->setData(1, Qt::DisplayRole, process.pid);
-    item->setData(1, Qt::UserRole, process.pid);
-    item->setText(2, process.user);
-    item->setText(3, QString::number(process.cpuPercent, 'f', 1));
-    item->setTextAlignment(3, Qt::AlignCenter);
-
-    const QLocale locale = QLocale::system();
-    item->setText(4, locale.toString(process.memoryKb, 'f', 0) + " K");
-    item->setData(4, Qt::UserRole, process.memoryKb);
-    item->setTextAlignment(4, Qt::AlignRight);
-    item->setData(0, Qt::UserRole, true);
-  }
-
-  for (auto it = m_pidToItemMap.begin(); it != m_pidToItemMap.end();)
-  {
-    if (!it.value()->data(0, Qt::UserRole).toBool())
-    {
-      delete it.value();
-      it = m_pidToItemMap.erase(it);
-    }
-    else
-    {
-      ++it;
-    }
-  }
+  WTM_TRACE("processes", "model update: %lld rows in %lld us", static_cast<long long>(m_cachedProcesses->size()),
+            static_cast<long long>(stageTimer.elapsedNs() / 1000));
 }
 
 void TaskManager::updateServices()
 {
-  const QList<ServiceInfo> &services = m_cachedServices;
+  Instrumentation::StageTimer stageTimer(Instrumentation::ServicesViewUpdate);
+  const QList<ServiceInfo> &services = *m_cachedServices;
 
   for (auto it = m_serviceNameToItemMap.begin(); it != m_serviceNameToItemMap.end(); ++it)
     it.value()->setData(0, Qt::UserRole, false);
 
   for (const ServiceInfo &service : services)
   {
+    // The user and system managers can both have a unit of the same name.
+    const QString key = service.scope + '/' + service.name;
     QTreeWidgetItem *item = nullptr;
-    if (m_serviceNameToItemMap.contains(service.name))
+    if (m_serviceNameToItemMap.contains(key))
     {
-      item = m_serviceNameToItemMap[service.name];
+      item = m_serviceNameToItemMap[key];
     }
     else
     {
       item = new QTreeWidgetItem(m_servicesTab);
-      m_serviceNameToItemMap.insert(service.name, item);
+      m_serviceNameToItemMap.insert(key, item);
     }
 
     item->setText(0, service.name);
     item->setText(1, service.pid);
     item->setText(2, service.description);
     item->setText(3, service.state);
+    item->setText(4, service.scope);
     item->setData(0, Qt::UserRole, true);
   }
 
@@ -635,7 +660,19 @@ void TaskManager::runNewTask()
 void TaskManager::refreshNow()
 {
   qDebug() << "Refresh now clicked";
-  refreshData();
+  m_scheduler->runAll();
+}
+
+void TaskManager::showDiagnostics()
+{
+  if (!m_diagnosticsDialog)
+  {
+    m_diagnosticsDialog = new DiagnosticsDialog(this);
+    m_diagnosticsDialog->setSelfUsage(m_selfUsage);
+  }
+  m_diagnosticsDialog->show();
+  m_diagnosticsDialog->raise();
+  m_diagnosticsDialog->activateWindow();
 }
 
 void TaskManager::openHelp()
@@ -648,24 +685,44 @@ void TaskManager::showAbout()
   qDebug() << "About Task Manager clicked";
 }
 
+void TaskManager::setHistoryLength(int samples)
+{
+  m_historyLength = samples;
+  m_cpuHistory.setCapacity(samples);
+  m_memoryHistory.setCapacity(samples);
+  for (SampleHistory &history : m_coreHistories)
+    history.setCapacity(samples);
+
+  // The horizontal scale changed, so everything is repainted rather than scrolled.
+  QVector<PerformanceGraph *> graphs = m_coreGraphs;
+  graphs << m_cpuGraph << m_memoryGraph;
+  for (PerformanceGraph *graph : graphs)
+  {
+    if (graph)
+      graph->update();
+  }
+}
+
 void TaskManager::setUpdateSpeed(UpdateSpeed speed)
 {
-  if (!m_updateTimer)
+  if (!m_scheduler)
     return;
 
   switch (speed)
   {
   case UpdateSpeed::High:
-    m_updateTimer->start(500);
+    m_scheduler->setBaseInterval(500);
     break;
   case UpdateSpeed::Normal:
-    m_updateTimer->start(1000);
+    m_scheduler->setBaseInterval(1000);
     break;
   case UpdateSpeed::Low:
-    m_updateTimer->start(2000);
+    m_scheduler->setBaseInterval(2000);
     break;
   case UpdateSpeed::Paused:
-    m_updateTimer->stop();
+    m_scheduler->setBaseInterval(0);
     break;
   }
+  if (m_hostsView)
+    m_hostsView->setUpdateInterval(m_scheduler->baseInterval());
 }
@@ -1,24 +1,33 @@
 #pragma once
 
 #include <QMainWindow>
+#include <QElapsedTimer>
 #include <QFutureWatcher>
+#include <QList>
 #include <QMap>
 #include <QVector>
 
-class QChart;
-class QLineSeries;
 class QStatusBar;
 class QTabWidget;
 class QTreeWidget;
-class QTimer;
+class QTreeView;
+class QSortFilterProxyModel;
 class QTreeWidgetItem;
-class QChartView;
 class QWidget;
 class QGridLayout;
+class QLabel;
 class QAction;
 class QScrollArea;
+class CollectorScheduler;
+class DiagnosticsDialog;
+class HostsView;
+class PerformanceGraph;
+class ProcessTableModel;
 class RunDialog;
 
+#include "instrumentation.h"
+#include "samplehistory.h"
+#include "snapshotchannel.h"
 #include "systemdataprovider.h"
 
 enum class UpdateSpeed
@@ -36,15 +45,18 @@ class TaskManager : public QMainWindow
 public:
   explicit TaskManager(QWidget *parent = nullptr);
 
+  // Adds a wintaskman-agent to the Hosts tab.
+  void connectToAgent(const QString &address);
+
 private:
   void createMenus();
   void createTabs();
   void createPerformanceChart();
-  void refreshData();
-  void refreshUsageAsync();
-  void refreshApplicationsAsync();
-  void refreshProcessesAsync();
-  void refreshServicesAsync();
+  // Each returns false if the collector was not started (still running or its tab is hidden).
+  bool refreshUsageAsync();
+  bool refreshApplicationsAsync();
+  bool refreshProcessesAsync();
+  bool refreshServicesAsync();
   void updateActiveTab();
   void updateStatusBar();
   void updateGraphs();
@@ -55,13 +67,17 @@ private:
 
   void runNewTask();
   void refreshNow();
+  void showDiagnostics();
   void openHelp();
   void showAbout();
   void setUpdateSpeed(UpdateSpeed speed);
+  void setHistoryLength(int samples);
 
   void onTabChanged(int index);
 
 private slots:
+  void onCollectorsDue(const QVector<int> &due);
+  void onExposedChanged(bool exposed);
   void onUsageRefreshFinished();
   void onApplicationsRefreshFinished();
   void onProcessesRefreshFinished();
@@ -69,37 +85,54 @@ private slots:
 
 private:
   SystemDataProvider m_dataProvider;
-  SystemUsage m_usage;
+  // Latest snapshot taken from each channel; collectors publish new ones from pool threads.
+  QSharedPointer<const SystemUsage> m_usage;
 
   QTabWidget *m_tabWidget = nullptr;
   QStatusBar *m_statusBar = nullptr;
-  QTimer *m_updateTimer = nullptr;
-  QFutureWatcher<SystemUsage> m_usageWatcher;
-  QFutureWatcher<QStringList> m_applicationsWatcher;
-  QFutureWatcher<QList<ProcessInfo>> m_processesWatcher;
-  QFutureWatcher<QList<ServiceInfo>> m_servicesWatcher;
+  CollectorScheduler *m_scheduler = nullptr;
+  int m_usageCollector = -1;
+  int m_applicationsCollector = -1;
+  int m_processesCollector = -1;
+  int m_servicesCollector = -1;
+  QFutureWatcher<void> m_usageWatcher;
+  QFutureWatcher<void> m_applicationsWatcher;
+  QFutureWatcher<void> m_processesWatcher;
+  QFutureWatcher<void> m_servicesWatcher;
+  SnapshotChannel<SystemUsage> m_usageChannel;
+  SnapshotChannel<QStringList> m_applicationsChannel;
+  SnapshotChannel<QList<ProcessInfo>> m_processesChannel;
+  SnapshotChannel<QList<ServiceInfo>> m_servicesChannel;
   QTreeWidget *m_applicationsTab = nullptr;
-  QTreeWidget *m_processesTab = nullptr;
+  QTreeView *m_processesTab = nullptr;
+  ProcessTableModel *m_processModel = nullptr;
+  QSortFilterProxyModel *m_processProxyModel = nullptr;
   QTreeWidget *m_servicesTab = nullptr;
-  QChart *m_performanceChart = nullptr; // kept for compatibility but not used for per-graph charts
-  QLineSeries *m_performanceSeries = nullptr;
-  QLineSeries *m_memorySeries = nullptr;
-  QVector<QLineSeries *> m_coreSeries;
-
-  // New per-chart UI elements
-  QChartView *m_cpuChartView = nullptr;
-  QChartView *m_memoryChartView = nullptr;
-  QVector<QChartView *> m_coreChartViews;
+  PerformanceGraph *m_cpuGraph = nullptr;
+  PerformanceGraph *m_memoryGraph = nullptr;
+  QVector<PerformanceGraph *> m_coreGraphs;
   QWidget *m_coreContainerWidget = nullptr;
   QGridLayout *m_coreGridLayout = nullptr;
   QScrollArea *m_coreScrollArea = nullptr;
+  QLabel *m_cpuBreakdownLabel = nullptr;
+  HostsView *m_hostsView = nullptr;
   QAction *m_graphSummaryAction = nullptr;
 
+  int m_historyLength = 60;
+  QElapsedTimer m_historyClock;
+  SampleHistory m_cpuHistory{m_historyLength};
+  SampleHistory m_memoryHistory{m_historyLength};
+  QVector<SampleHistory> m_coreHistories;
+
   QMap<QString, QTreeWidgetItem *> m_appToItemMap;
-  QMap<int, QTreeWidgetItem *> m_pidToItemMap;
   QMap<QString, QTreeWidgetItem *> m_serviceNameToItemMap;
-  QStringList m_cachedApplications;
-  QList<ProcessInfo> m_cachedProcesses;
-  QList<ServiceInfo> m_cachedServices;
+  QSharedPointer<const QStringList> m_cachedApplications;
+  QSharedPointer<const QList<ProcessInfo>> m_cachedProcesses;
+  QSharedPointer<const QList<ServiceInfo>> m_cachedServices;
+  quint64 m_applicationsGeneration = 0;
+  quint64 m_servicesGeneration = 0;
   bool m_showAllProcesses = false;
+  bool m_showSelfUsage = false;
+  Instrumentation::SelfUsage m_selfUsage;
+  DiagnosticsDialog *m_diagnosticsDialog = nullptr;
 };
@@ -0,0 +1,121 @@
+#include "trace.h"
+
+#include <QFile>
+#include <QThread>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+constexpr quint64 slotCount = 4096;
+constexpr int messageCapacity = 160;
+
+struct TraceSlot
+{
+  // Odd while the slot is being written, 2 * (index + 1) once record number index is complete.
+  std::atomic<quint64> sequence{0};
+  qint64 timestampNs = 0;
+  quint64 threadId = 0;
+  const char *category = nullptr;
+  char message[messageCapacity] = {};
+};
+
+struct TraceBuffer
+{
+  std::atomic<bool> enabled{qEnvironmentVariableIntValue("WINTASKMAN_TRACE") != 0};
+  std::atomic<quint64> head{0};
+  TraceSlot slots[slotCount];
+};
+
+TraceBuffer &traceBuffer()
+{
+  static TraceBuffer buffer;
+  return buffer;
+}
+
+qint64 monotonicNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}
+
+bool Trace::isEnabled()
+{
+  return traceBuffer().enabled.load(std::memory_order_relaxed);
+}
+
+void Trace::setEnabled(bool enabled)
+{
+  traceBuffer().enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Trace::record(const char *category, const char *format, ...)
+{
+  TraceBuffer &buffer = traceBuffer();
+  const quint64 index = buffer.head.fetch_add(1, std::memory_order_relaxed);
+  TraceSlot &slot = buffer.slots[index % slotCount];
+
+  // Writers never wait: a slot that is overwritten while being dumped is detected by the
+  // reader through the sequence number and skipped.
+  slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.timestampNs = monotonicNs();
+  slot.threadId = static_cast<quint64>(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+  slot.category = category;
+
+  va_list arguments;
+  va_start(arguments, format);
+  std::vsnprintf(slot.message, sizeof(slot.message), format, arguments);
+  va_end(arguments);
+
+  slot.sequence.store(2 * (index + 1), std::memory_order_release);
+}
+
+bool Trace::dump(const QString &path)
+{
+  QFile file(path);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    return false;
+
+  TraceBuffer &buffer = traceBuffer();
+  const quint64 head = buffer.head.load(std::memory_order_acquire);
+  const quint64 first = head > slotCount ? head - slotCount : 0;
+
+  char line[messageCapacity + 96];
+  char message[messageCapacity];
+  for (quint64 index = first; index < head; ++index)
+  {
+    const TraceSlot &slot = buffer.slots[index % slotCount];
+    if (slot.sequence.load(std::memory_order_acquire) != 2 * (index + 1))
+      continue;
+
+    const qint64 timestampNs = slot.timestampNs;
+    const quint64 threadId = slot.threadId;
+    const char *category = slot.category;
+    std::memcpy(message, slot.message, sizeof(message));
+    message[sizeof(message) - 1] = '\0';
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != 2 * (index + 1))
+      continue;
+
+    const int length = std::snprintf(line, sizeof(line), "%lld.%06lld [%llx] %s: %s\n",
+                                     static_cast<long long>(timestampNs / 1000000000),
+                                     static_cast<long long>((timestampNs / 1000) % 1000000),
+                                     static_cast<unsigned long long>(threadId), category ? category : "-", message);
+    file.write(line, qMin<int>(length, sizeof(line) - 1));
+  }
+
+  return true;
+}
+
+void Trace::dumpToEnvironmentPath()
+{
+  const QString path = qEnvironmentVariable("WINTASKMAN_TRACE_DUMP");
+  if (!path.isEmpty())
+    dump(path);
+}
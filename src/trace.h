@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QString>
+
+// Lightweight tracing for the sampling paths. Trace points compile to nothing unless the build
+// defines WINTASKMAN_ENABLE_TRACING, and cost a single relaxed load while tracing is disabled
+// at runtime. Records go to a fixed size in-memory ring buffer that is only written to disk
+// when it is dumped, so the hot paths never perform I/O.
+//
+// WINTASKMAN_TRACE=1 enables tracing at startup and WINTASKMAN_TRACE_DUMP=<path> writes the
+// buffer to <path> when the application exits.
+namespace Trace
+{
+bool isEnabled();
+void setEnabled(bool enabled);
+
+void record(const char *category, const char *format, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+
+// Writes the buffered records, oldest first, as text lines. Returns false if path cannot be written.
+bool dump(const QString &path);
+// Dumps to $WINTASKMAN_TRACE_DUMP if it is set.
+void dumpToEnvironmentPath();
+}
+
+#ifdef WINTASKMAN_ENABLE_TRACING
+#define WTM_TRACE(category, ...)             \
+  do                                         \
+  {                                          \
+    if (Trace::isEnabled())                  \
+      Trace::record(category, __VA_ARGS__);  \
+  } while (0)
+#else
+#define WTM_TRACE(category, ...) \
+  do                             \
+  {                              \
+  } while (0)
+#endif
@@ -0,0 +1,190 @@
+#include "unixsockets.h"
+#include "instrumentation.h"
+#include "procparser.h"
+
+#include <QByteArrayView>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <linux/unix_diag.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const char *skipSpaces(const char *cursor, const char *end)
+{
+  while (cursor < end && *cursor == ' ')
+    ++cursor;
+  return cursor;
+}
+
+static const char *skipField(const char *cursor, const char *end)
+{
+  while (cursor < end && *cursor != ' ' && *cursor != '\n')
+    ++cursor;
+  return cursor;
+}
+
+static bool isWaylandSocketPath(QByteArrayView path)
+{
+  const qsizetype slash = path.lastIndexOf('/');
+  const QByteArrayView name = slash >= 0 ? path.sliced(slash + 1) : path;
+  return name.startsWith("wayland-");
+}
+
+// Lines look like "0000000000000000: 00000002 00000000 00010000 0001 01 12345 /run/user/1000/wayland-0";
+// the inode is the seventh field and the path, if the socket is bound, the eighth.
+static void parseUnixSocketTable(const char *data, qsizetype length, QSet<quint64> &inodes)
+{
+  const char *cursor = data;
+  const char *end = data + length;
+
+  // Skip the header line.
+  while (cursor < end && *cursor != '\n')
+    ++cursor;
+
+  while (cursor < end)
+  {
+    ++cursor;
+    for (int field = 0; field < 6; ++field)
+      cursor = skipField(skipSpaces(cursor, end), end);
+
+    cursor = skipSpaces(cursor, end);
+    quint64 inode = 0;
+    for (; cursor < end && *cursor >= '0' && *cursor <= '9'; ++cursor)
+      inode = inode * 10 + (*cursor - '0');
+
+    cursor = skipSpaces(cursor, end);
+    const char *pathBegin = cursor;
+    while (cursor < end && *cursor != '\n')
+      ++cursor;
+
+    if (cursor > pathBegin && isWaylandSocketPath(QByteArrayView(pathBegin, cursor - pathBegin)))
+      inodes.insert(inode);
+  }
+}
+
+bool addKernelUnixSocketPeers(QSet<quint64> &inodes)
+{
+  const int fd = ::socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+  if (fd < 0)
+    return false;
+
+  struct
+  {
+    nlmsghdr header;
+    unix_diag_req request;
+  } message = {};
+  message.header.nlmsg_len = sizeof(message);
+  message.header.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+  message.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  message.request.sdiag_family = AF_UNIX;
+  message.request.udiag_states = ~0u;
+  message.request.udiag_show = UDIAG_SHOW_PEER;
+
+  sockaddr_nl address = {};
+  address.nl_family = AF_NETLINK;
+  if (::sendto(fd, &message, sizeof(message), 0, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0)
+  {
+    ::close(fd);
+    return false;
+  }
+
+  QSet<quint64> peers;
+  alignas(nlmsghdr) char buffer[32768];
+  bool done = false;
+  bool ok = true;
+  while (!done)
+  {
+    int length = static_cast<int>(::recv(fd, buffer, sizeof(buffer), 0));
+    if (length <= 0)
+    {
+      ok = false;
+      break;
+    }
+
+    for (nlmsghdr *header = reinterpret_cast<nlmsghdr *>(buffer); NLMSG_OK(header, length); header = NLMSG_NEXT(header, length))
+    {
+      if (header->nlmsg_type == NLMSG_DONE || header->nlmsg_type == NLMSG_ERROR)
+      {
+        ok = header->nlmsg_type == NLMSG_DONE;
+        done = true;
+        break;
+      }
+
+      const unix_diag_msg *diag = static_cast<const unix_diag_msg *>(NLMSG_DATA(header));
+      if (!inodes.contains(diag->udiag_ino))
+        continue;
+
+      int attributesLength = static_cast<int>(header->nlmsg_len - NLMSG_LENGTH(sizeof(*diag)));
+      for (rtattr *attribute = reinterpret_cast<rtattr *>(const_cast<unix_diag_msg *>(diag) + 1); RTA_OK(attribute, attributesLength); attribute = RTA_NEXT(attribute, attributesLength))
+      {
+        if (attribute->rta_type == UNIX_DIAG_PEER && RTA_PAYLOAD(attribute) >= sizeof(quint32))
+          peers.insert(*static_cast<const quint32 *>(RTA_DATA(attribute)));
+      }
+    }
+  }
+
+  ::close(fd);
+  inodes.unite(peers);
+  return ok;
+}
+
+bool readWaylandSocketInodes(const QByteArray &procRoot, QByteArray &buffer, QSet<quint64> &inodes,
+                             const UnixSocketPeerLookup &addPeers)
+{
+  inodes.clear();
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/net/unix", procRoot.constData());
+  const qsizetype length = readProcFile(path, buffer);
+  if (length < 0)
+    return false;
+
+  parseUnixSocketTable(buffer.constData(), length, inodes);
+  if (!inodes.isEmpty() && addPeers)
+    addPeers(inodes);
+  return true;
+}
+
+bool hasSocketInode(const QByteArray &procRoot, int pid, const QSet<quint64> &inodes)
+{
+  if (inodes.isEmpty())
+    return false;
+
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%d/fd", procRoot.constData(), pid);
+  DIR *fdDir = opendir(path);
+  Instrumentation::countSyscall(Instrumentation::Open);
+  if (!fdDir)
+    return false;
+
+  bool found = false;
+  char target[64];
+  while (const dirent *entry = readdir(fdDir))
+  {
+    Instrumentation::countSyscall(Instrumentation::DirectoryEntry);
+    if (entry->d_name[0] == '.')
+      continue;
+
+    const ssize_t length = readlinkat(dirfd(fdDir), entry->d_name, target, sizeof(target) - 1);
+    Instrumentation::countSyscall(Instrumentation::ReadLink);
+    if (length <= 8 || memcmp(target, "socket:[", 8) != 0)
+      continue;
+
+    quint64 inode = 0;
+    for (ssize_t index = 8; index < length && target[index] >= '0' && target[index] <= '9'; ++index)
+      inode = inode * 10 + (target[index] - '0');
+    if (inodes.contains(inode))
+    {
+      found = true;
+      break;
+    }
+  }
+
+  closedir(fdDir);
+  Instrumentation::countSyscall(Instrumentation::Close);
+  return found;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QByteArray>
+#include <QSet>
+#include <functional>
+
+// Adds the peers of the given sockets to the set.
+using UnixSocketPeerLookup = std::function<void(QSet<quint64> &inodes)>;
+
+// The peer lookup of the running kernel, one NETLINK_SOCK_DIAG dump of all unix sockets. Returns
+// false if the dump failed.
+bool addKernelUnixSocketPeers(QSet<quint64> &inodes);
+
+// Inodes of the sockets that carry Wayland connections: every socket bound to a wayland-* path
+// in <procRoot>/net/unix, which covers the compositor's listening and accepted ends, plus the client
+// ends connected to them. Clients connect from unnamed sockets that /proc/net/unix cannot tell
+// apart, so their inodes come from addPeers; without it only the named ends are found. buffer is
+// reused between calls. Returns false if /proc/net/unix could not be read.
+bool readWaylandSocketInodes(const QByteArray &procRoot, QByteArray &buffer, QSet<quint64> &inodes,
+                             const UnixSocketPeerLookup &addPeers);
+
+// Whether one of the process's file descriptors is a socket with one of the given inodes.
+// Only the fd links are read, the sockets are never opened.
+bool hasSocketInode(const QByteArray &procRoot, int pid, const QSet<quint64> &inodes);
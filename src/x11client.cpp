@@ -0,0 +1,240 @@
+#include "x11client.h"
+#include "trace.h"
+
+#include <QMutexLocker>
+#include <QSet>
+#include <QSocketNotifier>
+#include <QVector>
+#include <algorithm>
+#include <cstdlib>
+
+// Upper bound for property reads, in 32 bit units.
+static constexpr quint32 maximumPropertyLength = 65536;
+
+X11Client::X11Client(const QByteArray &display, QObject *parent)
+    : QObject(parent)
+{
+  int screenNumber = 0;
+  m_connection = xcb_connect(display.isEmpty() ? nullptr : display.constData(), &screenNumber);
+  if (xcb_connection_has_error(m_connection))
+  {
+    WTM_TRACE("x11", "cannot connect to display %s", display.isEmpty() ? qgetenv("DISPLAY").constData() : display.constData());
+    xcb_disconnect(m_connection);
+    m_connection = nullptr;
+    return;
+  }
+
+  xcb_screen_iterator_t screens = xcb_setup_roots_iterator(xcb_get_setup(m_connection));
+  for (int index = 0; index < screenNumber && screens.rem > 0; ++index)
+    xcb_screen_next(&screens);
+  if (screens.rem == 0 || !internAtoms())
+    return;
+  m_root = screens.data->root;
+
+  // The window manager keeps _NET_CLIENT_LIST on the root window current, so watching that one
+  // property is enough to see every window that is mapped or destroyed.
+  const quint32 eventMask = XCB_EVENT_MASK_PROPERTY_CHANGE;
+  xcb_change_window_attributes(m_connection, m_root, XCB_CW_EVENT_MASK, &eventMask);
+
+  m_notifier = new QSocketNotifier(xcb_get_file_descriptor(m_connection), QSocketNotifier::Read, this);
+  connect(m_notifier, &QSocketNotifier::activated, this, &X11Client::onActivated);
+
+  m_state = Ready;
+  updateClientList();
+  // Waiting for the replies may have pulled events into xcb's queue that the notifier will not
+  // report.
+  onActivated();
+}
+
+X11Client::~X11Client()
+{
+  delete m_notifier;
+  if (m_connection)
+    xcb_disconnect(m_connection);
+}
+
+X11Client::State X11Client::state() const
+{
+  return m_state.load();
+}
+
+quint64 X11Client::generation() const
+{
+  return m_generation.load();
+}
+
+QList<X11Window> X11Client::windows() const
+{
+  QMutexLocker locker(&m_mutex);
+  if (m_dirty)
+  {
+    m_windows = m_windowsById.values();
+    std::sort(m_windows.begin(), m_windows.end(), [](const X11Window &left, const X11Window &right)
+              { return left.id < right.id; });
+    m_applications.clear();
+    for (const X11Window &window : std::as_const(m_windows))
+    {
+      if (!window.application.isEmpty())
+        m_applications.append(window.application);
+    }
+    m_applications.removeDuplicates();
+    m_applications.sort();
+    m_dirty = false;
+  }
+  return m_windows;
+}
+
+QStringList X11Client::applications() const
+{
+  windows();
+  QMutexLocker locker(&m_mutex);
+  return m_applications;
+}
+
+void X11Client::onActivated()
+{
+  if (m_state != Ready)
+    return;
+
+  for (;;)
+  {
+    bool clientListChanged = false;
+    while (xcb_generic_event_t *event = xcb_poll_for_event(m_connection))
+    {
+      if ((event->response_type & ~0x80) == XCB_PROPERTY_NOTIFY)
+      {
+        const auto *notify = reinterpret_cast<const xcb_property_notify_event_t *>(event);
+        if (notify->window == m_root && notify->atom == m_clientListAtom)
+          clientListChanged = true;
+      }
+      std::free(event);
+    }
+
+    if (xcb_connection_has_error(m_connection))
+    {
+      WTM_TRACE("x11", "connection lost");
+      setUnavailable();
+      return;
+    }
+    if (!clientListChanged)
+      return;
+    updateClientList();
+  }
+}
+
+bool X11Client::internAtoms()
+{
+  static const char clientListName[] = "_NET_CLIENT_LIST";
+  static const char pidName[] = "_NET_WM_PID";
+  const xcb_intern_atom_cookie_t clientListCookie = xcb_intern_atom(m_connection, 0, sizeof(clientListName) - 1, clientListName);
+  const xcb_intern_atom_cookie_t pidCookie = xcb_intern_atom(m_connection, 0, sizeof(pidName) - 1, pidName);
+
+  xcb_intern_atom_reply_t *clientListReply = xcb_intern_atom_reply(m_connection, clientListCookie, nullptr);
+  xcb_intern_atom_reply_t *pidReply = xcb_intern_atom_reply(m_connection, pidCookie, nullptr);
+  if (clientListReply)
+    m_clientListAtom = clientListReply->atom;
+  if (pidReply)
+    m_pidAtom = pidReply->atom;
+  std::free(clientListReply);
+  std::free(pidReply);
+  return m_clientListAtom != XCB_ATOM_NONE && m_pidAtom != XCB_ATOM_NONE;
+}
+
+void X11Client::updateClientList()
+{
+  xcb_get_property_reply_t *listReply = xcb_get_property_reply(
+      m_connection, xcb_get_property(m_connection, 0, m_root, m_clientListAtom, XCB_ATOM_WINDOW, 0, maximumPropertyLength), nullptr);
+  QSet<quint32> clientIds;
+  if (listReply && listReply->format == 32)
+  {
+    const auto *ids = static_cast<const xcb_window_t *>(xcb_get_property_value(listReply));
+    const int count = xcb_get_property_value_length(listReply) / int(sizeof(xcb_window_t));
+    clientIds = QSet<quint32>(ids, ids + count);
+  }
+  std::free(listReply);
+
+  // Only windows that are new to the list are queried, and all of their requests are sent
+  // before the first reply is awaited.
+  struct PendingWindow
+  {
+    xcb_window_t id;
+    xcb_get_property_cookie_t classCookie;
+    xcb_get_property_cookie_t pidCookie;
+  };
+  QVector<PendingWindow> pending;
+  for (const quint32 id : std::as_const(clientIds))
+  {
+    if (m_windowsById.contains(id))
+      continue;
+    pending.append({id,
+                    xcb_get_property(m_connection, 0, id, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0, 256),
+                    xcb_get_property(m_connection, 0, id, m_pidAtom, XCB_ATOM_CARDINAL, 0, 1)});
+  }
+
+  QVector<X11Window> added;
+  added.reserve(pending.size());
+  for (const PendingWindow &request : std::as_const(pending))
+  {
+    xcb_get_property_reply_t *classReply = xcb_get_property_reply(m_connection, request.classCookie, nullptr);
+    xcb_get_property_reply_t *pidReply = xcb_get_property_reply(m_connection, request.pidCookie, nullptr);
+
+    // A window destroyed since the list was read fails with BadWindow; it drops out of the
+    // list with the next change.
+    if (classReply)
+    {
+      X11Window window;
+      window.id = request.id;
+
+      // WM_CLASS holds the instance and the class name, each terminated by a NUL.
+      const char *value = static_cast<const char *>(xcb_get_property_value(classReply));
+      const int length = xcb_get_property_value_length(classReply);
+      const int instanceLength = int(qstrnlen(value, length));
+      window.application = QString::fromLocal8Bit(value, instanceLength);
+      if (window.application.isEmpty() && instanceLength + 1 < length)
+      {
+        const char *className = value + instanceLength + 1;
+        window.application = QString::fromLocal8Bit(className, qstrnlen(className, length - instanceLength - 1));
+      }
+
+      if (pidReply && pidReply->format == 32 && xcb_get_property_value_length(pidReply) >= 4)
+        window.pid = int(*static_cast<const quint32 *>(xcb_get_property_value(pidReply)));
+      added.append(window);
+    }
+    std::free(classReply);
+    std::free(pidReply);
+  }
+
+  QMutexLocker locker(&m_mutex);
+  bool changed = !added.isEmpty();
+  for (auto it = m_windowsById.begin(); it != m_windowsById.end();)
+  {
+    if (clientIds.contains(it.key()))
+    {
+      ++it;
+      continue;
+    }
+    it = m_windowsById.erase(it);
+    changed = true;
+  }
+  for (const X11Window &window : std::as_const(added))
+    m_windowsById.insert(window.id, window);
+  if (changed)
+    markChanged();
+  WTM_TRACE("x11", "%lld client windows, %lld added", static_cast<long long>(m_windowsById.size()), static_cast<long long>(added.size()));
+}
+
+void X11Client::setUnavailable()
+{
+  m_state = Unavailable;
+  if (m_notifier)
+    m_notifier->setEnabled(false);
+  QMutexLocker locker(&m_mutex);
+  m_windowsById.clear();
+  markChanged();
+}
+
+void X11Client::markChanged()
+{
+  m_dirty = true;
+  ++m_generation;
+}
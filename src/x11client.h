@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <xcb/xcb.h>
+
+class QSocketNotifier;
+
+struct X11Window
+{
+  quint32 id = 0;
+  // Instance name from WM_CLASS, or its class name if there is none.
+  QString application;
+  // From _NET_WM_PID; 0 if the client does not set it.
+  int pid = 0;
+};
+
+// Keeps the client windows of an X11 session over its own xcb connection instead of running
+// xlsclients. _NET_CLIENT_LIST is read once and then again only when the window manager
+// reports a change to it through PropertyNotify on the root window, and only the windows that
+// were added are queried, so nothing is done while no window opens or closes. The display is
+// passed in so that the client can be pointed at a test server such as Xvfb.
+class X11Client : public QObject
+{
+  Q_OBJECT
+
+public:
+  enum State
+  {
+    Ready,
+    Unavailable
+  };
+
+  // Has to be created on a thread that runs an event loop; the connection is watched there.
+  // An empty display uses $DISPLAY.
+  explicit X11Client(const QByteArray &display = QByteArray(), QObject *parent = nullptr);
+  ~X11Client() override;
+
+  State state() const;
+  // Bumped on every change to the window list.
+  quint64 generation() const;
+  // Thread-safe; sorted by window id.
+  QList<X11Window> windows() const;
+  // Thread-safe; application names of the windows, sorted and without duplicates.
+  QStringList applications() const;
+
+private slots:
+  void onActivated();
+
+private:
+  bool internAtoms();
+  void updateClientList();
+  void setUnavailable();
+  void markChanged();
+
+  xcb_connection_t *m_connection = nullptr;
+  xcb_window_t m_root = 0;
+  xcb_atom_t m_clientListAtom = XCB_ATOM_NONE;
+  xcb_atom_t m_pidAtom = XCB_ATOM_NONE;
+  QSocketNotifier *m_notifier = nullptr;
+  // Only touched on the thread the client lives on; m_mutex guards it against the getters.
+  QHash<quint32, X11Window> m_windowsById;
+  mutable QMutex m_mutex;
+  mutable QList<X11Window> m_windows;
+  mutable QStringList m_applications;
+  mutable bool m_dirty = true;
+  std::atomic<State> m_state{Unavailable};
+  std::atomic<quint64> m_generation{0};
+};
@@ -0,0 +1,789 @@
+#include "swayclient.h"
+#include "systemdclient.h"
+#include "x11client.h"
+
+#include <QDBusArgument>
+#include <QDBusConnection>
+#include <QDBusMetaType>
+#include <QDBusVariant>
+#include <QDBusVirtualObject>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMap>
+#include <QPointer>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QtEndian>
+#include <cstdlib>
+#include <memory>
+#include <xcb/xcb.h>
+
+namespace
+{
+const QString systemdService = QStringLiteral("org.freedesktop.systemd1");
+const QString managerPath = QStringLiteral("/org/freedesktop/systemd1");
+const QString managerInterface = QStringLiteral("org.freedesktop.systemd1.Manager");
+const QString unitInterface = QStringLiteral("org.freedesktop.systemd1.Unit");
+const QString serviceInterface = QStringLiteral("org.freedesktop.systemd1.Service");
+const QString propertiesInterface = QStringLiteral("org.freedesktop.DBus.Properties");
+
+// One row of the ListUnits reply, a(ssssssouso).
+struct UnitListEntry
+{
+  QString name;
+  QString description;
+  QString loadState;
+  QString activeState;
+  QString subState;
+  QString following;
+  QDBusObjectPath unitPath;
+  uint jobId = 0;
+  QString jobType;
+  QDBusObjectPath jobPath;
+};
+
+QDBusArgument &operator<<(QDBusArgument &argument, const UnitListEntry &entry)
+{
+  argument.beginStructure();
+  argument << entry.name << entry.description << entry.loadState << entry.activeState << entry.subState << entry.following
+           << entry.unitPath << entry.jobId << entry.jobType << entry.jobPath;
+  argument.endStructure();
+  return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, UnitListEntry &entry)
+{
+  argument.beginStructure();
+  argument >> entry.name >> entry.description >> entry.loadState >> entry.activeState >> entry.subState >> entry.following >>
+      entry.unitPath >> entry.jobId >> entry.jobType >> entry.jobPath;
+  argument.endStructure();
+  return argument;
+}
+}
+
+Q_DECLARE_METATYPE(UnitListEntry)
+
+namespace
+{
+struct MockUnit
+{
+  QString description;
+  QString activeState;
+  uint mainPid = 0;
+};
+
+// Answers the calls SystemdClient makes (Subscribe, ListUnits and the Get and GetAll properties
+// of units) from a table of units, and sends the signals systemd would send when it changes.
+class MockSystemdManager : public QDBusVirtualObject
+{
+public:
+  explicit MockSystemdManager(const QDBusConnection &connection)
+      : m_connection(connection)
+  {
+  }
+
+  ~MockSystemdManager() override
+  {
+    m_connection.unregisterService(systemdService);
+    m_connection.unregisterObject(managerPath, QDBusConnection::UnregisterTree);
+  }
+
+  bool registerOnBus()
+  {
+    return m_connection.registerVirtualObject(managerPath, this, QDBusConnection::SubPath) &&
+           m_connection.registerService(systemdService);
+  }
+
+  static QString unitPath(const QString &name)
+  {
+    QString escaped = name;
+    escaped.replace('.', QLatin1String("_2e")).replace('-', QLatin1String("_2d"));
+    return managerPath + QStringLiteral("/unit/") + escaped;
+  }
+
+  void addUnit(const QString &name, const MockUnit &unit, bool announce)
+  {
+    m_units.insert(name, unit);
+    if (announce)
+    {
+      QDBusMessage signal = QDBusMessage::createSignal(managerPath, managerInterface, QStringLiteral("UnitNew"));
+      signal << name << QVariant::fromValue(QDBusObjectPath(unitPath(name)));
+      m_connection.send(signal);
+    }
+  }
+
+  void removeUnit(const QString &name)
+  {
+    m_units.remove(name);
+    QDBusMessage signal = QDBusMessage::createSignal(managerPath, managerInterface, QStringLiteral("UnitRemoved"));
+    signal << name << QVariant::fromValue(QDBusObjectPath(unitPath(name)));
+    m_connection.send(signal);
+  }
+
+  void setActiveState(const QString &name, const QString &activeState)
+  {
+    m_units[name].activeState = activeState;
+    sendPropertiesChanged(name, unitInterface, {{QStringLiteral("ActiveState"), activeState}});
+  }
+
+  void setMainPid(const QString &name, uint pid)
+  {
+    m_units[name].mainPid = pid;
+    sendPropertiesChanged(name, serviceInterface, {{QStringLiteral("MainPID"), pid}});
+  }
+
+  QString introspect(const QString &) const override
+  {
+    return QString();
+  }
+
+  bool handleMessage(const QDBusMessage &message, const QDBusConnection &connection) override
+  {
+    const QList<QVariant> arguments = message.arguments();
+    if (message.path() == managerPath && message.member() == QLatin1String("Subscribe"))
+      return connection.send(message.createReply());
+
+    if (message.path() == managerPath && message.member() == QLatin1String("ListUnits"))
+    {
+      QList<UnitListEntry> entries;
+      for (auto it = m_units.cbegin(); it != m_units.cend(); ++it)
+      {
+        UnitListEntry entry;
+        entry.name = it.key();
+        entry.description = it->description;
+        entry.loadState = QStringLiteral("loaded");
+        entry.activeState = it->activeState;
+        entry.subState = it->activeState == QLatin1String("active") ? QStringLiteral("running") : QStringLiteral("dead");
+        entry.unitPath = QDBusObjectPath(unitPath(it.key()));
+        entry.jobPath = QDBusObjectPath(QStringLiteral("/"));
+        entries.append(entry);
+      }
+      return connection.send(message.createReply(QVariant::fromValue(entries)));
+    }
+
+    for (auto it = m_units.cbegin(); it != m_units.cend(); ++it)
+    {
+      if (message.path() != unitPath(it.key()) || message.interface() != propertiesInterface || arguments.isEmpty())
+        continue;
+
+      const QString interface = arguments.constFirst().toString();
+      if (message.member() == QLatin1String("Get") && interface == serviceInterface && arguments.value(1).toString() == QLatin1String("MainPID"))
+        return connection.send(message.createReply(QVariant::fromValue(QDBusVariant(it->mainPid))));
+      if (message.member() == QLatin1String("GetAll") && interface == unitInterface)
+      {
+        const QVariantMap properties = {{QStringLiteral("Description"), it->description}, {QStringLiteral("ActiveState"), it->activeState}};
+        return connection.send(message.createReply(properties));
+      }
+    }
+
+    return connection.send(message.createErrorReply(QDBusError::UnknownMethod, message.member()));
+  }
+
+private:
+  void sendPropertiesChanged(const QString &name, const QString &interface, const QVariantMap &changed)
+  {
+    QDBusMessage signal = QDBusMessage::createSignal(unitPath(name), propertiesInterface, QStringLiteral("PropertiesChanged"));
+    signal << interface << changed << QStringList();
+    m_connection.send(signal);
+  }
+
+  QDBusConnection m_connection;
+  QMap<QString, MockUnit> m_units;
+};
+
+ServiceInfo serviceNamed(const SystemdClient &client, const QString &name)
+{
+  for (const ServiceInfo &service : client.services())
+  {
+    if (service.name == name)
+      return service;
+  }
+  return ServiceInfo();
+}
+
+// Speaks the i3-ipc framing of Sway: the "i3-ipc" magic, then the payload length and the message
+// type as 32 bit integers in host byte order, then the JSON payload. Subscriptions succeed unless
+// told otherwise, tree requests are answered with the current tree, and events are sent on demand.
+class FakeSwayServer
+{
+public:
+  static constexpr quint32 subscribeMessage = 2;
+  static constexpr quint32 getTreeMessage = 4;
+  static constexpr quint32 workspaceEvent = 0x80000000;
+  static constexpr quint32 windowEvent = 0x80000003;
+
+  static QByteArray message(quint32 type, const QByteArray &payload)
+  {
+    QByteArray message = QByteArrayLiteral("i3-ipc");
+    message.resize(14);
+    qToUnaligned<quint32>(payload.size(), message.data() + 6);
+    qToUnaligned<quint32>(type, message.data() + 10);
+    return message + payload;
+  }
+
+  bool listen(const QString &path)
+  {
+    QObject::connect(&m_server, &QLocalServer::newConnection, &m_server, [this]()
+                     {
+      while (QLocalSocket *client = m_server.nextPendingConnection())
+      {
+        m_client = client;
+        QObject::connect(client, &QLocalSocket::readyRead, client, [this, client]()
+                         { onReadyRead(client); });
+      } });
+    return m_server.listen(path);
+  }
+
+  void setTree(const QJsonObject &tree)
+  {
+    m_tree = tree;
+  }
+
+  void setSubscribeSucceeds(bool succeeds)
+  {
+    m_subscribeSucceeds = succeeds;
+  }
+
+  int treeRequests() const
+  {
+    return m_treeRequests;
+  }
+
+  void sendEvent(quint32 type, const QJsonObject &event)
+  {
+    sendRaw(message(type, QJsonDocument(event).toJson(QJsonDocument::Compact)));
+  }
+
+  void sendRaw(const QByteArray &data)
+  {
+    if (m_client)
+    {
+      m_client->write(data);
+      m_client->flush();
+    }
+  }
+
+  void disconnectClient()
+  {
+    if (m_client)
+      m_client->disconnectFromServer();
+  }
+
+private:
+  void onReadyRead(QLocalSocket *client)
+  {
+    m_buffer.append(client->readAll());
+    while (m_buffer.size() >= 14)
+    {
+      const quint32 length = qFromUnaligned<quint32>(m_buffer.constData() + 6);
+      const quint32 type = qFromUnaligned<quint32>(m_buffer.constData() + 10);
+      if (m_buffer.size() < 14 + qsizetype(length))
+        break;
+      m_buffer.remove(0, 14 + length);
+
+      if (type == subscribeMessage)
+      {
+        const QJsonObject reply{{QStringLiteral("success"), m_subscribeSucceeds}};
+        client->write(message(type, QJsonDocument(reply).toJson(QJsonDocument::Compact)));
+      }
+      else if (type == getTreeMessage)
+      {
+        ++m_treeRequests;
+        client->write(message(type, QJsonDocument(m_tree).toJson(QJsonDocument::Compact)));
+      }
+    }
+  }
+
+  QLocalServer m_server;
+  QPointer<QLocalSocket> m_client;
+  QByteArray m_buffer;
+  QJsonObject m_tree;
+  bool m_subscribeSucceeds = true;
+  int m_treeRequests = 0;
+};
+
+// A native Wayland window, identified by its app_id.
+QJsonObject waylandWindow(qint64 id, const QString &appId, bool visible, const QString &type = QStringLiteral("con"))
+{
+  return {{QStringLiteral("id"), id}, {QStringLiteral("type"), type}, {QStringLiteral("app_id"), appId},
+          {QStringLiteral("name"), appId + QStringLiteral(" title")}, {QStringLiteral("visible"), visible}};
+}
+
+// An Xwayland window, identified by its WM_CLASS.
+QJsonObject xwaylandWindow(qint64 id, const QString &windowClass, bool visible)
+{
+  const QJsonObject properties{{QStringLiteral("class"), windowClass}, {QStringLiteral("instance"), windowClass.toLower()}};
+  return {{QStringLiteral("id"), id}, {QStringLiteral("type"), QStringLiteral("con")}, {QStringLiteral("window"), 4194304 + id},
+          {QStringLiteral("window_properties"), properties}, {QStringLiteral("app_id"), QJsonValue()},
+          {QStringLiteral("name"), windowClass}, {QStringLiteral("visible"), visible}};
+}
+
+// Two workspaces: the visible one holds a split container with a Wayland and an Xwayland window
+// plus a floating window, the hidden one holds gimp, which is only visible if gimpVisible.
+QJsonObject swayTree(bool gimpVisible)
+{
+  const QJsonObject split{{QStringLiteral("id"), 3}, {QStringLiteral("type"), QStringLiteral("con")}, {QStringLiteral("window"), QJsonValue()},
+                          {QStringLiteral("name"), QJsonValue()}, {QStringLiteral("visible"), true},
+                          {QStringLiteral("nodes"), QJsonArray{waylandWindow(10, QStringLiteral("foot"), true), xwaylandWindow(11, QStringLiteral("Firefox"), true)}}};
+  const QJsonObject visibleWorkspace{{QStringLiteral("id"), 2}, {QStringLiteral("type"), QStringLiteral("workspace")}, {QStringLiteral("name"), QStringLiteral("1")},
+                                     {QStringLiteral("nodes"), QJsonArray{split}},
+                                     {QStringLiteral("floating_nodes"), QJsonArray{waylandWindow(12, QStringLiteral("mpv"), true, QStringLiteral("floating_con"))}}};
+  const QJsonObject hiddenWorkspace{{QStringLiteral("id"), 4}, {QStringLiteral("type"), QStringLiteral("workspace")}, {QStringLiteral("name"), QStringLiteral("2")},
+                                    {QStringLiteral("nodes"), QJsonArray{waylandWindow(13, QStringLiteral("gimp"), gimpVisible)}}};
+  const QJsonObject output{{QStringLiteral("id"), 1}, {QStringLiteral("type"), QStringLiteral("output")}, {QStringLiteral("name"), QStringLiteral("HEADLESS-1")},
+                           {QStringLiteral("nodes"), QJsonArray{visibleWorkspace, hiddenWorkspace}}};
+  return {{QStringLiteral("id"), 0}, {QStringLiteral("type"), QStringLiteral("root")}, {QStringLiteral("name"), QStringLiteral("root")},
+          {QStringLiteral("nodes"), QJsonArray{output}}};
+}
+
+// Plays the window manager on its own xcb connection: creates client windows with WM_CLASS and
+// _NET_WM_PID and publishes them in _NET_CLIENT_LIST on the root window. The windows are never
+// mapped; X11Client only reads their properties.
+class FakeWindowManager
+{
+public:
+  ~FakeWindowManager()
+  {
+    if (m_connection)
+      xcb_disconnect(m_connection);
+  }
+
+  bool connectTo(const QByteArray &display)
+  {
+    int screenNumber = 0;
+    m_connection = xcb_connect(display.constData(), &screenNumber);
+    if (xcb_connection_has_error(m_connection))
+      return false;
+    m_root = xcb_setup_roots_iterator(xcb_get_setup(m_connection)).data->root;
+    return true;
+  }
+
+  // An empty instance leaves only the class name in WM_CLASS; a pid of 0 leaves out _NET_WM_PID.
+  xcb_window_t createWindow(const QByteArray &instance, const QByteArray &className, quint32 pid)
+  {
+    const xcb_window_t window = xcb_generate_id(m_connection);
+    xcb_create_window(m_connection, XCB_COPY_FROM_PARENT, window, m_root, 0, 0, 100, 100, 0,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT, 0, nullptr);
+    const QByteArray windowClass = instance + '\0' + className + '\0';
+    xcb_change_property(m_connection, XCB_PROP_MODE_REPLACE, window, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 8,
+                        windowClass.size(), windowClass.constData());
+    if (pid != 0)
+      xcb_change_property(m_connection, XCB_PROP_MODE_REPLACE, window, atom("_NET_WM_PID"), XCB_ATOM_CARDINAL, 32, 1, &pid);
+    xcb_flush(m_connection);
+    return window;
+  }
+
+  void setClientList(const QList<xcb_window_t> &windows)
+  {
+    xcb_change_property(m_connection, XCB_PROP_MODE_REPLACE, m_root, atom("_NET_CLIENT_LIST"), XCB_ATOM_WINDOW, 32,
+                        windows.size(), windows.constData());
+    xcb_flush(m_connection);
+  }
+
+  void setActiveWindow(xcb_window_t window)
+  {
+    xcb_change_property(m_connection, XCB_PROP_MODE_REPLACE, m_root, atom("_NET_ACTIVE_WINDOW"), XCB_ATOM_WINDOW, 32, 1, &window);
+    xcb_flush(m_connection);
+  }
+
+private:
+  xcb_atom_t atom(const QByteArray &name)
+  {
+    xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(m_connection, xcb_intern_atom(m_connection, 0, name.size(), name.constData()), nullptr);
+    const xcb_atom_t atom = reply ? reply->atom : xcb_atom_t(XCB_ATOM_NONE);
+    std::free(reply);
+    return atom;
+  }
+
+  xcb_connection_t *m_connection = nullptr;
+  xcb_window_t m_root = 0;
+};
+
+QJsonObject windowChange(const QString &change, const QJsonObject &container)
+{
+  return {{QStringLiteral("change"), change}, {QStringLiteral("container"), container}};
+}
+}
+
+// Runs the D-Bus, IPC and X11 clients against servers started by the test itself, so that none
+// of them touches the session the tests happen to run in.
+class ClientTest : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void cleanupTestCase();
+
+  void systemdUnavailableWithoutManager();
+  void systemdTracksUnits();
+  void swayUnavailableWithoutSocket();
+  void swayTracksWindows();
+  void swayReassemblesMessages();
+  void swayUnavailableOnProtocolErrors();
+  void swayReconnectsAfterRestart();
+  void x11UnavailableWithoutDisplay();
+  void x11TracksClientList();
+
+private:
+  // Starts a dbus-daemon of its own on first use, so the mock manager cannot clash with the
+  // systemd of the session; returns false if there is no dbus-daemon.
+  bool startBus();
+  // Starts an Xvfb on a free display; returns the display, or nothing if there is no Xvfb.
+  QByteArray startXvfb();
+
+  QProcess m_busDaemon;
+  QString m_busAddress;
+  QProcess m_xvfb;
+};
+
+void ClientTest::initTestCase()
+{
+  qDBusRegisterMetaType<UnitListEntry>();
+  qDBusRegisterMetaType<QList<UnitListEntry>>();
+}
+
+void ClientTest::cleanupTestCase()
+{
+  if (m_busDaemon.state() != QProcess::NotRunning)
+  {
+    m_busDaemon.kill();
+    m_busDaemon.waitForFinished();
+  }
+  if (m_xvfb.state() != QProcess::NotRunning)
+  {
+    m_xvfb.kill();
+    m_xvfb.waitForFinished();
+  }
+}
+
+bool ClientTest::startBus()
+{
+  if (!m_busAddress.isEmpty())
+    return true;
+
+  const QString daemon = QStandardPaths::findExecutable(QStringLiteral("dbus-daemon"));
+  if (daemon.isEmpty())
+    return false;
+
+  m_busDaemon.setProgram(daemon);
+  m_busDaemon.setArguments({QStringLiteral("--session"), QStringLiteral("--nofork"), QStringLiteral("--print-address")});
+  m_busDaemon.setStandardErrorFile(QProcess::nullDevice());
+  m_busDaemon.start();
+  if (!m_busDaemon.waitForStarted())
+    return false;
+  while (!m_busDaemon.canReadLine() && m_busDaemon.waitForReadyRead(5000))
+  {
+  }
+  m_busAddress = QString::fromUtf8(m_busDaemon.readLine()).trimmed();
+  return !m_busAddress.isEmpty();
+}
+
+QByteArray ClientTest::startXvfb()
+{
+  const QString xvfb = QStandardPaths::findExecutable(QStringLiteral("Xvfb"));
+  if (xvfb.isEmpty())
+    return QByteArray();
+
+  // -displayfd picks the first free display and writes its number to stdout once the server
+  // accepts connections.
+  m_xvfb.setProgram(xvfb);
+  m_xvfb.setArguments({QStringLiteral("-displayfd"), QStringLiteral("1"), QStringLiteral("-nolisten"), QStringLiteral("tcp"),
+                       QStringLiteral("-screen"), QStringLiteral("0"), QStringLiteral("640x480x24")});
+  m_xvfb.setStandardErrorFile(QProcess::nullDevice());
+  m_xvfb.start();
+  if (!m_xvfb.waitForStarted())
+    return QByteArray();
+  while (!m_xvfb.canReadLine() && m_xvfb.waitForReadyRead(10000))
+  {
+  }
+  const QByteArray number = m_xvfb.readLine().trimmed();
+  return number.isEmpty() ? QByteArray() : ':' + number;
+}
+
+void ClientTest::systemdUnavailableWithoutManager()
+{
+  if (!startBus())
+    QSKIP("dbus-daemon is not available");
+
+  QDBusConnection connection = QDBusConnection::connectToBus(m_busAddress, QStringLiteral("unavailable"));
+  QVERIFY(connection.isConnected());
+  {
+    SystemdClient client(connection, QStringLiteral("user"));
+    QTRY_COMPARE(client.state(), SystemdClient::Unavailable);
+    QVERIFY(client.services().isEmpty());
+  }
+  QDBusConnection::disconnectFromBus(QStringLiteral("unavailable"));
+}
+
+void ClientTest::systemdTracksUnits()
+{
+  if (!startBus())
+    QSKIP("dbus-daemon is not available");
+
+  QDBusConnection managerConnection = QDBusConnection::connectToBus(m_busAddress, QStringLiteral("manager"));
+  QDBusConnection clientConnection = QDBusConnection::connectToBus(m_busAddress, QStringLiteral("client"));
+  QVERIFY(managerConnection.isConnected() && clientConnection.isConnected());
+
+  {
+    MockSystemdManager manager(managerConnection);
+    manager.addUnit(QStringLiteral("alpha.service"), {QStringLiteral("Alpha"), QStringLiteral("active"), 100}, false);
+    manager.addUnit(QStringLiteral("beta.service"), {QStringLiteral("Beta"), QStringLiteral("inactive"), 0}, false);
+    manager.addUnit(QStringLiteral("gamma.socket"), {QStringLiteral("Gamma"), QStringLiteral("active"), 0}, false);
+    QVERIFY(manager.registerOnBus());
+
+    SystemdClient client(clientConnection, QStringLiteral("user"));
+    QTRY_COMPARE(client.state(), SystemdClient::Ready);
+    QCOMPARE(client.services().size(), 2);
+    QCOMPARE(client.services().constFirst().name, QStringLiteral("alpha.service"));
+    QCOMPARE(serviceNamed(client, QStringLiteral("alpha.service")).description, QStringLiteral("Alpha"));
+    QCOMPARE(serviceNamed(client, QStringLiteral("alpha.service")).scope, QStringLiteral("user"));
+    // ListUnits has no main PID; it is fetched for running services only.
+    QTRY_COMPARE(serviceNamed(client, QStringLiteral("alpha.service")).pid, QStringLiteral("100"));
+    QCOMPARE(serviceNamed(client, QStringLiteral("beta.service")).pid, QStringLiteral("-"));
+
+    quint64 generation = client.generation();
+    manager.setActiveState(QStringLiteral("beta.service"), QStringLiteral("active"));
+    QTRY_COMPARE(serviceNamed(client, QStringLiteral("beta.service")).state, QStringLiteral("active"));
+    QVERIFY(client.generation() > generation);
+    manager.setMainPid(QStringLiteral("beta.service"), 200);
+    QTRY_COMPARE(serviceNamed(client, QStringLiteral("beta.service")).pid, QStringLiteral("200"));
+
+    // A new unit is announced by name only; its properties are fetched.
+    manager.addUnit(QStringLiteral("delta-1.service"), {QStringLiteral("Delta"), QStringLiteral("active"), 300}, true);
+    QTRY_COMPARE(serviceNamed(client, QStringLiteral("delta-1.service")).pid, QStringLiteral("300"));
+    QCOMPARE(serviceNamed(client, QStringLiteral("delta-1.service")).description, QStringLiteral("Delta"));
+    QCOMPARE(serviceNamed(client, QStringLiteral("delta-1.service")).state, QStringLiteral("active"));
+
+    manager.removeUnit(QStringLiteral("alpha.service"));
+    QTRY_VERIFY(serviceNamed(client, QStringLiteral("alpha.service")).name.isEmpty());
+    QCOMPARE(client.services().size(), 2);
+
+    // Nothing is sent while nothing changes.
+    generation = client.generation();
+    QTest::qWait(100);
+    QCOMPARE(client.generation(), generation);
+  }
+
+  QDBusConnection::disconnectFromBus(QStringLiteral("client"));
+  QDBusConnection::disconnectFromBus(QStringLiteral("manager"));
+}
+
+void ClientTest::swayUnavailableWithoutSocket()
+{
+  SwayClient unset{QString()};
+  QCOMPARE(unset.state(), SwayClient::Unavailable);
+
+  QTemporaryDir directory;
+  QVERIFY(directory.isValid());
+  SwayClient missing(directory.filePath(QStringLiteral("missing.sock")));
+  QTRY_COMPARE(missing.state(), SwayClient::Unavailable);
+  QVERIFY(missing.applications().isEmpty());
+}
+
+void ClientTest::swayTracksWindows()
+{
+  QTemporaryDir directory;
+  QVERIFY(directory.isValid());
+  FakeSwayServer server;
+  server.setTree(swayTree(false));
+  QVERIFY(server.listen(directory.filePath(QStringLiteral("sway-ipc.sock"))));
+
+  SwayClient client(directory.filePath(QStringLiteral("sway-ipc.sock")));
+  QTRY_COMPARE(client.state(), SwayClient::Ready);
+  // The Xwayland window goes by its class, the split container is no window, and gimp is on a
+  // hidden workspace.
+  QCOMPARE(client.applications(), QStringList({QStringLiteral("Firefox"), QStringLiteral("foot"), QStringLiteral("mpv")}));
+  QCOMPARE(server.treeRequests(), 1);
+
+  quint64 generation = client.generation();
+  server.sendEvent(FakeSwayServer::windowEvent, windowChange(QStringLiteral("new"), waylandWindow(20, QStringLiteral("kitty"), true)));
+  QTRY_VERIFY(client.applications().contains(QStringLiteral("kitty")));
+  QVERIFY(client.generation() > generation);
+
+  // An event that leaves the window as it was changes nothing.
+  generation = client.generation();
+  server.sendEvent(FakeSwayServer::windowEvent, windowChange(QStringLiteral("title"), waylandWindow(20, QStringLiteral("kitty"), true)));
+  server.sendEvent(FakeSwayServer::windowEvent, windowChange(QStringLiteral("close"), waylandWindow(10, QStringLiteral("foot"), true)));
+  QTRY_VERIFY(!client.applications().contains(QStringLiteral("foot")));
+  QCOMPARE(client.generation(), generation + 1);
+
+  // Workspace events and moves refetch the tree, which is the only way to learn about gimp.
+  server.setTree(swayTree(true));
+  server.sendEvent(FakeSwayServer::workspaceEvent, {{QStringLiteral("change"), QStringLiteral("focus")}});
+  QTRY_VERIFY(client.applications().contains(QStringLiteral("gimp")));
+  QCOMPARE(server.treeRequests(), 2);
+  // The refetched tree replaces what the events built up.
+  QVERIFY(!client.applications().contains(QStringLiteral("kitty")));
+  QVERIFY(client.applications().contains(QStringLiteral("foot")));
+
+  server.setTree(swayTree(false));
+  server.sendEvent(FakeSwayServer::windowEvent, windowChange(QStringLiteral("move"), waylandWindow(13, QStringLiteral("gimp"), false)));
+  QTRY_VERIFY(!client.applications().contains(QStringLiteral("gimp")));
+  QCOMPARE(server.treeRequests(), 3);
+
+  // Nothing is fetched while nothing changes.
+  generation = client.generation();
+  QTest::qWait(100);
+  QCOMPARE(client.generation(), generation);
+  QCOMPARE(server.treeRequests(), 3);
+
+  server.disconnectClient();
+  QTRY_COMPARE(client.state(), SwayClient::Unavailable);
+  QVERIFY(client.applications().isEmpty());
+}
+
+void ClientTest::swayReassemblesMessages()
+{
+  QTemporaryDir directory;
+  QVERIFY(directory.isValid());
+  FakeSwayServer server;
+  server.setTree(swayTree(false));
+  QVERIFY(server.listen(directory.filePath(QStringLiteral("sway-ipc.sock"))));
+
+  SwayClient client(directory.filePath(QStringLiteral("sway-ipc.sock")));
+  QTRY_COMPARE(client.state(), SwayClient::Ready);
+
+  // An event split inside its header, then one split inside its payload and sent together with
+  // the next event.
+  const auto event = [](qint64 id, const QString &appId)
+  {
+    return FakeSwayServer::message(FakeSwayServer::windowEvent,
+                                   QJsonDocument(windowChange(QStringLiteral("new"), waylandWindow(id, appId, true))).toJson(QJsonDocument::Compact));
+  };
+  const quint64 generation = client.generation();
+  const QByteArray first = event(20, QStringLiteral("kitty"));
+  server.sendRaw(first.left(9));
+  QTest::qWait(50);
+  QCOMPARE(client.generation(), generation);
+  server.sendRaw(first.mid(9));
+  QTRY_VERIFY(client.applications().contains(QStringLiteral("kitty")));
+
+  const QByteArray second = event(21, QStringLiteral("zathura"));
+  const QByteArray third = event(22, QStringLiteral("imv"));
+  server.sendRaw(second.left(second.size() - 5));
+  QTest::qWait(50);
+  QVERIFY(!client.applications().contains(QStringLiteral("zathura")));
+  server.sendRaw(second.right(5) + third);
+  QTRY_VERIFY(client.applications().contains(QStringLiteral("imv")));
+  QVERIFY(client.applications().contains(QStringLiteral("zathura")));
+  QCOMPARE(client.state(), SwayClient::Ready);
+}
+
+void ClientTest::swayUnavailableOnProtocolErrors()
+{
+  QTemporaryDir directory;
+  QVERIFY(directory.isValid());
+
+  {
+    FakeSwayServer server;
+    server.setTree(swayTree(false));
+    server.setSubscribeSucceeds(false);
+    QVERIFY(server.listen(directory.filePath(QStringLiteral("refusing.sock"))));
+    SwayClient client(directory.filePath(QStringLiteral("refusing.sock")));
+    QTRY_COMPARE(client.state(), SwayClient::Unavailable);
+  }
+
+  FakeSwayServer server;
+  server.setTree(swayTree(false));
+  QVERIFY(server.listen(directory.filePath(QStringLiteral("garbled.sock"))));
+  SwayClient client(directory.filePath(QStringLiteral("garbled.sock")));
+  QTRY_COMPARE(client.state(), SwayClient::Ready);
+  QVERIFY(!client.applications().isEmpty());
+
+  server.sendRaw(QByteArrayLiteral("not-an-ipc-header"));
+  QTRY_COMPARE(client.state(), SwayClient::Unavailable);
+  QVERIFY(client.applications().isEmpty());
+}
+
+void ClientTest::swayReconnectsAfterRestart()
+{
+  QTemporaryDir directory;
+  QVERIFY(directory.isValid());
+  const QString path = directory.filePath(QStringLiteral("sway-ipc.sock"));
+
+  auto server = std::make_unique<FakeSwayServer>();
+  server->setTree(swayTree(false));
+  QVERIFY(server->listen(path));
+  SwayClient client(path);
+  QTRY_COMPARE(client.state(), SwayClient::Ready);
+  QVERIFY(!client.applications().contains(QStringLiteral("gimp")));
+
+  // The compositor goes away, and the retries fail until it is back.
+  server.reset();
+  QTRY_COMPARE(client.state(), SwayClient::Unavailable);
+  QVERIFY(client.applications().isEmpty());
+  QTest::qWait(1500);
+  QCOMPARE(client.state(), SwayClient::Unavailable);
+
+  server = std::make_unique<FakeSwayServer>();
+  server->setTree(swayTree(true));
+  QVERIFY(server->listen(path));
+  QTRY_COMPARE_WITH_TIMEOUT(client.state(), SwayClient::Ready, 10000);
+  QVERIFY(client.applications().contains(QStringLiteral("gimp")));
+  QCOMPARE(server->treeRequests(), 1);
+}
+
+void ClientTest::x11UnavailableWithoutDisplay()
+{
+  // Not a display name at all, so xcb fails without trying to connect anywhere.
+  X11Client client(QByteArrayLiteral("no-such-display"));
+  QCOMPARE(client.state(), X11Client::Unavailable);
+  QVERIFY(client.windows().isEmpty());
+}
+
+void ClientTest::x11TracksClientList()
+{
+  const QByteArray display = startXvfb();
+  if (display.isEmpty())
+    QSKIP("Xvfb is not available");
+
+  FakeWindowManager windowManager;
+  QVERIFY(windowManager.connectTo(display));
+  const xcb_window_t foot = windowManager.createWindow("foot", "Foot", 100);
+  const xcb_window_t firefox = windowManager.createWindow("", "Firefox", 0);
+  windowManager.setClientList({foot, firefox});
+
+  X11Client client(display);
+  QCOMPARE(client.state(), X11Client::Ready);
+  QList<X11Window> windows = client.windows();
+  QCOMPARE(windows.size(), 2);
+  QCOMPARE(windows[0].id, foot);
+  QCOMPARE(windows[0].application, QStringLiteral("foot"));
+  QCOMPARE(windows[0].pid, 100);
+  // Without an instance name the class name is used.
+  QCOMPARE(windows[1].application, QStringLiteral("Firefox"));
+  QCOMPARE(windows[1].pid, 0);
+  QCOMPARE(client.applications(), QStringList({QStringLiteral("Firefox"), QStringLiteral("foot")}));
+
+  quint64 generation = client.generation();
+  const xcb_window_t xterm = windowManager.createWindow("xterm", "XTerm", 300);
+  windowManager.setClientList({foot, xterm});
+  QTRY_COMPARE(client.applications(), QStringList({QStringLiteral("foot"), QStringLiteral("xterm")}));
+  QVERIFY(client.generation() > generation);
+  windows = client.windows();
+  QCOMPARE(windows.size(), 2);
+  QCOMPARE(windows[1].id, xterm);
+  QCOMPARE(windows[1].pid, 300);
+
+  // Other root properties change nothing, and neither does an unchanged list.
+  generation = client.generation();
+  windowManager.setActiveWindow(xterm);
+  windowManager.setClientList({foot, xterm});
+  QTest::qWait(100);
+  QCOMPARE(client.generation(), generation);
+
+  m_xvfb.kill();
+  m_xvfb.waitForFinished();
+  QTRY_COMPARE(client.state(), X11Client::Unavailable);
+  QVERIFY(client.windows().isEmpty());
+}
+
+QTEST_GUILESS_MAIN(ClientTest)
+
+#include "clienttest.moc"
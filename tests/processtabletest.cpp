@@ -0,0 +1,205 @@
+#include "processtable.h"
+
+#include <QRandomGenerator>
+#include <QTest>
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace
+{
+using Reference = std::map<std::pair<int, qint64>, int>;
+
+// Mirrors ProcessTable::homeSlot, so that the wrap-around test can place keys at the end of the
+// table. The test checks the placement through forEach(), which visits slots in order, so a
+// change to the hash makes it fail instead of quietly testing nothing.
+int homeSlot(const ProcessKey &key, int capacity)
+{
+  quint64 hash = static_cast<quint64>(static_cast<quint32>(key.pid)) ^ (static_cast<quint64>(key.starttime) << 21);
+  hash *= Q_UINT64_C(0x9E3779B97F4A7C15);
+  return static_cast<int>(hash >> 32) & (capacity - 1);
+}
+
+// Whether the table holds exactly the entries of the reference, with the same values.
+bool matches(const ProcessTable<int> &table, const Reference &reference)
+{
+  if (table.size() != int(reference.size()))
+    return false;
+
+  int visited = 0;
+  bool valuesMatch = true;
+  table.forEach([&](const ProcessKey &key, int value)
+                {
+    ++visited;
+    const auto it = reference.find({key.pid, key.starttime});
+    valuesMatch = valuesMatch && it != reference.end() && it->second == value; });
+  if (!valuesMatch || visited != table.size())
+    return false;
+
+  for (const auto &[key, value] : reference)
+  {
+    const int *found = table.find({key.first, key.second});
+    if (!found || *found != value)
+      return false;
+  }
+  return true;
+}
+}
+
+class ProcessTableTest : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void churnMatchesReference();
+  void removeAcrossWrapAround();
+};
+
+// Scans a small PID space over many ticks. The live set grows and shrinks, processes exit and
+// their PIDs are reused with a new start time, and the survivors' values change every tick.
+void ProcessTableTest::churnMatchesReference()
+{
+  constexpr int pidSpace = 8192;
+  constexpr int ticks = 400;
+  QRandomGenerator random(1);
+  ProcessTable<int> table;
+  Reference live;
+  std::vector<qint64> starttimes(pidSpace, -1);
+  std::vector<int> freedPids;
+  qint64 clock = 1;
+
+  for (int tick = 0; tick < ticks; ++tick)
+  {
+    // Ramp up to a few thousand processes and back down to a handful, twice.
+    const int phase = tick % (ticks / 2);
+    const int target = phase < ticks / 4 ? 20 + phase * 30 : 20 + (ticks / 2 - phase) * 30;
+
+    freedPids.clear();
+    for (auto it = live.begin(); it != live.end();)
+    {
+      const bool exits = int(live.size()) > target ? random.bounded(4) == 0 : random.bounded(50) == 0;
+      if (exits)
+      {
+        starttimes[it->first.first] = -1;
+        freedPids.push_back(it->first.first);
+        it = live.erase(it);
+      }
+      else
+      {
+        it->second = int(random.bounded(1000));
+        ++it;
+      }
+    }
+
+    // Half of the new processes reuse a PID that exited in this very tick, so the table sees
+    // the old and the new (pid, starttime) in consecutive scans.
+    for (int attempts = 0; int(live.size()) < target && attempts < target * 4; ++attempts)
+    {
+      int pid = 1 + int(random.bounded(pidSpace - 1));
+      if (!freedPids.empty() && random.bounded(2) == 0)
+      {
+        pid = freedPids.back();
+        freedPids.pop_back();
+      }
+      if (starttimes[pid] >= 0)
+        continue;
+      starttimes[pid] = clock++;
+      live[{pid, starttimes[pid]}] = int(random.bounded(1000));
+    }
+
+    table.beginScan();
+    for (const auto &[key, value] : live)
+      table.mark({key.first, key.second}) = value;
+    table.sweep();
+
+    QVERIFY2(matches(table, live), qPrintable(QString("tick %1").arg(tick)));
+    // sweep() shrinks the table once it is less than an eighth full.
+    QVERIFY2(table.capacity() <= qMax(64, 8 * table.size()),
+             qPrintable(QString("tick %1: %2 slots for %3 entries").arg(tick).arg(table.capacity()).arg(table.size())));
+  }
+}
+
+// Fills a cluster that starts in the last slot and continues at slot 0, then removes its
+// entries in random orders, through sweep() and through remove().
+void ProcessTableTest::removeAcrossWrapAround()
+{
+  constexpr int capacity = 64;
+  constexpr qint64 starttime = 4242;
+  std::vector<ProcessKey> lastSlotKeys;
+  std::vector<ProcessKey> firstSlotKeys;
+  for (int pid = 1; lastSlotKeys.size() < 4 || firstSlotKeys.size() < 2; ++pid)
+  {
+    const ProcessKey key{pid, starttime};
+    const int home = homeSlot(key, capacity);
+    if (home == capacity - 1 && lastSlotKeys.size() < 4)
+      lastSlotKeys.push_back(key);
+    else if (home == 0 && firstSlotKeys.size() < 2)
+      firstSlotKeys.push_back(key);
+  }
+
+  std::vector<ProcessKey> keys = lastSlotKeys;
+  keys.insert(keys.end(), firstSlotKeys.begin(), firstSlotKeys.end());
+  QRandomGenerator random(2);
+
+  for (int trial = 0; trial < 200; ++trial)
+  {
+    ProcessTable<int> table;
+    QCOMPARE(table.capacity(), capacity);
+
+    // The keys homed at the last slot go in first, so the rest of the cluster wraps around.
+    Reference reference;
+    table.beginScan();
+    for (int index = 0; index < int(keys.size()); ++index)
+    {
+      table.mark(keys[index]) = index;
+      reference[{keys[index].pid, keys[index].starttime}] = index;
+    }
+
+    // forEach() visits slots in order, so a wrapped key comes first.
+    ProcessKey firstVisited;
+    bool visitedAny = false;
+    table.forEach([&](const ProcessKey &key, int)
+                  {
+      if (!visitedAny)
+        firstVisited = key;
+      visitedAny = true; });
+    QVERIFY(std::find(lastSlotKeys.begin() + 1, lastSlotKeys.end(), firstVisited) != lastSlotKeys.end());
+
+    std::vector<ProcessKey> order = keys;
+    std::shuffle(order.begin(), order.end(), random);
+    const bool useSweep = trial % 2 == 0;
+    while (!order.empty())
+    {
+      // Drop up to two keys at a time.
+      const int count = qMin(int(order.size()), 1 + int(random.bounded(2)));
+      for (int index = 0; index < count; ++index)
+      {
+        reference.erase({order.back().pid, order.back().starttime});
+        order.pop_back();
+      }
+
+      if (useSweep)
+      {
+        table.beginScan();
+        for (const auto &[key, value] : reference)
+          table.mark({key.first, key.second});
+        QCOMPARE(table.sweep(), count);
+      }
+      else
+      {
+        for (const ProcessKey &key : keys)
+        {
+          if (!reference.count({key.pid, key.starttime}) && table.find(key))
+            QVERIFY(table.remove(key));
+        }
+      }
+      QVERIFY2(matches(table, reference), qPrintable(QString("trial %1, %2 left").arg(trial).arg(order.size())));
+    }
+    QCOMPARE(table.size(), 0);
+  }
+}
+
+QTEST_APPLESS_MAIN(ProcessTableTest)
+
+#include "processtabletest.moc"
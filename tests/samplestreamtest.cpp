@@ -0,0 +1,296 @@
+#include "samplestream.h"
+
+#include <QRandomGenerator>
+#include <QTest>
+#include <iterator>
+
+namespace
+{
+// Whether the decoded processes are exactly the rows, at the resolution the stream sends.
+bool matches(const SampleStreamDecoder &decoder, const QList<ProcessInfo> &rows)
+{
+  if (decoder.processes().size() != rows.size())
+    return false;
+  for (const ProcessInfo &row : rows)
+  {
+    const ProcessInfo *decoded = decoder.processes().find({row.pid, row.starttime});
+    if (!decoded || decoded->name != row.name || decoded->user != row.user ||
+        cpuPermille(decoded->cpuPercent) != cpuPermille(row.cpuPercent) || qint64(decoded->memoryKb) != qint64(row.memoryKb))
+      return false;
+  }
+  return true;
+}
+
+QByteArray varint(quint64 value)
+{
+  QByteArray out;
+  while (value >= 0x80)
+  {
+    out += char((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out += char(value);
+  return out;
+}
+
+// The payload of an encoded binary frame, without its length prefix.
+QByteArray payloadOf(const QByteArray &frame)
+{
+  qsizetype prefix = 0;
+  while (quint8(frame[prefix]) & 0x80)
+    ++prefix;
+  return frame.mid(prefix + 1);
+}
+
+SystemUsage usageFor(quint64 tick)
+{
+  SystemUsage usage;
+  usage.cpuUsage = int(tick % 100);
+  usage.ramUsage = 4000000 + qint64(tick);
+  usage.totalRam = 16000000;
+  usage.totalProcesses = 42;
+  usage.coreCount = 4;
+  usage.coreUsages = {int(tick % 7), 10, 20, 30};
+  return usage;
+}
+
+ProcessInfo process(int pid, qint64 starttime, const char *name, const char *user, double cpuPercent, double memoryKb)
+{
+  ProcessInfo row;
+  row.pid = pid;
+  row.starttime = starttime;
+  row.name = QString::fromLatin1(name);
+  row.user = QString::fromLatin1(user);
+  row.cpuPercent = cpuPercent;
+  row.memoryKb = memoryKb;
+  return row;
+}
+
+// A process table that moves on every tick: readings change, processes exit, and new ones
+// start, some of them under the PID of one that just exited.
+class Workload
+{
+public:
+  explicit Workload(int processes)
+  {
+    for (int index = 0; index < processes; ++index)
+      m_rows.append(makeProcess(m_nextPid++));
+  }
+
+  const QList<ProcessInfo> &rows() const { return m_rows; }
+
+  void advance()
+  {
+    ++m_tick;
+    for (qsizetype index = 0; index < m_rows.size(); ++index)
+    {
+      ProcessInfo &row = m_rows[index];
+      const quint32 roll = m_random.bounded(100);
+      if (roll < 5)
+        row = makeProcess(roll < 2 ? row.pid : m_nextPid++);
+      else if (roll < 30)
+      {
+        row.cpuPercent = m_random.bounded(1000) / 10.0;
+        row.memoryKb = qMax(100.0, row.memoryKb + m_random.bounded(2001) - 1000);
+      }
+      else if (roll < 32)
+        row.name += QStringLiteral("-renamed");
+      else if (roll < 33)
+        row.user = QStringLiteral("nobody");
+    }
+    if (m_rows.size() > 10)
+      m_rows.removeAt(int(m_random.bounded(int(m_rows.size()))));
+  }
+
+private:
+  ProcessInfo makeProcess(int pid)
+  {
+    static const char *const names[] = {"bash", "sshd", "python3", "kworker/0:1", "Überprozess"};
+    ProcessInfo row;
+    row.pid = pid;
+    row.starttime = m_tick * 100 + m_random.bounded(100);
+    row.name = QString::fromUtf8(names[m_random.bounded(int(std::size(names)))]);
+    row.user = m_random.bounded(2) ? QStringLiteral("root") : QStringLiteral("alice");
+    row.cpuPercent = m_random.bounded(1000) / 10.0;
+    row.memoryKb = 1000 + m_random.bounded(500000);
+    return row;
+  }
+
+  QRandomGenerator m_random{3};
+  QList<ProcessInfo> m_rows;
+  int m_nextPid = 300;
+  qint64 m_tick = 0;
+};
+}
+
+class SampleStreamTest : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void roundTripsBaselineAndDeltas();
+  void decodesOneByteAtATime();
+  void removesAndReusesPids();
+  void baselineForLateJoiner();
+  void rejectsMalformedStreams_data();
+  void rejectsMalformedStreams();
+};
+
+// Runs a baseline and many deltas of a churning table through the differ, the encoder and the
+// decoder, and checks the decoded state after every frame.
+void SampleStreamTest::roundTripsBaselineAndDeltas()
+{
+  Workload workload(500);
+  SampleDiffer differ;
+  SampleStreamDecoder decoder;
+  QVERIFY(decoder.feed(sampleStreamHeader(SampleFormat::Binary)));
+  QVERIFY(!decoder.isSynchronized());
+
+  for (quint64 tick = 1; tick <= 50; ++tick)
+  {
+    const SampleFrame frame = differ.diff(tick, 1000 * qint64(tick), usageFor(tick), workload.rows());
+    QCOMPARE(frame.kind, tick == 1 ? SampleFrame::Baseline : SampleFrame::Delta);
+    QVERIFY(decoder.feed(encodeSampleFrame(frame, SampleFormat::Binary)));
+    QVERIFY2(matches(decoder, workload.rows()), qPrintable(QString("tick %1").arg(tick)));
+    QCOMPARE(decoder.tick(), tick);
+    QCOMPARE(decoder.timestampMs(), 1000 * qint64(tick));
+    QCOMPARE(decoder.usage().cpuUsage, usageFor(tick).cpuUsage);
+    QCOMPARE(decoder.usage().ramUsage, usageFor(tick).ramUsage);
+    QCOMPARE(decoder.usage().coreUsages, usageFor(tick).coreUsages);
+    workload.advance();
+  }
+  QCOMPARE(decoder.frameCount(), quint64(50));
+
+  // A tick without changes is a delta with no rows.
+  differ.diff(51, 51000, usageFor(51), workload.rows());
+  const SampleFrame unchanged = differ.diff(52, 52000, usageFor(52), workload.rows());
+  QVERIFY(unchanged.upserts.isEmpty());
+  QVERIFY(unchanged.removed.isEmpty());
+}
+
+// The decoder buffers partial frames, so the stream may be cut anywhere.
+void SampleStreamTest::decodesOneByteAtATime()
+{
+  Workload workload(200);
+  SampleDiffer differ;
+  QByteArray stream = sampleStreamHeader(SampleFormat::Binary);
+  for (quint64 tick = 1; tick <= 10; ++tick)
+  {
+    stream += encodeSampleFrame(differ.diff(tick, qint64(tick), usageFor(tick), workload.rows()), SampleFormat::Binary);
+    if (tick < 10)
+      workload.advance();
+  }
+
+  SampleStreamDecoder decoder;
+  for (qsizetype index = 0; index < stream.size(); ++index)
+    QVERIFY(decoder.feed(QByteArrayView(stream).sliced(index, 1)));
+  QCOMPARE(decoder.frameCount(), quint64(10));
+  QCOMPARE(decoder.tick(), quint64(10));
+  QVERIFY(matches(decoder, workload.rows()));
+}
+
+void SampleStreamTest::removesAndReusesPids()
+{
+  SampleDiffer differ;
+  SampleStreamDecoder decoder;
+  QVERIFY(decoder.feed(sampleStreamHeader(SampleFormat::Binary)));
+
+  QList<ProcessInfo> rows = {process(10, 100, "old", "root", 1.0, 1000), process(11, 101, "kept", "root", 2.0, 2000),
+                             process(12, 102, "gone", "alice", 3.0, 3000)};
+  QVERIFY(decoder.feed(encodeSampleFrame(differ.diff(1, 1, usageFor(1), rows), SampleFormat::Binary)));
+  QVERIFY(matches(decoder, rows));
+
+  // PID 10 exits and is reused by a new process, PID 12 exits for good.
+  rows = {process(10, 200, "new", "alice", 5.0, 500), process(11, 101, "kept", "root", 2.0, 2000)};
+  const SampleFrame frame = differ.diff(2, 2, usageFor(2), rows);
+  QCOMPARE(frame.upserts.size(), qsizetype(1));
+  QCOMPARE(frame.upserts.constFirst().starttime, qint64(200));
+  // The new process is sent whole, not as a change to the one it replaced.
+  QCOMPARE(frame.previous.constFirst().name, QString());
+  QCOMPARE(frame.removed.size(), qsizetype(2));
+  QVERIFY(frame.removed.contains(ProcessKey{10, 100}));
+  QVERIFY(frame.removed.contains(ProcessKey{12, 102}));
+
+  QVERIFY(decoder.feed(encodeSampleFrame(frame, SampleFormat::Binary)));
+  QVERIFY(matches(decoder, rows));
+  QVERIFY(!decoder.processes().find({10, 100}));
+  QCOMPARE(decoder.processes().find({10, 200})->name, QStringLiteral("new"));
+}
+
+// A consumer that connects mid-stream gets baseline() and then the same deltas as everyone else.
+void SampleStreamTest::baselineForLateJoiner()
+{
+  Workload workload(300);
+  SampleDiffer differ;
+  SampleStreamDecoder early;
+  QVERIFY(early.feed(sampleStreamHeader(SampleFormat::Binary)));
+  for (quint64 tick = 1; tick <= 5; ++tick)
+  {
+    QVERIFY(early.feed(encodeSampleFrame(differ.diff(tick, qint64(tick), usageFor(tick), workload.rows()), SampleFormat::Binary)));
+    workload.advance();
+  }
+
+  const SampleFrame baseline = differ.baseline();
+  QCOMPARE(baseline.kind, SampleFrame::Baseline);
+  QCOMPARE(baseline.tick, quint64(5));
+  QCOMPARE(baseline.upserts.size(), baseline.previous.size());
+  SampleStreamDecoder late;
+  QVERIFY(late.feed(sampleStreamHeader(SampleFormat::Binary) + encodeSampleFrame(baseline, SampleFormat::Binary)));
+  QCOMPARE(late.tick(), quint64(5));
+  QCOMPARE(late.usage().coreUsages, early.usage().coreUsages);
+  QCOMPARE(late.processes().size(), early.processes().size());
+
+  for (quint64 tick = 6; tick <= 10; ++tick)
+  {
+    const QByteArray delta = encodeSampleFrame(differ.diff(tick, qint64(tick), usageFor(tick), workload.rows()), SampleFormat::Binary);
+    QVERIFY(early.feed(delta));
+    QVERIFY(late.feed(delta));
+    QVERIFY(matches(early, workload.rows()));
+    QVERIFY(matches(late, workload.rows()));
+    workload.advance();
+  }
+}
+
+void SampleStreamTest::rejectsMalformedStreams_data()
+{
+  QTest::addColumn<QByteArray>("stream");
+
+  const QByteArray header = sampleStreamHeader(SampleFormat::Binary);
+  SampleDiffer differ;
+  const QList<ProcessInfo> rows = {process(10, 100, "bash", "root", 1.0, 1000)};
+  const QByteArray baseline = encodeSampleFrame(differ.diff(1, 1, usageFor(1), rows), SampleFormat::Binary);
+  const QByteArray delta = encodeSampleFrame(differ.diff(2, 2, usageFor(2), {process(10, 100, "bash", "root", 7.0, 1000)}), SampleFormat::Binary);
+
+  QTest::newRow("bad magic") << QByteArray("WTMX" + header.right(1) + baseline);
+  QTest::newRow("unknown version") << QByteArray(header.left(4) + char(header[4] + 1) + baseline);
+  QTest::newRow("oversized length") << QByteArray(header + varint(Q_UINT64_C(256) * 1024 * 1024 + 1));
+  QTest::newRow("length varint never ends") << QByteArray(header + QByteArray(10, char(0x80)));
+  // The payload ends inside the tick varint.
+  QTest::newRow("truncated varint in payload") << QByteArray(header + varint(3) + char(SampleFrame::Baseline) + char(0x80) + char(0x80));
+  QTest::newRow("unknown frame kind") << QByteArray(header + varint(1) + char(7));
+  QTest::newRow("delta before baseline") << QByteArray(header + delta);
+  QTest::newRow("bytes after payload") << QByteArray(header + varint(payloadOf(baseline).size() + 1) + payloadOf(baseline) + char(0));
+}
+
+void SampleStreamTest::rejectsMalformedStreams()
+{
+  QFETCH(QByteArray, stream);
+
+  SampleStreamDecoder decoder;
+  QVERIFY(!decoder.feed(stream));
+  QVERIFY(decoder.hasFailed());
+  QVERIFY(!decoder.isSynchronized());
+  // Nothing is applied after a failure, not even a valid frame.
+  SampleDiffer differ;
+  QVERIFY(!decoder.feed(encodeSampleFrame(differ.diff(1, 1, usageFor(1), {process(1, 1, "init", "root", 0, 100)}), SampleFormat::Binary)));
+  QCOMPARE(decoder.frameCount(), quint64(0));
+
+  // reset() starts over with a new stream.
+  decoder.reset();
+  QVERIFY(decoder.feed(sampleStreamHeader(SampleFormat::Binary)));
+  QVERIFY(!decoder.hasFailed());
+}
+
+QTEST_APPLESS_MAIN(SampleStreamTest)
+
+#include "samplestreamtest.moc"